@@ -13,7 +13,7 @@ equals(QT_MAJOR_VERSION, 5):lessThan(QT_MINOR_VERSION, 4) {
 	error("Fuel requires Qt 5.4.0 or greater")
 }
 
-QT = core gui widgets webengine webenginewidgets
+QT = core gui widgets webengine webenginewidgets sql concurrent
 QT-= quick multimediawidgets opengl printsupport qml multimedia positioning sensors
 
 
@@ -73,6 +73,27 @@ SOURCES += src/main.cpp\
 	src/BrowserWidget.cpp \
 	src/CustomWebView.cpp \
 	src/Fossil.cpp \
+	src/FossilJob.cpp \
+	src/FossilCapabilities.cpp \
+	src/FossilDb.cpp \
+	src/ChangeDetector.cpp \
+	src/MetadataCache.cpp \
+	src/ScanPlan.cpp \
+	src/ScanWorker.cpp \
+	src/WorkspaceWatcher.cpp \
+	src/OperationQueue.cpp \
+	src/OperationPanel.cpp \
+	src/GlobMatcher.cpp \
+	src/DirectoryWalker.cpp \
+	src/FileTable.cpp \
+	src/FileFilter.cpp \
+	src/FuzzyMatcher.cpp \
+	src/QuickOpenDialog.cpp \
+	src/FileIconService.cpp \
+	src/FileTableModel.cpp \
+	src/WorkspaceTreeModel.cpp \
+	src/DirTree.cpp \
+	src/LineScanner.cpp \
 	src/Workspace.cpp \
 	src/SearchBox.cpp \
 	src/AppSettings.cpp \
@@ -92,6 +113,27 @@ HEADERS  += src/MainWindow.h \
 	src/BrowserWidget.h \
 	src/CustomWebView.h \
 	src/Fossil.h \
+	src/FossilJob.h \
+	src/FossilCapabilities.h \
+	src/FossilDb.h \
+	src/ChangeDetector.h \
+	src/MetadataCache.h \
+	src/ScanPlan.h \
+	src/ScanWorker.h \
+	src/WorkspaceWatcher.h \
+	src/OperationQueue.h \
+	src/OperationPanel.h \
+	src/GlobMatcher.h \
+	src/DirectoryWalker.h \
+	src/FileTable.h \
+	src/FileFilter.h \
+	src/FuzzyMatcher.h \
+	src/QuickOpenDialog.h \
+	src/FileIconService.h \
+	src/FileTableModel.h \
+	src/WorkspaceTreeModel.h \
+	src/DirTree.h \
+	src/LineScanner.h \
 	src/Workspace.h \
 	src/SearchBox.h \
 	src/AppSettings.h \
@@ -108,7 +150,8 @@ FORMS    += ui/MainWindow.ui \
 	ui/BrowserWidget.ui \
 	ui/RevisionDialog.ui \
 	ui/RemoteDialog.ui \
-	ui/AboutDialog.ui
+	ui/AboutDialog.ui \
+	ui/QuickOpenDialog.ui
 
 RESOURCES += \
 	rsrc/resources.qrc
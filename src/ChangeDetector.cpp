@@ -0,0 +1,153 @@
+#include "ChangeDetector.h"
+#include <QtConcurrent/QtConcurrentMap>
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QFile>
+#include <QAtomicInt>
+#include "Utils.h"
+
+// vfile.chnged values
+enum
+{
+	VFILE_UNCHANGED				= 0,
+	VFILE_UPDATED_BY_MERGE		= 2,
+	VFILE_ADDED_BY_MERGE		= 3,
+	VFILE_UPDATED_BY_INTEGRATE	= 4,
+	VFILE_ADDED_BY_INTEGRATE	= 5
+};
+
+// Lengths of the hex artifact ids
+enum
+{
+	HASH_LENGTH_SHA1	= 40,
+	HASH_LENGTH_SHA3	= 64
+};
+
+//------------------------------------------------------------------------------
+// Hash a file with the algorithm of its artifact id
+static bool HashFile(const QString &filename, const QString &artifactHash, QByteArray &hash)
+{
+	QCryptographicHash::Algorithm algorithm;
+	if(artifactHash.length()==HASH_LENGTH_SHA1)
+		algorithm = QCryptographicHash::Sha1;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 2)
+	// Earlier versions implement Keccak instead of the final SHA3
+	else if(artifactHash.length()==HASH_LENGTH_SHA3)
+		algorithm = QCryptographicHash::Sha3_256;
+#endif
+	else
+		return false;
+
+	QFile file(filename);
+	if(!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QCryptographicHash hasher(algorithm);
+	if(!hasher.addData(&file))
+		return false;
+
+	hash = hasher.result().toHex();
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// FileClassifier
+//////////////////////////////////////////////////////////////////////////
+struct FileClassifier
+{
+	typedef void result_type;
+
+	FileClassifier(const QString &basePath, QAtomicInt &hashed, QAtomicInt &failed)
+		: basePath(basePath), hashed(hashed), failed(failed)
+	{
+	}
+
+	void operator()(CheckoutDb::FileEntry &e) const
+	{
+		if(e.rid==0)
+		{
+			e.type = WorkspaceFile::TYPE_ADDED;
+			return;
+		}
+
+		if(e.deleted)
+		{
+			e.type = WorkspaceFile::TYPE_DELETED;
+			return;
+		}
+
+		// The content of a symlink artifact is the link target itself
+		if(e.isLink)
+		{
+			failed.ref();
+			return;
+		}
+
+		QString filename = basePath + e.filePath;
+		QFileInfo info(filename);
+
+		// Fossil does not see a directory as the file
+		if(!info.exists() || info.isDir())
+		{
+			e.type = WorkspaceFile::TYPE_MISSING;
+			return;
+		}
+
+		bool modified;
+#ifndef Q_OS_WIN
+		// A change of the executable bit alone keeps the size and mtime
+		if(info.isExecutable() != e.isExe)
+			modified = true;
+		else
+#endif
+		if(info.size() != e.size)
+			modified = true;
+		else if(info.lastModified().toMSecsSinceEpoch()/1000 == e.mtime)
+			modified = e.changed != VFILE_UNCHANGED; // Nothing new since fossil last looked
+		else
+		{
+			QByteArray hash;
+			if(!HashFile(filename, e.hash, hash))
+			{
+				failed.ref();
+				return;
+			}
+			hashed.ref();
+			modified = hash != e.hash.toLatin1();
+		}
+
+		if(e.changed==VFILE_UPDATED_BY_MERGE || e.changed==VFILE_ADDED_BY_MERGE ||
+			e.changed==VFILE_UPDATED_BY_INTEGRATE || e.changed==VFILE_ADDED_BY_INTEGRATE)
+			e.type = WorkspaceFile::TYPE_MERGED;
+		else if(modified)
+			e.type = WorkspaceFile::TYPE_EDITTED;
+		else if(e.renamed)
+			e.type = WorkspaceFile::TYPE_RENAMED;
+		else
+			e.type = WorkspaceFile::TYPE_UNCHANGED;
+	}
+
+	QString		basePath;
+	QAtomicInt	&hashed;
+	QAtomicInt	&failed;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+ChangeDetector::ChangeDetector(const QString &workspacePath)
+	: workspacePath(workspacePath)
+	, hashedCount(0)
+{
+}
+
+//------------------------------------------------------------------------------
+bool ChangeDetector::detect(CheckoutDb::entrylist_t &entries)
+{
+	QAtomicInt hashed;
+	QAtomicInt failed;
+
+	QtConcurrent::blockingMap(entries, FileClassifier(workspacePath + PATH_SEPARATOR, hashed, failed));
+
+	hashedCount = hashed.load();
+	return failed.load()==0;
+}
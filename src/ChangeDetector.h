@@ -0,0 +1,28 @@
+#ifndef CHANGEDETECTOR_H
+#define CHANGEDETECTOR_H
+
+#include <QString>
+#include "FossilDb.h"
+
+//////////////////////////////////////////////////////////////////////////
+// ChangeDetector
+// Classifies the tracked files of a workspace like "fossil ls -l" does.
+// Files are stat'ed in parallel, and only those whose size matches the
+// artifact but whose mtime differs from the recorded one are hashed.
+//////////////////////////////////////////////////////////////////////////
+class ChangeDetector
+{
+public:
+	explicit ChangeDetector(const QString &workspacePath);
+
+	// Fails if any file could not be classified with certainty
+	bool	detect(CheckoutDb::entrylist_t &entries);
+
+	int		getHashedCount() const { return hashedCount; }
+
+private:
+	QString	workspacePath;
+	int		hashedCount;
+};
+
+#endif // CHANGEDETECTOR_H
@@ -0,0 +1,194 @@
+#include "DirTree.h"
+#include <algorithm>
+
+//////////////////////////////////////////////////////////////////////////
+// ChildNameLess
+//////////////////////////////////////////////////////////////////////////
+struct ChildNameLess
+{
+	ChildNameLess(const DirTree &tree) : tree(tree)
+	{
+	}
+
+	bool operator()(int l, int r) const
+	{
+		return tree.getName(l) < tree.getName(r);
+	}
+
+	const DirTree &tree;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+DirTree::DirTree()
+{
+	clear();
+}
+
+//------------------------------------------------------------------------------
+void DirTree::clear()
+{
+	nodes.clear();
+	paths.clear();
+	pathIndex.clear();
+	names.clear();
+	nameIndex.clear();
+	fileRows.clear();
+	dfsOrder.clear();
+	childStart.fill(0, 2);
+	childIds.clear();
+
+	Node root = { -1, internName(""), 0, 0, 0, 0, 0, 0, 0 };
+	nodes.append(root);
+	paths.append("");
+	pathIndex.insert("", ROOT);
+}
+
+//------------------------------------------------------------------------------
+int DirTree::internName(const QString &name)
+{
+	QHash<QString, int>::const_iterator it = nameIndex.constFind(name);
+	if(it!=nameIndex.constEnd())
+		return it.value();
+
+	int id = names.size();
+	names.append(name);
+	nameIndex.insert(name, id);
+	return id;
+}
+
+//------------------------------------------------------------------------------
+// Parents are interned before their children, so they always have lower ids
+int DirTree::internPath(const QString &path)
+{
+	QHash<QString, int>::const_iterator it = pathIndex.constFind(path);
+	if(it!=pathIndex.constEnd())
+		return it.value();
+
+	int sep = path.lastIndexOf('/');
+	int parent = internPath(sep<0 ? QString("") : path.left(sep));
+
+	Node node = { parent, internName(sep<0 ? path : path.mid(sep+1)), 0, 0, 0, 0, 0, 0, 0 };
+	int id = nodes.size();
+	nodes.append(node);
+	paths.append(path);
+	pathIndex.insert(path, id);
+	return id;
+}
+
+//------------------------------------------------------------------------------
+void DirTree::build(const FileTable &files, const QVector<int> &rows)
+{
+	clear();
+
+	// Resolve each directory of the table once, and count the files per node
+	QVector<int> dir_nodes(files.getDirCount(), -1);
+	QVector<int> row_nodes(rows.size());
+	for(int i=0; i<rows.size(); ++i)
+	{
+		int row = rows[i];
+		int &node_id = dir_nodes[files.getDirId(row)];
+		if(node_id<0)
+			node_id = internPath(files.getDirPath(files.getDirId(row)));
+		row_nodes[i] = node_id;
+
+		Node &node = nodes[node_id];
+		WorkspaceFile::Type type = files.getType(row);
+		++node.lastFile;
+		node.type |= type;
+		if(type & WorkspaceFile::TYPE_MODIFIED)
+			++node.modifiedCount;
+		if(type & WorkspaceFile::TYPE_UNKNOWN)
+			++node.unknownCount;
+		if(type & WorkspaceFile::TYPE_CONFLICTED)
+			++node.conflictedCount;
+	}
+
+	buildDfsOrder();
+
+	// Group the rows by directory, in depth first order
+	int offset = 0;
+	foreach(int n, dfsOrder)
+	{
+		int count = nodes[n].lastFile;
+		nodes[n].firstFile = offset;
+		nodes[n].lastFile = offset;
+		offset += count;
+	}
+
+	fileRows.resize(rows.size());
+	for(int i=0; i<rows.size(); ++i)
+		fileRows[nodes[row_nodes[i]].lastFile++] = rows[i];
+
+	for(int n=0; n<nodes.size(); ++n)
+		nodes[n].lastTreeFile = nodes[n].lastFile;
+
+	// Aggregate children into parents, visiting children first
+	for(int n=nodes.size()-1; n>ROOT; --n)
+	{
+		const Node &child = nodes[n];
+		Node &parent = nodes[child.parent];
+		parent.type |= child.type;
+		parent.modifiedCount += child.modifiedCount;
+		parent.unknownCount += child.unknownCount;
+		parent.conflictedCount += child.conflictedCount;
+		parent.lastTreeFile = qMax(parent.lastTreeFile, child.lastTreeFile);
+	}
+}
+
+//------------------------------------------------------------------------------
+void DirTree::getTreeRanges(const QStringList &dirPaths, rangelist_t &ranges) const
+{
+	ranges.clear();
+	rangelist_t found;
+	foreach(const QString &path, dirPaths)
+	{
+		int id = findDir(path);
+		if(id<0)
+			continue;
+		found.append(qMakePair(nodes[id].firstFile, nodes[id].lastTreeFile));
+	}
+
+	// A directory selected along with one of its parents adds nothing
+	std::sort(found.begin(), found.end());
+	for(int i=0; i<found.size(); ++i)
+	{
+		if(!ranges.isEmpty() && found[i].first<=ranges.last().second)
+			ranges.last().second = qMax(ranges.last().second, found[i].second);
+		else
+			ranges.append(found[i]);
+	}
+}
+
+//------------------------------------------------------------------------------
+void DirTree::buildDfsOrder()
+{
+	// Children of each node, as ranges of one array
+	childStart.fill(0, nodes.size()+1);
+	for(int n=ROOT+1; n<nodes.size(); ++n)
+		++childStart[nodes[n].parent+1];
+	for(int n=0; n<nodes.size(); ++n)
+		childStart[n+1] += childStart[n];
+
+	childIds.resize(nodes.size());
+	QVector<int> fill = childStart;
+	for(int n=ROOT+1; n<nodes.size(); ++n)
+		childIds[fill[nodes[n].parent]++] = n;
+
+	for(int n=0; n<nodes.size(); ++n)
+		std::sort(childIds.begin()+childStart[n], childIds.begin()+childStart[n+1], ChildNameLess(*this));
+
+	dfsOrder.clear();
+	dfsOrder.reserve(nodes.size());
+
+	QVector<int> stack;
+	stack.append(ROOT);
+	while(!stack.isEmpty())
+	{
+		int n = stack.takeLast();
+		dfsOrder.append(n);
+
+		// Push in reverse so the first child is visited first
+		for(int c=childStart[n+1]-1; c>=childStart[n]; --c)
+			stack.append(childIds[c]);
+	}
+}
@@ -0,0 +1,81 @@
+#ifndef DIRTREE_H
+#define DIRTREE_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QPair>
+#include "FileTable.h"
+
+//////////////////////////////////////////////////////////////////////////
+// DirTree
+// The directories holding a set of FileTable rows. Directories are
+// numbered so that parents come before their children, which lets the
+// file states be aggregated in a single reverse pass. The files are
+// grouped by directory in depth first order, so the files below any
+// directory are one contiguous range.
+//////////////////////////////////////////////////////////////////////////
+class DirTree
+{
+public:
+	enum
+	{
+		ROOT = 0
+	};
+
+	struct Node
+	{
+		int		parent;			// -1 for the root
+		int		nameId;
+		int		firstFile;		// Range of the files directly in this directory, in getFileRows()
+		int		lastFile;
+		int		lastTreeFile;	// End of the files of the whole subtree, which follow firstFile
+		int		type;			// WorkspaceFile::Type flags of all the files below
+		int		modifiedCount;	// Counts of all the files below
+		int		unknownCount;
+		int		conflictedCount;
+	};
+
+	DirTree();
+
+	void				clear();
+	void				build(const FileTable &files, const QVector<int> &rows);
+
+	int					getNodeCount() const { return nodes.size(); }
+	const Node			&getNode(int id) const { return nodes[id]; }
+	const QString		&getName(int id) const { return names[nodes[id].nameId]; }
+	const QString		&getPath(int id) const { return paths[id]; }
+	int					findDir(const QString &path) const { return pathIndex.value(path, -1); }
+
+	// Parents before their children, and siblings by name
+	const QVector<int>	&getDfsOrder() const { return dfsOrder; }
+
+	// Subdirectories of a directory, by name
+	int					getChildCount(int id) const { return childStart[id+1]-childStart[id]; }
+	int					getChild(int id, int index) const { return childIds[childStart[id]+index]; }
+
+	// The rows of the tree, grouped by directory in depth first order
+	const QVector<int>	&getFileRows() const { return fileRows; }
+
+	// Merged ranges of getFileRows() holding the files below the directories
+	typedef QVector<QPair<int, int> > rangelist_t;
+	void				getTreeRanges(const QStringList &dirPaths, rangelist_t &ranges) const;
+
+private:
+	int					internPath(const QString &path);
+	int					internName(const QString &name);
+	void				buildDfsOrder();
+
+	QVector<Node>		nodes;
+	QStringList			paths;
+	QHash<QString, int>	pathIndex;
+	QStringList			names;
+	QHash<QString, int>	nameIndex;
+	QVector<int>		fileRows;
+	QVector<int>		dfsOrder;
+	QVector<int>		childStart;		// Range of each node's children in childIds
+	QVector<int>		childIds;
+};
+
+#endif // DIRTREE_H
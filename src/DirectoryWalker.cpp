@@ -0,0 +1,247 @@
+#include "DirectoryWalker.h"
+#include <QThreadPool>
+#include <QRunnable>
+#include <QThread>
+#include <QFile>
+#ifdef Q_OS_WIN
+#include <QDir>
+#include <QFileInfo>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#endif
+
+// Walking is mostly bound by the filesystem, so more threads rarely help
+static const int			MAX_WALK_THREADS = 8;
+// Idle workers poll for stolen work this often
+static const unsigned long	IDLE_WAIT_MS = 5;
+
+//////////////////////////////////////////////////////////////////////////
+// DirectoryWalker::Worker
+//////////////////////////////////////////////////////////////////////////
+class DirectoryWalker::Worker : public QRunnable
+{
+public:
+	Worker(DirectoryWalker &walker, int index, entrylist_t &entries)
+		: walker(walker), index(index), entries(entries)
+	{
+	}
+
+	void run()
+	{
+		walker.run(index, entries);
+	}
+
+private:
+	DirectoryWalker	&walker;
+	int				index;
+	entrylist_t		&entries;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+DirectoryWalker::DirectoryWalker(const QString &rootPath, const GlobMatcher &ignoreMatcher, bool includeIgnored)
+	: rootPath(rootPath)
+	, ignoreMatcher(ignoreMatcher)
+	, includeIgnored(includeIgnored)
+{
+}
+
+//------------------------------------------------------------------------------
+DirectoryWalker::~DirectoryWalker()
+{
+	qDeleteAll(queues);
+}
+
+//------------------------------------------------------------------------------
+bool DirectoryWalker::walk(entrylist_t &entries)
+{
+	int thread_count = qBound(1, QThread::idealThreadCount(), MAX_WALK_THREADS);
+
+	qDeleteAll(queues);
+	queues.clear();
+	for(int i=0; i<thread_count; ++i)
+		queues.append(new Queue);
+
+	failed.store(0);
+	directoryCount.store(0);
+
+	Directory root;
+	root.ignored = false;
+	push(0, root);
+
+	// Each worker collects its own entries, the calling thread being the first
+	QVector<entrylist_t> results(thread_count);
+	{
+		QThreadPool pool;
+		pool.setMaxThreadCount(qMax(1, thread_count-1));
+		for(int i=1; i<thread_count; ++i)
+			pool.start(new Worker(*this, i, results[i]));
+
+		run(0, results[0]);
+		pool.waitForDone();
+	}
+
+	int total = 0;
+	foreach(const entrylist_t &r, results)
+		total += r.size();
+
+	entries.clear();
+	entries.reserve(total);
+	foreach(const entrylist_t &r, results)
+		entries += r;
+
+	return !failed.load() && !aborted.load();
+}
+
+//------------------------------------------------------------------------------
+void DirectoryWalker::run(int worker, entrylist_t &entries)
+{
+	Directory dir;
+	while(!aborted.load())
+	{
+		if(pop(worker, dir))
+		{
+			// Unreadable subdirectories are skipped, like QDir does
+			if(!listDirectory(worker, dir, entries) && dir.path.isEmpty())
+				failed.store(1);
+
+			directoryCount.ref();
+
+			// Release the idle workers once the last directory is done
+			if(!pending.deref())
+			{
+				QMutexLocker lock(&idleMutex);
+				workAvailable.wakeAll();
+			}
+			continue;
+		}
+
+		if(pending.load()==0)
+			break;
+
+		QMutexLocker lock(&idleMutex);
+		workAvailable.wait(&idleMutex, IDLE_WAIT_MS);
+	}
+}
+
+//------------------------------------------------------------------------------
+void DirectoryWalker::push(int worker, const Directory &dir)
+{
+	pending.ref();
+
+	Queue *queue = queues[worker];
+	{
+		QMutexLocker lock(&queue->mutex);
+		queue->directories.append(dir);
+	}
+
+	workAvailable.wakeOne();
+}
+
+//------------------------------------------------------------------------------
+// Take the most recent directory of our own queue, or steal the oldest
+// one of another worker, which is likely to have the most below it
+bool DirectoryWalker::pop(int worker, Directory &dir)
+{
+	int count = queues.size();
+	for(int i=0; i<count; ++i)
+	{
+		Queue *queue = queues[(worker+i) % count];
+		QMutexLocker lock(&queue->mutex);
+		if(queue->directories.isEmpty())
+			continue;
+
+		if(i==0)
+			dir = queue->directories.takeLast();
+		else
+			dir = queue->directories.takeFirst();
+		return true;
+	}
+	return false;
+}
+
+//------------------------------------------------------------------------------
+void DirectoryWalker::addEntry(int worker, const Directory &dir, const QString &name, bool isDir, entrylist_t &entries)
+{
+	Entry entry;
+	entry.path = dir.path.isEmpty() ? name : dir.path + '/' + name;
+	entry.ignored = dir.ignored || ignoreMatcher.matches(entry.path);
+
+	if(entry.ignored && !includeIgnored)
+		return;
+
+	if(!isDir)
+	{
+		entries.append(entry);
+		return;
+	}
+
+	Directory subdir;
+	subdir.path = entry.path;
+	subdir.ignored = entry.ignored || ignoreMatcher.matchesAllBelow(entry.path);
+
+	// Prune subtrees where everything is ignored
+	if(subdir.ignored && !includeIgnored)
+		return;
+
+	push(worker, subdir);
+}
+
+//------------------------------------------------------------------------------
+bool DirectoryWalker::listDirectory(int worker, const Directory &dir, entrylist_t &entries)
+{
+	QString dir_path = dir.path.isEmpty() ? rootPath : rootPath + '/' + dir.path;
+
+#ifdef Q_OS_WIN
+	QDir qdir(dir_path);
+	if(!qdir.exists())
+		return false;
+
+	QFileInfoList list = qdir.entryInfoList(QDir::Dirs | QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot);
+	foreach(const QFileInfo &info, list)
+		addEntry(worker, dir, info.fileName(), info.isDir() && !info.isSymLink(), entries);
+	return true;
+#else
+	DIR *handle = opendir(QFile::encodeName(dir_path).constData());
+	if(!handle)
+		return false;
+
+	int fd = dirfd(handle);
+	while(struct dirent *de = readdir(handle))
+	{
+		if(aborted.load())
+			break;
+
+		const char *name = de->d_name;
+		if(name[0]=='.' && (name[1]==0 || (name[1]=='.' && name[2]==0)))
+			continue;
+
+		// Only stat when the filesystem does not report the type
+		bool is_dir = false;
+		bool is_file = false;
+#ifdef DT_DIR
+		if(de->d_type==DT_DIR)
+			is_dir = true;
+		else if(de->d_type==DT_REG || de->d_type==DT_LNK)
+			is_file = true;
+		else if(de->d_type==DT_UNKNOWN)
+#endif
+		{
+			struct stat st;
+			if(fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW)==0)
+			{
+				is_dir = S_ISDIR(st.st_mode);
+				is_file = S_ISREG(st.st_mode) || S_ISLNK(st.st_mode);
+			}
+		}
+
+		if(is_dir || is_file)
+			addEntry(worker, dir, QFile::decodeName(name), is_dir, entries);
+	}
+
+	closedir(handle);
+	return true;
+#endif
+}
@@ -0,0 +1,72 @@
+#ifndef DIRECTORYWALKER_H
+#define DIRECTORYWALKER_H
+
+#include <QString>
+#include <QVector>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include "GlobMatcher.h"
+
+//////////////////////////////////////////////////////////////////////////
+// DirectoryWalker
+// Lists the files below a directory on several threads. Each worker
+// keeps its own queue of directories and steals from the others once it
+// runs dry. Ignored directories are pruned unless ignored files are
+// wanted, and symbolic links are reported as files, never followed.
+//////////////////////////////////////////////////////////////////////////
+class DirectoryWalker
+{
+public:
+	struct Entry
+	{
+		QString		path;		// Relative to the root, separated by '/'
+		bool		ignored;
+	};
+	typedef QVector<Entry> entrylist_t;
+
+	DirectoryWalker(const QString &rootPath, const GlobMatcher &ignoreMatcher, bool includeIgnored);
+	~DirectoryWalker();
+
+	// Blocks until the walk completes. Fails if the root cannot be read or
+	// the walk was aborted
+	bool			walk(entrylist_t &entries);
+	void			abort() { aborted.store(1); }
+
+	int				getDirectoryCount() const { return directoryCount.load(); }
+
+private:
+	struct Directory
+	{
+		QString		path;
+		bool		ignored;
+	};
+
+	struct Queue
+	{
+		QMutex				mutex;
+		QList<Directory>	directories;
+	};
+
+	class Worker;
+
+	void			run(int worker, entrylist_t &entries);
+	void			push(int worker, const Directory &dir);
+	bool			pop(int worker, Directory &dir);
+	bool			listDirectory(int worker, const Directory &dir, entrylist_t &entries);
+	void			addEntry(int worker, const Directory &dir, const QString &name, bool isDir, entrylist_t &entries);
+
+	QString				rootPath;
+	const GlobMatcher	&ignoreMatcher;
+	bool				includeIgnored;
+	QVector<Queue *>	queues;
+	QAtomicInt			pending;		// Directories queued or being listed
+	QAtomicInt			aborted;
+	QAtomicInt			failed;
+	QAtomicInt			directoryCount;
+	QMutex				idleMutex;
+	QWaitCondition		workAvailable;
+};
+
+#endif // DIRECTORYWALKER_H
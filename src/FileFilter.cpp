@@ -0,0 +1,182 @@
+#include "FileFilter.h"
+#include <algorithm>
+
+//////////////////////////////////////////////////////////////////////////
+// FileFilter::Needle
+// A folded query and its Horspool shift table, keyed on the low byte
+//////////////////////////////////////////////////////////////////////////
+class FileFilter::Needle
+{
+public:
+	Needle(const QString &text)
+	{
+		chars.resize(text.length());
+		for(int i=0; i<text.length(); ++i)
+			chars[i] = foldChar(text[i].unicode());
+
+		int length = chars.size();
+		for(int i=0; i<256; ++i)
+			shifts[i] = length;
+		for(int i=0; i<length-1; ++i)
+			shifts[chars[i] & 0xFF] = length-1-i;
+	}
+
+	bool contains(const QVector<ushort> &other) const
+	{
+		return std::search(chars.begin(), chars.end(), other.begin(), other.end())!=chars.end();
+	}
+
+	// The first occurrence in [begin, end), or 0
+	const ushort *find(const ushort *begin, const ushort *end) const
+	{
+		const int length = chars.size();
+		const ushort *needle = chars.constData();
+		const ushort last = needle[length-1];
+
+		for(const ushort *pos=begin; end-pos>=length; )
+		{
+			ushort c = pos[length-1];
+			if(c==last)
+			{
+				int i = length-2;
+				while(i>=0 && pos[i]==needle[i])
+					--i;
+				if(i<0)
+					return pos;
+			}
+			pos += shifts[c & 0xFF];
+		}
+		return 0;
+	}
+
+	QVector<ushort>	chars;
+	int				shifts[256];
+};
+
+///////////////////////////////////////////////////////////////////////////////
+FileFilter::FileFilter()
+	: files(0)
+{
+}
+
+//------------------------------------------------------------------------------
+void FileFilter::clear()
+{
+	files = 0;
+	rows.clear();
+	buffer.clear();
+	offsets.clear();
+	lastText.clear();
+	lastEntries.clear();
+}
+
+//------------------------------------------------------------------------------
+void FileFilter::setRows(const FileTable &_files, const QVector<int> &_rows)
+{
+	clear();
+	files = &_files;
+	rows = _rows;
+}
+
+//------------------------------------------------------------------------------
+ushort FileFilter::foldChar(ushort c)
+{
+	if(c=='\\')
+		return '/';
+	if(c<0x80)
+		return (c>='A' && c<='Z') ? static_cast<ushort>(c+('a'-'A')) : c;
+	return static_cast<ushort>(QChar::toCaseFolded(static_cast<uint>(c)));
+}
+
+//------------------------------------------------------------------------------
+void FileFilter::buildBuffer()
+{
+	Q_ASSERT(files);
+
+	// Fold each directory once, the rows then only add their name
+	QVector<QVector<ushort> > folded_dirs(files->getDirCount());
+	QVector<bool> dir_folded(files->getDirCount(), false);
+
+	buffer.clear();
+	buffer.reserve(rows.size()*24);
+	offsets.resize(rows.size()+1);
+
+	for(int i=0; i<rows.size(); ++i)
+	{
+		int row = rows[i];
+		offsets[i] = buffer.size();
+
+		int dir_id = files->getDirId(row);
+		if(!dir_folded[dir_id])
+		{
+			const QString &dir = files->getDirPath(dir_id);
+			QVector<ushort> &folded = folded_dirs[dir_id];
+			folded.reserve(dir.length()+1);
+			for(int c=0; c<dir.length(); ++c)
+				folded.append(foldChar(dir[c].unicode()));
+			if(!dir.isEmpty())
+				folded.append('/');
+			dir_folded[dir_id] = true;
+		}
+		buffer += folded_dirs[dir_id];
+
+		QString name = files->getName(row);
+		for(int c=0; c<name.length(); ++c)
+			buffer.append(foldChar(name[c].unicode()));
+
+		// Keeps matches from spanning two paths
+		buffer.append(0);
+	}
+	offsets[rows.size()] = buffer.size();
+}
+
+//------------------------------------------------------------------------------
+void FileFilter::match(const QString &text, QVector<int> &result)
+{
+	result.clear();
+	if(text.isEmpty())
+	{
+		result = rows;
+		return;
+	}
+
+	if(offsets.size()!=rows.size()+1)
+		buildBuffer();
+
+	Needle needle(text);
+	QVector<int> entries;
+	const ushort *data = buffer.constData();
+
+	if(!lastText.isEmpty() && needle.contains(Needle(lastText).chars))
+	{
+		// A longer query can only match a subset of the previous matches
+		foreach(int entry, lastEntries)
+		{
+			if(needle.find(data+offsets[entry], data+offsets[entry+1]-1))
+				entries.append(entry);
+		}
+	}
+	else
+	{
+		const ushort *end = data + buffer.size();
+		const ushort *pos = data;
+		int entry = 0;
+		while((pos = needle.find(pos, end))!=0)
+		{
+			int at = pos - data;
+			while(offsets[entry+1]<=at)
+				++entry;
+			entries.append(entry);
+
+			// One match per path is enough
+			pos = data + offsets[entry+1];
+		}
+	}
+
+	lastText = text;
+	lastEntries = entries;
+
+	result.reserve(entries.size());
+	foreach(int entry, entries)
+		result.append(rows[entry]);
+}
@@ -0,0 +1,45 @@
+#ifndef FILEFILTER_H
+#define FILEFILTER_H
+
+#include <QString>
+#include <QVector>
+#include "FileTable.h"
+
+//////////////////////////////////////////////////////////////////////////
+// FileFilter
+// Matches a text against the paths of a list of file rows. The paths are
+// case folded into one buffer the first time they are searched, so that a
+// query is a single pass over contiguous memory. A query that extends the
+// previous one only rechecks the previous matches.
+//////////////////////////////////////////////////////////////////////////
+class FileFilter
+{
+public:
+	FileFilter();
+
+	void				clear();
+	void				setRows(const FileTable &files, const QVector<int> &rows);
+
+	// The rows whose path contains the text, in the order they were set
+	void				match(const QString &text, QVector<int> &result);
+
+	// Case insensitive, and either separator matches both
+	static ushort		foldChar(ushort c);
+
+private:
+	class Needle;
+
+	void				buildBuffer();
+
+	const FileTable		*files;
+	QVector<int>		rows;
+
+	// The folded paths, each followed by a 0, and where each of them starts
+	QVector<ushort>		buffer;
+	QVector<int>		offsets;
+
+	QString				lastText;
+	QVector<int>		lastEntries;
+};
+
+#endif // FILEFILTER_H
@@ -0,0 +1,117 @@
+#include "FileIconService.h"
+#include <QtConcurrent/QtConcurrentRun>
+#include <QMimeDatabase>
+
+//////////////////////////////////////////////////////////////////////////
+// ResolveTask
+// Finds the MIME type of one file per requested suffix
+//////////////////////////////////////////////////////////////////////////
+class ResolveTask
+{
+public:
+	typedef FileIconService::resolvedlist_t result_type;
+
+	ResolveTask(const FileIconService::requestlist_t &requests) : requests(requests)
+	{
+	}
+
+	result_type operator()()
+	{
+		QMimeDatabase mime_db;
+		result_type results;
+		foreach(const FileIconService::Request &request, requests)
+		{
+			QMimeType mime = mime_db.mimeTypeForFile(request.filePath);
+
+			FileIconService::Resolved r;
+			r.key = request.key;
+			r.filePath = request.filePath;
+			r.iconName = mime.iconName();
+			r.genericIconName = mime.genericIconName();
+			results.append(r);
+		}
+		return results;
+	}
+
+private:
+	FileIconService::requestlist_t requests;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+FileIconService::FileIconService(QObject *parent)
+	: QObject(parent)
+	, icons(MAX_ICONS)
+{
+	connect(&watcher, SIGNAL(finished()), this, SLOT(onResolved()));
+}
+
+//------------------------------------------------------------------------------
+FileIconService::~FileIconService()
+{
+	watcher.waitForFinished();
+}
+
+//------------------------------------------------------------------------------
+void FileIconService::clear()
+{
+	icons.clear();
+	queue.clear();
+	pending.clear();
+}
+
+//------------------------------------------------------------------------------
+QIcon FileIconService::getIcon(const QString &filePath, const QString &suffix)
+{
+	QString key = suffix.toLower();
+
+	QIcon *icon = icons.object(key);
+	if(icon)
+		return *icon;
+
+	if(!pending.contains(key))
+	{
+		pending.insert(key);
+		Request request = { key, filePath };
+		queue.append(request);
+		startNext();
+	}
+
+	if(placeholder.isNull())
+		placeholder = iconProvider.icon(QFileIconProvider::File);
+	return placeholder;
+}
+
+//------------------------------------------------------------------------------
+void FileIconService::startNext()
+{
+	if(watcher.isRunning() || queue.isEmpty())
+		return;
+
+	watcher.setFuture(QtConcurrent::run(ResolveTask(queue)));
+	queue.clear();
+}
+
+//------------------------------------------------------------------------------
+void FileIconService::onResolved()
+{
+	resolvedlist_t results = watcher.result();
+	foreach(const Resolved &r, results)
+	{
+		// Dropped by clear() while it was being resolved
+		if(!pending.remove(r.key))
+			continue;
+
+		// The theme knows the MIME icons on Linux, elsewhere the platform
+		// provides the icon of the file
+		QIcon icon = QIcon::fromTheme(r.iconName, QIcon::fromTheme(r.genericIconName));
+		if(icon.isNull())
+			icon = iconProvider.icon(QFileInfo(r.filePath));
+
+		icons.insert(r.key, new QIcon(icon));
+	}
+
+	if(!results.isEmpty())
+		emit iconsResolved();
+
+	startNext();
+}
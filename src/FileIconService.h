@@ -0,0 +1,67 @@
+#ifndef FILEICONSERVICE_H
+#define FILEICONSERVICE_H
+
+#include <QObject>
+#include <QFileIconProvider>
+#include <QFutureWatcher>
+#include <QCache>
+#include <QIcon>
+#include <QSet>
+#include <QList>
+
+//////////////////////////////////////////////////////////////////////////
+// FileIconService
+// File icons keyed by suffix. A miss returns a placeholder right away and
+// queues the suffix; its MIME type is looked up on a worker thread, since
+// that may read the file, and iconsResolved() is emitted once the icons
+// of a batch are known. At most MAX_ICONS icons are kept.
+//////////////////////////////////////////////////////////////////////////
+class FileIconService : public QObject
+{
+	Q_OBJECT
+public:
+	explicit FileIconService(QObject *parent=0);
+	~FileIconService();
+
+	QIcon				getIcon(const QString &filePath, const QString &suffix);
+	void				clear();
+
+	struct Request
+	{
+		QString		key;
+		QString		filePath;		// A file of that suffix, for the lookup
+	};
+	typedef QList<Request> requestlist_t;
+
+	struct Resolved
+	{
+		QString		key;
+		QString		filePath;
+		QString		iconName;
+		QString		genericIconName;
+	};
+	typedef QList<Resolved> resolvedlist_t;
+
+signals:
+	void				iconsResolved();
+
+private slots:
+	void				onResolved();
+
+private:
+	enum
+	{
+		MAX_ICONS = 256
+	};
+
+	void				startNext();
+
+	QFileIconProvider					iconProvider;
+	QIcon								placeholder;
+	QCache<QString, QIcon>				icons;
+	QSet<QString>						pending;	// Queued or being resolved
+	requestlist_t						queue;
+	QFutureWatcher<resolvedlist_t>		watcher;
+};
+
+#endif // FILEICONSERVICE_H
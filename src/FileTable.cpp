@@ -0,0 +1,574 @@
+#include "FileTable.h"
+
+// Smallest index capacity, always a power of two
+static const int MIN_INDEX_CAPACITY = 1024;
+
+// Written in native order, so that it only reads back in the same one
+static const quint32 BYTE_ORDER_MARKER = 0x01020304;
+
+///////////////////////////////////////////////////////////////////////////////
+FileTable::FileTable()
+{
+	clear();
+}
+
+//------------------------------------------------------------------------------
+void FileTable::clear()
+{
+	dirIds.clear();
+	nameOffsets.clear();
+	nameLengths.clear();
+	suffixOffsets.clear();
+	types.clear();
+	flags.clear();
+	sizes.clear();
+	mtimes.clear();
+	namePool.clear();
+	poolGarbage = 0;
+	freeRows.clear();
+	validCount = 0;
+	dirPaths.clear();
+	dirIndex.clear();
+	rebuildIndex(MIN_INDEX_CAPACITY);
+}
+
+//------------------------------------------------------------------------------
+void FileTable::beginUpdate()
+{
+	for(int i=0; i<flags.size(); ++i)
+		flags[i] &= ~(FLAG_UPDATED|FLAG_STAT);
+}
+
+//------------------------------------------------------------------------------
+void FileTable::endUpdate()
+{
+	for(int i=0; i<flags.size(); ++i)
+	{
+		if((flags[i] & FLAG_VALID) && !(flags[i] & FLAG_UPDATED))
+			remove(i);
+	}
+
+	if(poolGarbage > namePool.size()/2)
+		compactNames();
+}
+
+//------------------------------------------------------------------------------
+void FileTable::cancelUpdate()
+{
+	for(int i=0; i<flags.size(); ++i)
+	{
+		if(flags[i] & FLAG_VALID)
+			flags[i] |= FLAG_UPDATED;
+	}
+}
+
+//------------------------------------------------------------------------------
+// FNV-1a over the name, seeded with the directory
+uint FileTable::hashName(int dirId, const QChar *name, int length)
+{
+	uint hash = 2166136261u ^ static_cast<uint>(dirId);
+	for(int i=0; i<length; ++i)
+	{
+		hash ^= name[i].unicode();
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+//------------------------------------------------------------------------------
+void FileTable::splitPath(const QString &filePath, QString &dir, QString &name)
+{
+	int sep = filePath.lastIndexOf('/');
+	if(sep<0)
+	{
+		dir = "";
+		name = filePath;
+	}
+	else
+	{
+		dir = filePath.left(sep);
+		name = filePath.mid(sep+1);
+	}
+}
+
+//------------------------------------------------------------------------------
+int FileTable::internDir(const QString &dir)
+{
+	QHash<QString, int>::const_iterator it = dirIndex.constFind(dir);
+	if(it!=dirIndex.constEnd())
+		return it.value();
+
+	int id = dirPaths.size();
+	dirPaths.append(dir);
+	dirIndex.insert(dir, id);
+	return id;
+}
+
+//------------------------------------------------------------------------------
+int FileTable::findRow(int dirId, const QString &name, uint hash) const
+{
+	int mask = indexSlots.size()-1;
+	for(int i=hash & mask; ; i=(i+1) & mask)
+	{
+		int row = indexSlots[i];
+		if(row==SLOT_EMPTY)
+			return -1;
+		if(row==SLOT_REMOVED)
+			continue;
+
+		if(dirIds[row]==dirId && nameLengths[row]==name.length() &&
+			QStringRef(&namePool, nameOffsets[row], nameLengths[row])==name)
+			return row;
+	}
+}
+
+//------------------------------------------------------------------------------
+int FileTable::find(const QString &filePath) const
+{
+	QString dir;
+	QString name;
+	splitPath(filePath, dir, name);
+
+	int dir_id = findDir(dir);
+	if(dir_id<0)
+		return -1;
+
+	return findRow(dir_id, name, hashName(dir_id, name.constData(), name.length()));
+}
+
+//------------------------------------------------------------------------------
+void FileTable::insertSlot(int row, uint hash)
+{
+	int mask = indexSlots.size()-1;
+	int i = hash & mask;
+	while(indexSlots[i]>=0)
+		i = (i+1) & mask;
+
+	if(indexSlots[i]==SLOT_EMPTY)
+		++usedSlots;
+	indexSlots[i] = row;
+}
+
+//------------------------------------------------------------------------------
+void FileTable::rebuildIndex(int capacity)
+{
+	indexSlots.fill(SLOT_EMPTY, capacity);
+	usedSlots = 0;
+
+	for(int row=0; row<flags.size(); ++row)
+	{
+		if(isValid(row))
+			insertSlot(row, hashName(dirIds[row], namePool.constData()+nameOffsets[row], nameLengths[row]));
+	}
+}
+
+//------------------------------------------------------------------------------
+int FileTable::insert(const QString &filePath, WorkspaceFile::Type type, bool ignored)
+{
+	QString dir;
+	QString name;
+	splitPath(filePath, dir, name);
+
+	return insertName(internDir(dir), name, type, ignored);
+}
+
+//------------------------------------------------------------------------------
+int FileTable::insertName(int dirId, const QString &name, WorkspaceFile::Type type, bool ignored)
+{
+	uint hash = hashName(dirId, name.constData(), name.length());
+
+	int row = findRow(dirId, name, hash);
+	if(row<0)
+	{
+		// Keep the index at most three quarters full
+		if((usedSlots+1)*4 > indexSlots.size()*3)
+			rebuildIndex(qMax(MIN_INDEX_CAPACITY, indexSlots.size() * ((validCount+1)*2 > indexSlots.size() ? 2 : 1)));
+
+		if(!freeRows.isEmpty())
+			row = freeRows.takeLast();
+		else
+		{
+			row = flags.size();
+			dirIds.append(0);
+			nameOffsets.append(0);
+			nameLengths.append(0);
+			suffixOffsets.append(0);
+			types.append(0);
+			flags.append(0);
+			sizes.append(-1);
+			mtimes.append(-1);
+		}
+
+		int dot = name.lastIndexOf('.');
+		dirIds[row] = dirId;
+		nameOffsets[row] = namePool.size();
+		nameLengths[row] = static_cast<quint16>(name.length());
+		suffixOffsets[row] = static_cast<quint16>(dot<0 ? 0 : dot+1);
+		flags[row] = FLAG_VALID;
+		namePool.append(name);
+		insertSlot(row, hash);
+		++validCount;
+	}
+
+	types[row] = static_cast<quint16>(type);
+	flags[row] |= FLAG_UPDATED;
+	setIgnored(row, ignored);
+	return row;
+}
+
+//------------------------------------------------------------------------------
+void FileTable::remove(int row)
+{
+	Q_ASSERT(isValid(row));
+
+	uint hash = hashName(dirIds[row], namePool.constData()+nameOffsets[row], nameLengths[row]);
+	int mask = indexSlots.size()-1;
+	int i = hash & mask;
+	while(indexSlots[i]!=row)
+		i = (i+1) & mask;
+	indexSlots[i] = SLOT_REMOVED;
+
+	poolGarbage += nameLengths[row];
+	flags[row] = 0;
+	freeRows.append(row);
+	--validCount;
+}
+
+//------------------------------------------------------------------------------
+// Arrays are stored as their raw bytes, preceded by their size
+template<typename T>
+static void WriteArray(QDataStream &out, const QVector<T> &array)
+{
+	out << qint32(array.size());
+	out.writeRawData(reinterpret_cast<const char *>(array.constData()), array.size()*int(sizeof(T)));
+}
+
+//------------------------------------------------------------------------------
+template<typename T>
+static bool ReadArray(QDataStream &in, QVector<T> &array, int expectedSize=-1)
+{
+	qint32 size = -1;
+	in >> size;
+	if(in.status()!=QDataStream::Ok || size<0 || (expectedSize>=0 && size!=expectedSize))
+		return false;
+
+	qint64 bytes = size*qint64(sizeof(T));
+	if(in.device() && in.device()->bytesAvailable() < bytes)
+		return false;
+
+	array.resize(size);
+	return in.readRawData(reinterpret_cast<char *>(array.data()), int(bytes))==bytes;
+}
+
+//------------------------------------------------------------------------------
+// The arrays are written as they are, index included, so that loading is a
+// copy per array rather than an insert per row. The layout is native, with
+// a marker to reject snapshots from another byte order
+void FileTable::save(QDataStream &out) const
+{
+	const quint32 marker = BYTE_ORDER_MARKER;
+	out.writeRawData(reinterpret_cast<const char *>(&marker), sizeof(marker));
+
+	out << dirPaths << qint32(validCount) << qint32(usedSlots) << qint32(poolGarbage);
+	out << qint32(namePool.size());
+	out.writeRawData(reinterpret_cast<const char *>(namePool.constData()), namePool.size()*int(sizeof(QChar)));
+
+	out << qint32(flags.size());
+	WriteArray(out, dirIds);
+	WriteArray(out, nameOffsets);
+	WriteArray(out, nameLengths);
+	WriteArray(out, suffixOffsets);
+	WriteArray(out, types);
+	WriteArray(out, flags);
+	WriteArray(out, freeRows);
+	WriteArray(out, indexSlots);
+}
+
+//------------------------------------------------------------------------------
+bool FileTable::load(QDataStream &in)
+{
+	clear();
+	if(loadArrays(in))
+		return true;
+
+	clear();
+	return false;
+}
+
+//------------------------------------------------------------------------------
+bool FileTable::loadArrays(QDataStream &in)
+{
+	quint32 marker = 0;
+	if(in.readRawData(reinterpret_cast<char *>(&marker), sizeof(marker))!=sizeof(marker) || marker!=BYTE_ORDER_MARKER)
+		return false;
+
+	QStringList dirs;
+	qint32 valid_count = 0;
+	qint32 used_slots = 0;
+	qint32 pool_garbage = 0;
+	qint32 pool_size = -1;
+	in >> dirs >> valid_count >> used_slots >> pool_garbage >> pool_size;
+	if(in.status()!=QDataStream::Ok || pool_size<0)
+		return false;
+
+	qint64 pool_bytes = pool_size*qint64(sizeof(QChar));
+	if(in.device() && in.device()->bytesAvailable() < pool_bytes)
+		return false;
+
+	namePool = QString(pool_size, Qt::Uninitialized);
+	if(in.readRawData(reinterpret_cast<char *>(namePool.data()), int(pool_bytes))!=pool_bytes)
+		return false;
+
+	qint32 rows = -1;
+	in >> rows;
+	if(in.status()!=QDataStream::Ok || rows<0 ||
+		!ReadArray(in, dirIds, rows) || !ReadArray(in, nameOffsets, rows) || !ReadArray(in, nameLengths, rows) ||
+		!ReadArray(in, suffixOffsets, rows) || !ReadArray(in, types, rows) || !ReadArray(in, flags, rows) ||
+		!ReadArray(in, freeRows) || !ReadArray(in, indexSlots))
+		return false;
+
+	foreach(const QString &d, dirs)
+		internDir(d);
+
+	// Only the ranges are checked. The stat data is loaded again on demand
+	int valid = 0;
+	for(int row=0; row<rows; ++row)
+	{
+		flags[row] &= FLAG_VALID|FLAG_IGNORED;
+		if(!isValid(row))
+			continue;
+
+		if(dirIds[row]<0 || dirIds[row]>=dirPaths.size() || nameOffsets[row]<0 ||
+			qint64(nameOffsets[row])+nameLengths[row]>pool_size || suffixOffsets[row]>nameLengths[row])
+			return false;
+
+		flags[row] |= FLAG_UPDATED;
+		++valid;
+	}
+
+	int capacity = indexSlots.size();
+	if(valid!=valid_count || capacity<MIN_INDEX_CAPACITY || (capacity & (capacity-1))!=0 || used_slots>capacity)
+		return false;
+
+	foreach(int slot, indexSlots)
+	{
+		if(slot<SLOT_REMOVED || slot>=rows)
+			return false;
+	}
+
+	foreach(int row, freeRows)
+	{
+		if(row<0 || row>=rows || isValid(row))
+			return false;
+	}
+
+	sizes.fill(-1, rows);
+	mtimes.fill(-1, rows);
+	validCount = valid_count;
+	usedSlots = used_slots;
+	poolGarbage = pool_garbage;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+void FileTable::compactNames()
+{
+	QString pool;
+	pool.reserve(namePool.size() - poolGarbage);
+	for(int row=0; row<flags.size(); ++row)
+	{
+		if(!isValid(row))
+			continue;
+
+		int offset = pool.size();
+		pool.append(namePool.constData()+nameOffsets[row], nameLengths[row]);
+		nameOffsets[row] = offset;
+	}
+	namePool = pool;
+	poolGarbage = 0;
+}
+
+//------------------------------------------------------------------------------
+void FileTable::setIgnored(int row, bool ignored)
+{
+	if(ignored)
+		flags[row] |= FLAG_IGNORED;
+	else
+		flags[row] &= ~FLAG_IGNORED;
+}
+
+//------------------------------------------------------------------------------
+QString FileTable::getName(int row) const
+{
+	return namePool.mid(nameOffsets[row], nameLengths[row]);
+}
+
+//------------------------------------------------------------------------------
+QString FileTable::getSuffix(int row) const
+{
+	int offset = suffixOffsets[row];
+	if(offset==0)
+		return QString();
+	return namePool.mid(nameOffsets[row]+offset, nameLengths[row]-offset);
+}
+
+//------------------------------------------------------------------------------
+QString FileTable::getFilePath(int row) const
+{
+	const QString &dir = dirPaths[dirIds[row]];
+	if(dir.isEmpty())
+		return getName(row);
+
+	QString path;
+	path.reserve(dir.length()+1+nameLengths[row]);
+	path += dir;
+	path += '/';
+	path.append(namePool.constData()+nameOffsets[row], nameLengths[row]);
+	return path;
+}
+
+//------------------------------------------------------------------------------
+QFileInfo FileTable::getFileInfo(int row) const
+{
+	return QFileInfo(rootPath + '/' + getFilePath(row));
+}
+
+//------------------------------------------------------------------------------
+void FileTable::loadStat(int row) const
+{
+	if(flags[row] & FLAG_STAT)
+		return;
+
+	QFileInfo info = getFileInfo(row);
+	sizes[row] = info.exists() ? info.size() : -1;
+	mtimes[row] = info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+	flags[row] |= FLAG_STAT;
+}
+
+//------------------------------------------------------------------------------
+qint64 FileTable::getSize(int row) const
+{
+	loadStat(row);
+	return sizes[row];
+}
+
+//------------------------------------------------------------------------------
+QDateTime FileTable::getModified(int row) const
+{
+	loadStat(row);
+	if(mtimes[row]<0)
+		return QDateTime();
+	return QDateTime::fromMSecsSinceEpoch(mtimes[row]);
+}
+
+//------------------------------------------------------------------------------
+// Compares "dir/name" of both rows as a single string would
+bool FileTable::lessThan(int rowA, int rowB) const
+{
+	const QString &dir_a = dirPaths[dirIds[rowA]];
+	const QString &dir_b = dirPaths[dirIds[rowB]];
+
+	// The root directory has no separator
+	static const QChar SEPARATOR('/');
+
+	const QChar *parts_a[] = { dir_a.constData(), &SEPARATOR, namePool.constData()+nameOffsets[rowA] };
+	const int lengths_a[] = { dir_a.length(), dir_a.isEmpty() ? 0 : 1, nameLengths[rowA] };
+	const QChar *parts_b[] = { dir_b.constData(), &SEPARATOR, namePool.constData()+nameOffsets[rowB] };
+	const int lengths_b[] = { dir_b.length(), dir_b.isEmpty() ? 0 : 1, nameLengths[rowB] };
+
+	int part_a = 0, part_b = 0;
+	int pos_a = 0, pos_b = 0;
+	for(;;)
+	{
+		while(part_a<3 && pos_a==lengths_a[part_a])
+		{
+			++part_a;
+			pos_a = 0;
+		}
+		while(part_b<3 && pos_b==lengths_b[part_b])
+		{
+			++part_b;
+			pos_b = 0;
+		}
+
+		if(part_a==3 || part_b==3)
+			return part_a==3 && part_b!=3;
+
+		ushort a = parts_a[part_a][pos_a].unicode();
+		ushort b = parts_b[part_b][pos_b].unicode();
+		if(a!=b)
+			return a<b;
+		++pos_a;
+		++pos_b;
+	}
+}
+
+//------------------------------------------------------------------------------
+qint64 FileTable::getMemoryUsage() const
+{
+	qint64 bytes = 0;
+	bytes += dirIds.capacity() * sizeof(qint32);
+	bytes += nameOffsets.capacity() * sizeof(qint32);
+	bytes += nameLengths.capacity() * sizeof(quint16);
+	bytes += suffixOffsets.capacity() * sizeof(quint16);
+	bytes += types.capacity() * sizeof(quint16);
+	bytes += flags.capacity() * sizeof(quint8);
+	bytes += sizes.capacity() * sizeof(qint64);
+	bytes += mtimes.capacity() * sizeof(qint64);
+	bytes += namePool.capacity() * sizeof(QChar);
+	bytes += freeRows.capacity() * sizeof(int);
+	bytes += indexSlots.capacity() * sizeof(int);
+
+	foreach(const QString &d, dirPaths)
+		bytes += d.capacity() * sizeof(QChar);
+	bytes += dirPaths.size() * (sizeof(void *) + sizeof(QString) + sizeof(int) + sizeof(void *)*2); // List and hash nodes
+	return bytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+WorkspaceFile::Type WorkspaceFile::getType() const
+{
+	return table->getType(row);
+}
+
+//------------------------------------------------------------------------------
+bool WorkspaceFile::isIgnored() const
+{
+	return table->isIgnored(row);
+}
+
+//------------------------------------------------------------------------------
+QFileInfo WorkspaceFile::getFileInfo() const
+{
+	return table->getFileInfo(row);
+}
+
+//------------------------------------------------------------------------------
+QString WorkspaceFile::getFilePath() const
+{
+	return table->getFilePath(row);
+}
+
+//------------------------------------------------------------------------------
+QString WorkspaceFile::getFilename() const
+{
+	return table->getName(row);
+}
+
+//------------------------------------------------------------------------------
+const QString &WorkspaceFile::getPath() const
+{
+	return table->getDirPath(table->getDirId(row));
+}
+
+//------------------------------------------------------------------------------
+QString WorkspaceFile::getSuffix() const
+{
+	return table->getSuffix(row);
+}
+
+//------------------------------------------------------------------------------
+QDateTime WorkspaceFile::getModified() const
+{
+	return table->getModified(row);
+}
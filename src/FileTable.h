@@ -0,0 +1,166 @@
+#ifndef FILETABLE_H
+#define FILETABLE_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDataStream>
+#include "WorkspaceCommon.h"
+
+//////////////////////////////////////////////////////////////////////////
+// FileTable
+// The files of a workspace, stored as one array per attribute. File names
+// live in a shared pool and directories are interned, so a row costs a few
+// dozen bytes instead of a heap object with a QFileInfo. Rows keep their
+// id across refreshes for as long as the file is listed.
+//////////////////////////////////////////////////////////////////////////
+class FileTable
+{
+public:
+	//////////////////////////////////////////////////////////////////////////
+	// FileTable::const_iterator
+	// Visits the valid rows in row order
+	//////////////////////////////////////////////////////////////////////////
+	class const_iterator
+	{
+	public:
+		const_iterator(const FileTable *table, int row) : table(table), row(row)
+		{
+			skipInvalid();
+		}
+
+		WorkspaceFile operator*() const { return WorkspaceFile(table, row); }
+		int getRow() const { return row; }
+
+		const_iterator &operator++()
+		{
+			++row;
+			skipInvalid();
+			return *this;
+		}
+
+		bool operator==(const const_iterator &o) const { return row==o.row; }
+		bool operator!=(const const_iterator &o) const { return row!=o.row; }
+
+	private:
+		void skipInvalid()
+		{
+			while(row < table->getRowCount() && !table->isValid(row))
+				++row;
+		}
+
+		const FileTable	*table;
+		int				row;
+	};
+
+	FileTable();
+
+	void				clear();
+	void				setRootPath(const QString &path) { rootPath = path; }
+	const QString		&getRootPath() const { return rootPath; }
+
+	// Rows of the files inserted between beginUpdate() and endUpdate() keep
+	// their ids, and the rest are removed by endUpdate()
+	void				beginUpdate();
+	void				endUpdate();
+	// Ends an update that did not complete, keeping all the rows
+	void				cancelUpdate();
+	bool				isUpdated(int row) const { return (flags[row] & FLAG_UPDATED)!=0; }
+
+	int					insert(const QString &filePath, WorkspaceFile::Type type, bool ignored=false);
+	void				remove(int row);
+	int					find(const QString &filePath) const;
+
+	// Serialization of the whole table, in the native layout of the arrays.
+	// Loading replaces the table
+	void				save(QDataStream &out) const;
+	bool				load(QDataStream &in);
+
+	int					size() const { return validCount; }
+	int					getRowCount() const { return flags.size(); }
+	bool				isValid(int row) const { return (flags[row] & FLAG_VALID)!=0; }
+	WorkspaceFile		at(int row) const { return WorkspaceFile(this, row); }
+
+	const_iterator		begin() const { return const_iterator(this, 0); }
+	const_iterator		end() const { return const_iterator(this, getRowCount()); }
+
+	// Row attributes
+	WorkspaceFile::Type	getType(int row) const { return static_cast<WorkspaceFile::Type>(types[row]); }
+	void				setType(int row, WorkspaceFile::Type type) { types[row] = static_cast<quint16>(type); }
+	bool				isIgnored(int row) const { return (flags[row] & FLAG_IGNORED)!=0; }
+	void				setIgnored(int row, bool ignored);
+	int					getDirId(int row) const { return dirIds[row]; }
+	QString				getName(int row) const;
+	QString				getSuffix(int row) const;
+	QString				getFilePath(int row) const;
+	QFileInfo			getFileInfo(int row) const;
+	qint64				getSize(int row) const;
+	QDateTime			getModified(int row) const;
+	void				invalidateStat(int row) { flags[row] &= ~FLAG_STAT; }
+
+	// Order of the file paths, without building them
+	bool				lessThan(int rowA, int rowB) const;
+
+	// Directories
+	int					getDirCount() const { return dirPaths.size(); }
+	const QString		&getDirPath(int dirId) const { return dirPaths[dirId]; }
+	int					findDir(const QString &dirPath) const { return dirIndex.value(dirPath, -1); }
+
+	// Approximate heap usage of the table
+	qint64				getMemoryUsage() const;
+
+private:
+	enum
+	{
+		FLAG_VALID		= 1<<0,
+		FLAG_IGNORED	= 1<<1,
+		FLAG_UPDATED	= 1<<2,
+		FLAG_STAT		= 1<<3		// Size and mtime are loaded
+	};
+
+	enum
+	{
+		SLOT_EMPTY		= -1,
+		SLOT_REMOVED	= -2
+	};
+
+	static uint			hashName(int dirId, const QChar *name, int length);
+	static void			splitPath(const QString &filePath, QString &dir, QString &name);
+	int					internDir(const QString &dir);
+	int					insertName(int dirId, const QString &name, WorkspaceFile::Type type, bool ignored);
+	int					findRow(int dirId, const QString &name, uint hash) const;
+	void				insertSlot(int row, uint hash);
+	void				rebuildIndex(int capacity);
+	void				compactNames();
+	bool				loadArrays(QDataStream &in);
+	void				loadStat(int row) const;
+
+	QString				rootPath;
+
+	// Per row
+	QVector<qint32>		dirIds;
+	QVector<qint32>		nameOffsets;
+	QVector<quint16>	nameLengths;
+	QVector<quint16>	suffixOffsets;	// Offset of the suffix within the name, 0 if none
+	QVector<quint16>	types;
+	mutable QVector<quint8>	flags;
+	mutable QVector<qint64>	sizes;
+	mutable QVector<qint64>	mtimes;		// msecs since epoch
+
+	QString				namePool;
+	int					poolGarbage;
+	QVector<int>		freeRows;
+	int					validCount;
+
+	// Open addressing index of the rows by path
+	QVector<int>		indexSlots;
+	int					usedSlots;		// Including the removed ones
+
+	QStringList			dirPaths;
+	QHash<QString, int>	dirIndex;
+};
+
+#endif // FILETABLE_H
@@ -0,0 +1,417 @@
+#include "FileTableModel.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QApplication>
+#include <QPalette>
+#include <algorithm>
+#include "Utils.h"
+
+// The texts keep the MainWindow context of the existing translations
+static const char *const COLUMN_TITLES[FileTableModel::COLUMN_COUNT] =
+{
+	QT_TRANSLATE_NOOP("MainWindow", "Status"),
+	QT_TRANSLATE_NOOP("MainWindow", "File"),
+	QT_TRANSLATE_NOOP("MainWindow", "Extension"),
+	QT_TRANSLATE_NOOP("MainWindow", "Modified"),
+	QT_TRANSLATE_NOOP("MainWindow", "Path")
+};
+
+static const struct { WorkspaceFile::Type type; const char *text; const char *icon; }
+STATUS_TYPES[] =
+{
+	{   WorkspaceFile::TYPE_EDITTED, QT_TRANSLATE_NOOP("MainWindow", "Edited"), ":icons/icon-item-edited" },
+	{   WorkspaceFile::TYPE_UNCHANGED, QT_TRANSLATE_NOOP("MainWindow", "Unchanged"), ":icons/icon-item-unchanged" },
+	{   WorkspaceFile::TYPE_ADDED, QT_TRANSLATE_NOOP("MainWindow", "Added"), ":icons/icon-item-added" },
+	{   WorkspaceFile::TYPE_DELETED, QT_TRANSLATE_NOOP("MainWindow", "Deleted"), ":icons/icon-item-deleted" },
+	{   WorkspaceFile::TYPE_RENAMED, QT_TRANSLATE_NOOP("MainWindow", "Renamed"), ":icons/icon-item-renamed" },
+	{   WorkspaceFile::TYPE_MISSING, QT_TRANSLATE_NOOP("MainWindow", "Missing"), ":icons/icon-item-missing" },
+	{   WorkspaceFile::TYPE_CONFLICTED, QT_TRANSLATE_NOOP("MainWindow", "Conflicted"), ":icons/icon-item-conflicted" },
+	{   WorkspaceFile::TYPE_MERGED, QT_TRANSLATE_NOOP("MainWindow", "Merged"), ":icons/icon-item-edited" },
+};
+
+static const char *const STATUS_UNKNOWN_TEXT = QT_TRANSLATE_NOOP("MainWindow", "Unknown");
+static const char *const STATUS_UNKNOWN_ICON = ":icons/icon-item-unknown";
+
+//------------------------------------------------------------------------------
+static int FindStatus(WorkspaceFile::Type type)
+{
+	for(size_t t=0; t<COUNTOF(STATUS_TYPES); ++t)
+	{
+		if(STATUS_TYPES[t].type == type)
+			return int(t);
+	}
+	return -1;
+}
+
+//------------------------------------------------------------------------------
+static QString GetStatusText(WorkspaceFile::Type type)
+{
+	int status = FindStatus(type);
+	return QCoreApplication::translate("MainWindow", status<0 ? STATUS_UNKNOWN_TEXT : STATUS_TYPES[status].text);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Sorting
+//////////////////////////////////////////////////////////////////////////
+struct PathLess
+{
+	PathLess(const FileTable &files) : files(files)
+	{
+	}
+
+	bool operator()(int l, int r) const
+	{
+		return files.lessThan(l, r);
+	}
+
+	const FileTable &files;
+};
+
+struct SortKey
+{
+	QString	text;
+	qint64	number;
+	int		row;
+
+	bool operator<(const SortKey &o) const
+	{
+		if(text!=o.text)
+			return text < o.text;
+		return number < o.number;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+FileTableModel::FileTableModel(const FileTable &files, QObject *parent)
+	: QAbstractTableModel(parent)
+	, files(files)
+	, displayPath(false)
+	, sortColumn(-1)
+	, sortOrder(Qt::AscendingOrder)
+	, markStale(false)
+{
+	connect(&iconService, SIGNAL(iconsResolved()), this, SLOT(onIconsResolved()));
+}
+
+//------------------------------------------------------------------------------
+int FileTableModel::rowCount(const QModelIndex &parent) const
+{
+	return parent.isValid() ? 0 : rows.size();
+}
+
+//------------------------------------------------------------------------------
+int FileTableModel::columnCount(const QModelIndex &parent) const
+{
+	return parent.isValid() ? 0 : COLUMN_COUNT;
+}
+
+//------------------------------------------------------------------------------
+QVariant FileTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+	if(orientation!=Qt::Horizontal || section<0 || section>=COLUMN_COUNT)
+		return QVariant();
+
+	if(role==Qt::DisplayRole)
+		return QCoreApplication::translate("MainWindow", COLUMN_TITLES[section]);
+	else if(role==Qt::TextAlignmentRole && section==COLUMN_STATUS)
+		return int(Qt::AlignCenter);
+
+	return QVariant();
+}
+
+//------------------------------------------------------------------------------
+QVariant FileTableModel::data(const QModelIndex &index, int role) const
+{
+	if(!index.isValid() || index.row()>=rows.size())
+		return QVariant();
+
+	// The table may have moved on since the rows were set
+	int row = rows[index.row()];
+	if(!isLive(row))
+		return QVariant();
+
+	if(role==ROLE_FILE_PATH)
+		return files.getFilePath(row);
+
+	// Rows from the snapshot the running scan has not confirmed yet
+	if(role==Qt::ForegroundRole)
+	{
+		if(markStale && !files.isUpdated(row))
+			return QApplication::palette().brush(QPalette::Disabled, QPalette::Text);
+		return QVariant();
+	}
+
+	switch(index.column())
+	{
+	case COLUMN_STATUS:
+		{
+			if(role==Qt::DisplayRole || role==Qt::ToolTipRole)
+				return GetStatusText(files.getType(row));
+			else if(role==Qt::DecorationRole)
+			{
+				int status = FindStatus(files.getType(row));
+				const char *icon = status<0 ? STATUS_UNKNOWN_ICON : STATUS_TYPES[status].icon;
+				if(!iconCache.contains(icon))
+					iconCache.insert(icon, QIcon(icon));
+				return iconCache[icon];
+			}
+			break;
+		}
+	case COLUMN_FILENAME:
+		if(role==Qt::DisplayRole)
+			return displayPath ? QDir::toNativeSeparators(files.getFilePath(row)) : files.getName(row);
+		else if(role==Qt::DecorationRole)
+			return getFileIcon(row);
+		break;
+	case COLUMN_EXTENSION:
+		if(role==Qt::DisplayRole)
+			return files.getSuffix(row);
+		break;
+	case COLUMN_MODIFIED:
+		if(role==Qt::DisplayRole)
+			return files.getModified(row).toString(Qt::SystemLocaleShortDate);
+		break;
+	case COLUMN_PATH:
+		if(role==Qt::DisplayRole)
+			return files.getDirPath(files.getDirId(row));
+		break;
+	}
+
+	return QVariant();
+}
+
+//------------------------------------------------------------------------------
+QIcon FileTableModel::getFileIcon(int row) const
+{
+	return iconService.getIcon(files.getFileInfo(row).absoluteFilePath(), files.getSuffix(row));
+}
+
+//------------------------------------------------------------------------------
+void FileTableModel::onIconsResolved()
+{
+	// Only the rows in view are repainted
+	if(!rows.isEmpty())
+		emit dataChanged(index(0, COLUMN_FILENAME), index(rows.size()-1, COLUMN_FILENAME), QVector<int>() << Qt::DecorationRole);
+}
+
+//------------------------------------------------------------------------------
+void FileTableModel::setMarkStale(bool mark)
+{
+	if(mark==markStale)
+		return;
+
+	markStale = mark;
+	if(!rows.isEmpty())
+		emit dataChanged(index(0, 0), index(rows.size()-1, COLUMN_COUNT-1), QVector<int>() << Qt::ForegroundRole);
+}
+
+//------------------------------------------------------------------------------
+void FileTableModel::sortRows(QVector<int> &fileRows) const
+{
+	// Path order is the default and the tie breaker of the other columns
+	std::sort(fileRows.begin(), fileRows.end(), PathLess(files));
+
+	bool keyed = sortColumn==COLUMN_STATUS || sortColumn==COLUMN_EXTENSION || sortColumn==COLUMN_MODIFIED
+			|| (sortColumn==COLUMN_FILENAME && !displayPath);
+
+	if(keyed)
+	{
+		QVector<SortKey> keys(fileRows.size());
+		for(int i=0; i<fileRows.size(); ++i)
+		{
+			SortKey &key = keys[i];
+			key.row = fileRows[i];
+			key.number = 0;
+			if(sortColumn==COLUMN_STATUS)
+				key.text = GetStatusText(files.getType(key.row));
+			else if(sortColumn==COLUMN_EXTENSION)
+				key.text = files.getSuffix(key.row);
+			else if(sortColumn==COLUMN_MODIFIED)
+				key.number = files.getModified(key.row).toMSecsSinceEpoch();
+			else
+				key.text = files.getName(key.row);
+		}
+
+		std::stable_sort(keys.begin(), keys.end());
+
+		for(int i=0; i<keys.size(); ++i)
+			fileRows[i] = keys[i].row;
+	}
+
+	if(sortColumn>=0 && sortOrder==Qt::DescendingOrder)
+		std::reverse(fileRows.begin(), fileRows.end());
+}
+
+//------------------------------------------------------------------------------
+void FileTableModel::sort(int column, Qt::SortOrder order)
+{
+	sortColumn = column;
+	sortOrder = order;
+
+	emit layoutAboutToBeChanged();
+
+	// The filter keeps the order of the rows it was given
+	sortRows(allRows);
+	filter.setRows(files, allRows);
+
+	QVector<int> sorted;
+	filter.match(filterText, sorted);
+
+	// Map the persistent indexes, such as the selection, to the new positions
+	QHash<int, int> positions;
+	positions.reserve(sorted.size());
+	for(int i=0; i<sorted.size(); ++i)
+		positions.insert(sorted[i], i);
+
+	QModelIndexList from = persistentIndexList();
+	QModelIndexList to;
+	foreach(const QModelIndex &mi, from)
+		to.append(index(positions.value(rows[mi.row()]), mi.column()));
+	changePersistentIndexList(from, to);
+
+	rows = sorted;
+
+	emit layoutChanged();
+}
+
+//------------------------------------------------------------------------------
+void FileTableModel::clear()
+{
+	beginResetModel();
+	rows.clear();
+	allRows.clear();
+	filter.clear();
+	endResetModel();
+}
+
+//------------------------------------------------------------------------------
+void FileTableModel::setRows(const QVector<int> &fileRows, bool _displayPath)
+{
+	displayPath = _displayPath;
+
+	allRows = fileRows;
+	sortRows(allRows);
+	filter.setRows(files, allRows);
+
+	QVector<int> new_rows;
+	filter.match(filterText, new_rows);
+	applyRows(new_rows);
+}
+
+//------------------------------------------------------------------------------
+void FileTableModel::setFilterText(const QString &text)
+{
+	if(text==filterText)
+		return;
+
+	filterText = text;
+
+	QVector<int> new_rows;
+	filter.match(filterText, new_rows);
+	applyRows(new_rows);
+}
+
+//------------------------------------------------------------------------------
+void FileTableModel::applyRows(const QVector<int> &newRows)
+{
+	int row_count = files.getRowCount();
+	QVector<bool> in_old(row_count, false);
+	QVector<bool> in_new(row_count, false);
+	foreach(int row, rows)
+	{
+		if(row<row_count)
+			in_old[row] = true;
+	}
+	foreach(int row, newRows)
+		in_new[row] = true;
+
+	// Count the ranges to remove, and check that the rows that stay are
+	// listed in the same order, so that the rest are plain insertions
+	int ranges = 0;
+	QVector<int> kept;
+	kept.reserve(rows.size());
+	bool removing = false;
+	foreach(int row, rows)
+	{
+		bool stays = row<row_count && in_new[row];
+		if(stays)
+			kept.append(row);
+		else if(!removing)
+			++ranges;
+		removing = !stays;
+	}
+
+	bool in_order = true;
+	bool inserting = false;
+	int next_kept = 0;
+	foreach(int row, newRows)
+	{
+		bool insert = true;
+		if(next_kept<kept.size() && kept[next_kept]==row)
+		{
+			++next_kept;
+			insert = false;
+		}
+		else if(in_old[row])
+		{
+			in_order = false;
+			break;
+		}
+
+		if(insert && !inserting)
+			++ranges;
+		inserting = insert;
+	}
+
+	if(!in_order || next_kept!=kept.size() || ranges>MAX_CHANGE_RANGES)
+	{
+		beginResetModel();
+		rows = newRows;
+		endResetModel();
+		return;
+	}
+
+	// Removals, from the end so that the positions stay valid
+	for(int i=rows.size()-1; i>=0; )
+	{
+		if(rows[i]<row_count && in_new[rows[i]])
+		{
+			--i;
+			continue;
+		}
+
+		int last = i;
+		while(i>=0 && !(rows[i]<row_count && in_new[rows[i]]))
+			--i;
+
+		beginRemoveRows(QModelIndex(), i+1, last);
+		rows.remove(i+1, last-i);
+		endRemoveRows();
+	}
+
+	// Insertions, from the start so that the prefix matches the new rows
+	for(int i=0; i<newRows.size(); )
+	{
+		if(i<rows.size() && rows[i]==newRows[i])
+		{
+			++i;
+			continue;
+		}
+
+		int first = i;
+		while(i<newRows.size() && !in_old[newRows[i]])
+			++i;
+
+		beginInsertRows(QModelIndex(), first, i-1);
+		rows.insert(first, i-first, 0);
+		for(int r=first; r<i; ++r)
+			rows[r] = newRows[r];
+		endInsertRows();
+	}
+
+	Q_ASSERT(rows==newRows);
+
+	// The status, date and display path of the remaining rows may have changed
+	if(!rows.isEmpty())
+		emit dataChanged(index(0, 0), index(rows.size()-1, COLUMN_COUNT-1));
+}
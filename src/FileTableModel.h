@@ -0,0 +1,89 @@
+#ifndef FILETABLEMODEL_H
+#define FILETABLEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QVector>
+#include <QHash>
+#include <QIcon>
+#include "FileTable.h"
+#include "FileFilter.h"
+#include "FileIconService.h"
+
+//////////////////////////////////////////////////////////////////////////
+// FileTableModel
+// The file list as a view over rows of the FileTable. Nothing is stored
+// per row besides the row id; the texts, dates and icons are produced in
+// data() and therefore only for the rows the view actually paints.
+//////////////////////////////////////////////////////////////////////////
+class FileTableModel : public QAbstractTableModel
+{
+	Q_OBJECT
+public:
+	enum Column
+	{
+		COLUMN_STATUS,
+		COLUMN_FILENAME,
+		COLUMN_EXTENSION,
+		COLUMN_MODIFIED,
+		COLUMN_PATH,
+		COLUMN_COUNT
+	};
+
+	enum
+	{
+		ROLE_FILE_PATH = Qt::UserRole+1
+	};
+
+	explicit FileTableModel(const FileTable &files, QObject *parent=0);
+
+	// Replaces the listed rows. Rows present before and after keep their
+	// model index, so the view only sees the insertions and removals.
+	void				setRows(const QVector<int> &fileRows, bool displayPath);
+	void				clear();
+
+	// Greys out the rows not updated since the table was loaded
+	void				setMarkStale(bool mark);
+
+	// Only the rows whose path contains the text are listed
+	void				setFilterText(const QString &text);
+
+	int					getFileRow(int modelRow) const { return rows[modelRow]; }
+	const QVector<int>	&getFileRows() const { return rows; }
+	int					findRow(int fileRow) const { return rows.indexOf(fileRow); }
+
+	int					rowCount(const QModelIndex &parent=QModelIndex()) const;
+	int					columnCount(const QModelIndex &parent=QModelIndex()) const;
+	QVariant			data(const QModelIndex &index, int role=Qt::DisplayRole) const;
+	QVariant			headerData(int section, Qt::Orientation orientation, int role=Qt::DisplayRole) const;
+	void				sort(int column, Qt::SortOrder order=Qt::AscendingOrder);
+
+private slots:
+	void				onIconsResolved();
+
+private:
+	enum
+	{
+		// Beyond this many changed ranges a reset is cheaper for the view
+		MAX_CHANGE_RANGES = 64
+	};
+
+	void				sortRows(QVector<int> &fileRows) const;
+	void				applyRows(const QVector<int> &newRows);
+	bool				isLive(int row) const { return row<files.getRowCount() && files.isValid(row); }
+	QIcon				getFileIcon(int row) const;
+
+	const FileTable		&files;
+	QVector<int>		rows;
+	QVector<int>		allRows;		// Before the filter, in the order of the rows
+	FileFilter			filter;
+	QString				filterText;
+	bool				displayPath;
+	int					sortColumn;		// -1 for path order
+	Qt::SortOrder		sortOrder;
+	bool				markStale;
+
+	mutable FileIconService			iconService;	// File icons
+	mutable QHash<QString, QIcon>	iconCache;		// Status icons
+};
+
+#endif // FILETABLEMODEL_H
@@ -6,13 +6,19 @@
 #include <QDir>
 #include <QTemporaryFile>
 #include <QUrl>
+#include <QStandardPaths>
+#include <string.h>
 #include "Utils.h"
+#include "FossilDb.h"
+#include "ChangeDetector.h"
 
 static const unsigned char		UTF8_BOM[] = { 0xEF, 0xBB, 0xBF };
 
 ///////////////////////////////////////////////////////////////////////////////
 Fossil::Fossil()
 	: uiCallback(0)
+	, capabilitiesProbed(false)
+	, verifyChanges(false)
 {
 }
 
@@ -28,12 +34,15 @@ void Fossil::Init(UICallback *callback, const QString &exePath)
 //------------------------------------------------------------------------------
 WorkspaceState Fossil::getWorkspaceState()
 {
+	if(readWorkspaceState())
+		return WORKSPACE_STATE_OK;
+
 	QStringList res;
 	int exit_code = EXIT_FAILURE;
 
 	// We need to determine the reason why fossil has failed
 	// so we delay processing of the exit_code
-	if(!runFossilRaw(QStringList() << "info", &res, &exit_code, RUNFLAGS_SILENT_ALL))
+	if(!runFossilRaw(QStringList() << "info", &res, &exit_code, RUNFLAGS_SILENT_ALL|RUNFLAGS_TIMEOUT_METADATA))
 		return WORKSPACE_STATE_NOTFOUND;
 
 	bool run_ok = exit_code == EXIT_SUCCESS;
@@ -73,7 +82,7 @@ WorkspaceState Fossil::getWorkspaceState()
 			{
 				QStringList tokens = value.split(',', QString::SkipEmptyParts);
 				foreach(const QString &tag, tokens)
-					activeTags.append(tag);
+					activeTags.append(tag.trimmed());
 				activeTags.sort();
 			}
 		}
@@ -137,24 +146,399 @@ void Fossil::setWorkspace(const QString &_workspacePath)
 }
 
 //------------------------------------------------------------------------------
-bool Fossil::listFiles(QStringList &files)
+#define STATUS_IS(literal)	(length==sizeof(literal)-1 && memcmp(text, literal, sizeof(literal)-1)==0)
+
+// Map a status keyword from "fossil ls -l" or "fossil changes --classify"
+// to a file type. The first character selects the few candidates that need
+// a full comparison. Only EXTRA files are untracked, and the changes to the
+// permissions or the kind of a tracked file count as edits.
+static WorkspaceFile::Type ParseFileStatus(const char *text, int length)
+{
+	switch(text[0])
+	{
+	case 'A':
+		if(STATUS_IS("ADDED"))
+			return WorkspaceFile::TYPE_ADDED;
+		if(STATUS_IS("ADDED_BY_MERGE") || STATUS_IS("ADDED_BY_INTEGRATE"))
+			return WorkspaceFile::TYPE_MERGED;
+		break;
+	case 'C':
+		if(STATUS_IS("CONFLICT"))
+			return WorkspaceFile::TYPE_CONFLICTED;
+		break;
+	case 'D':
+		if(STATUS_IS("DELETED"))
+			return WorkspaceFile::TYPE_DELETED;
+		break;
+	case 'E':
+		if(STATUS_IS("EDITED"))
+			return WorkspaceFile::TYPE_EDITTED;
+		if(STATUS_IS("EXTRA"))
+			return WorkspaceFile::TYPE_UNKNOWN;
+		break;
+	case 'M':
+		if(STATUS_IS("MISSING"))
+			return WorkspaceFile::TYPE_MISSING;
+		break;
+	case 'R':
+		if(STATUS_IS("RENAMED"))
+			return WorkspaceFile::TYPE_RENAMED;
+		break;
+	case 'U':
+		if(STATUS_IS("UNCHANGED"))
+			return WorkspaceFile::TYPE_UNCHANGED;
+		if(STATUS_IS("UPDATED_BY_MERGE") || STATUS_IS("UPDATED_BY_INTEGRATE"))
+			return WorkspaceFile::TYPE_MERGED;
+		break;
+	}
+
+	// EXECUTABLE, UNEXEC, SYMLINK, UNLINK, NOT_A_FILE and any newer keyword
+	return WorkspaceFile::TYPE_EDITTED;
+}
+
+#undef STATUS_IS
+
+//////////////////////////////////////////////////////////////////////////
+// FileListParser
+// Parses the lines of "fossil ls -l" as they are received
+//////////////////////////////////////////////////////////////////////////
+class FileListParser : public LineScanner::Visitor
+{
+public:
+	FileListParser(FileListVisitor &visitor) : visitor(visitor)
+	{
+	}
+
+	void onLine(const char *line, int length)
+	{
+		const char *end = line + length;
+		const char *space = static_cast<const char *>(memchr(line, ' ', length));
+		if(!space)
+			return;
+
+		WorkspaceFile::Type type = ParseFileStatus(line, static_cast<int>(space-line));
+
+		const char *name = space;
+		while(name<end && (*name==' ' || *name=='\t'))
+			++name;
+		if(name==end)
+			return;
+
+		visitor.onFile(type, FossilJob::decodeLine(name, static_cast<int>(end-name)));
+	}
+
+private:
+	FileListVisitor &visitor;
+};
+
+//------------------------------------------------------------------------------
+bool Fossil::listFiles(FileListVisitor &visitor)
+{
+	if(verifyChanges)
+		return verifyFileList(visitor);
+
+	if(readFileList(visitor))
+		return true;
+
+	FileListParser parser(visitor);
+	return runFossil(QStringList() << "ls" << "-l", parser, RUNFLAGS_SILENT_ALL|RUNFLAGS_TIMEOUT_METADATA);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// ChangedFileFilter
+// Passes on only the tracked files that differ from the checkout
+//////////////////////////////////////////////////////////////////////////
+class ChangedFileFilter : public FileListVisitor
+{
+public:
+	ChangedFileFilter(FileListVisitor &visitor) : visitor(visitor)
+	{
+	}
+
+	void onFile(WorkspaceFile::Type type, const QString &filePath)
+	{
+		if(type & WorkspaceFile::TYPE_MODIFIED)
+			visitor.onFile(type, filePath);
+	}
+
+private:
+	FileListVisitor &visitor;
+};
+
+//------------------------------------------------------------------------------
+bool Fossil::listChanges(FileListVisitor &visitor)
+{
+	ChangedFileFilter filter(visitor);
+
+	if(!verifyChanges && readFileList(filter))
+		return true;
+
+	FileListParser parser(filter);
+	return runFossil(QStringList() << "changes", parser, RUNFLAGS_SILENT_ALL|RUNFLAGS_TIMEOUT_METADATA);
+}
+
+//------------------------------------------------------------------------------
+// The status of the listed tracked files. Files that are not tracked are
+// not reported
+bool Fossil::listFileStatus(const stringset_t &paths, FileListVisitor &visitor)
+{
+	if(!verifyChanges && readFileList(visitor, &paths))
+		return true;
+
+	FileListParser parser(visitor);
+	return runFossil(QStringList() << "ls" << "-l" << "--" << paths.toList(), parser, RUNFLAGS_SILENT_ALL|RUNFLAGS_TIMEOUT_METADATA);
+}
+
+//------------------------------------------------------------------------------
+// The names of all tracked files. Only available from the checkout database
+bool Fossil::listTrackedFiles(stringset_t &files)
 {
-	return runFossil(QStringList() << "ls" << "-l", &files, RUNFLAGS_SILENT_ALL);
+	CheckoutDb checkout;
+	if(!checkout.open(workspacePath) || !checkout.beginRead())
+		return false;
+
+	bool ok = checkout.readFileNames(files);
+	checkout.endRead();
+	return ok;
+}
+
+//------------------------------------------------------------------------------
+bool Fossil::listExtras(QStringList &files, bool includeIgnored)
+{
+	QStringList params;
+	params << "extras" << "--dotfiles";
+
+	if(includeIgnored)
+		params << "--ignore" << "";
+
+	if(!runFossil(params, &files, RUNFLAGS_SILENT_ALL|RUNFLAGS_TIMEOUT_METADATA))
+		return false;
+
+	TrimStringList(files);
+	files.removeAll("");
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// The modified and the unknown files from a single "fossil changes". Fails
+// without running anything if this fossil cannot do so
+bool Fossil::listChangesAndExtras(FileListVisitor &visitor, bool includeIgnored)
+{
+	if(!getCapabilities().has(FossilCapabilities::FEATURE_CHANGES_DIFFER))
+		return false;
+
+	QStringList params;
+	params << "changes" << "--differ" << "--classify" << "--no-merge" << "--dotfiles";
+
+	if(includeIgnored)
+		params << "--ignore" << "";
+
+	FileListParser parser(visitor);
+	return runFossil(params, parser, RUNFLAGS_SILENT_ALL|RUNFLAGS_TIMEOUT_METADATA);
+}
+
+//------------------------------------------------------------------------------
+bool Fossil::hasCheckoutDb() const
+{
+	CheckoutDb checkout;
+	return checkout.open(workspacePath);
 }
 
 //------------------------------------------------------------------------------
 bool Fossil::statusWorkspace(QStringList &result)
 {
-	return runFossil(QStringList() << "status", &result, RUNFLAGS_SILENT_ALL);
+	return runFossil(QStringList() << "status", &result, RUNFLAGS_SILENT_ALL|RUNFLAGS_TIMEOUT_METADATA);
 }
 
 //------------------------------------------------------------------------------
-bool Fossil::pushWorkspace(const QUrl &url)
+bool Fossil::getIntegrationState(bool &integrating)
+{
+	CheckoutDb checkout;
+	if(checkout.open(workspacePath) && checkout.beginRead())
+	{
+		bool ok = checkout.isIntegrating(integrating);
+		checkout.endRead();
+		if(ok)
+			return true;
+	}
+
+	QStringList res;
+	if(!statusWorkspace(res))
+		return false;
+
+	integrating = false;
+	foreach(const QString &l, res)
+	{
+		if(l.trimmed().indexOf("INTEGRATE")==0)
+		{
+			integrating = true;
+			break;
+		}
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Open the repository of the workspace and begin reading from it
+bool Fossil::openRepositoryDb(RepositoryDb &repo, qint64 &checkoutRid)
+{
+	QString repository;
+	{
+		CheckoutDb checkout;
+		if(!checkout.open(workspacePath) || !checkout.beginRead())
+			return false;
+
+		bool ok = checkout.getRepositoryFile(repository) && checkout.getCheckoutId(checkoutRid);
+		checkout.endRead();
+		if(!ok)
+			return false;
+	}
+
+	return repo.open(repository) && repo.beginRead();
+}
+
+//------------------------------------------------------------------------------
+// Read the workspace state straight from the checkout and repository
+// databases. Returns false if the result is not known to match "fossil info"
+bool Fossil::readWorkspaceState()
+{
+	RepositoryDb repo;
+	qint64 checkout_rid = 0;
+	if(!openRepositoryDb(repo, checkout_rid))
+		return false;
+
+	QString project_name;
+	QString revision;
+	QStringList tags;
+	bool ok = repo.getProjectName(project_name) && repo.getCheckinInfo(checkout_rid, revision, tags);
+	repo.endRead();
+	if(!ok)
+		return false;
+
+	repositoryFile = repo.getFilename();
+	projectName = project_name;
+	currentRevision = revision;
+	activeTags = tags;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Read the file list from the checkout database. Returns false if the
+// database is unusable or may be out of date with the files on disk. Only
+// the files in filePaths are read, if given
+bool Fossil::readFileList(FileListVisitor &visitor, const stringset_t *filePaths)
+{
+	CheckoutDb::entrylist_t entries;
+	QString repository;
+	{
+		CheckoutDb checkout;
+		if(!checkout.open(workspacePath) || !checkout.beginRead())
+			return false;
+
+		bool ok = checkout.getRepositoryFile(repository) && checkout.readFiles(entries);
+		checkout.endRead();
+		if(!ok)
+			return false;
+	}
+
+	if(filePaths)
+	{
+		CheckoutDb::entrylist_t selected;
+		foreach(const CheckoutDb::FileEntry &e, entries)
+		{
+			if(filePaths->contains(e.filePath))
+				selected.append(e);
+		}
+		entries.swap(selected);
+	}
+
+	{
+		RepositoryDb repo;
+		if(!repo.open(repository) || !repo.beginRead())
+			return false;
+
+		bool ok = repo.readBlobInfo(entries);
+		repo.endRead();
+		if(!ok)
+			return false;
+	}
+
+	if(uiCallback && uiCallback->processAborted())
+		return false;
+
+	// Stat and hash outside of any read transaction
+	ChangeDetector detector(workspacePath);
+	if(!detector.detect(entries))
+		return false;
+
+	foreach(const CheckoutDb::FileEntry &e, entries)
+	{
+		if(uiCallback && uiCallback->processAborted())
+			return false;
+		visitor.onFile(e.type, e.filePath);
+	}
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// FileListCollector
+//////////////////////////////////////////////////////////////////////////
+class FileListCollector : public FileListVisitor
+{
+public:
+	void onFile(WorkspaceFile::Type type, const QString &filePath)
+	{
+		files.insert(filePath, type);
+	}
+
+	QMap<QString, WorkspaceFile::Type> files;
+};
+
+//------------------------------------------------------------------------------
+// Run both the built-in change detection and fossil, and log any files they
+// disagree on. The result of fossil is the one passed on to the visitor.
+bool Fossil::verifyFileList(FileListVisitor &visitor)
+{
+	FileListCollector detected;
+	bool detected_ok = readFileList(detected);
+
+	FileListCollector listed;
+	FileListParser parser(listed);
+	if(!runFossil(QStringList() << "ls" << "-l", parser, RUNFLAGS_SILENT_ALL|RUNFLAGS_TIMEOUT_METADATA))
+		return false;
+
+	if(!detected_ok)
+		log(QObject::tr("Change detection fell back to fossil")+"\n");
+	else
+	{
+		int mismatches = 0;
+		QStringList all_files = (listed.files.keys() + detected.files.keys()).toSet().toList();
+		all_files.sort();
+		foreach(const QString &f, all_files)
+		{
+			WorkspaceFile::Type expected = listed.files.value(f, WorkspaceFile::TYPE_UNKNOWN);
+			WorkspaceFile::Type actual = detected.files.value(f, WorkspaceFile::TYPE_UNKNOWN);
+			if(expected == actual)
+				continue;
+
+			log(QString("%0: fossil %1, detected %2\n").arg(f).arg(static_cast<int>(expected)).arg(static_cast<int>(actual)));
+			++mismatches;
+		}
+		log(QObject::tr("Change detection verified %0 files, %1 mismatches").arg(listed.files.size()).arg(mismatches)+"\n");
+	}
+
+	for(QMap<QString, WorkspaceFile::Type>::const_iterator it=listed.files.begin(); it!=listed.files.end(); ++it)
+		visitor.onFile(it.value(), it.key());
+	return true;
+}
+
+//------------------------------------------------------------------------------
+FossilJob *Fossil::pushWorkspace(const QUrl &url, QObject *jobParent)
 {
 	QStringList params;
 	params << "push";
 
-	int runFlags=RUNFLAGS_NONE;
+	int runFlags=RUNFLAGS_TIMEOUT_SYNC;
 
 	if(!url.isEmpty())
 	{
@@ -167,20 +551,20 @@ bool Fossil::pushWorkspace(const QUrl &url)
 
 		log_params.push_front("fossil");
 
-		runFlags = RUNFLAGS_SILENT_INPUT;
+		runFlags |= RUNFLAGS_SILENT_INPUT;
 		log("<b>&gt;"+log_params.join(" ")+"</b><br>", true);
 	}
 
-	return runFossil(params, 0, runFlags);
+	return createJob(params, runFlags, jobParent);
 }
 
 //------------------------------------------------------------------------------
-bool Fossil::pullWorkspace(const QUrl &url)
+FossilJob *Fossil::pullWorkspace(const QUrl &url, QObject *jobParent)
 {
 	QStringList params;
 	params << "pull";
 
-	int runFlags=RUNFLAGS_NONE;
+	int runFlags=RUNFLAGS_TIMEOUT_SYNC;
 
 	if(!url.isEmpty())
 	{
@@ -193,15 +577,15 @@ bool Fossil::pullWorkspace(const QUrl &url)
 
 		log_params.push_front("fossil");
 
-		runFlags = RUNFLAGS_SILENT_INPUT;
+		runFlags |= RUNFLAGS_SILENT_INPUT;
 		log("<b>&gt;"+log_params.join(" ")+"</b><br>", true);
 	}
 
-	return runFossil(params, 0, runFlags);
+	return createJob(params, runFlags, jobParent);
 }
 
 //------------------------------------------------------------------------------
-bool Fossil::cloneRepository(const QString& repository, const QUrl& url, const QUrl& proxyUrl)
+FossilJob *Fossil::cloneRepository(const QString& repository, const QUrl& url, const QUrl& proxyUrl, QObject *jobParent)
 {
 	// Actual command
 	QStringList cmd = QStringList() << "clone";
@@ -228,28 +612,71 @@ bool Fossil::cloneRepository(const QString& repository, const QUrl& url, const Q
 	log("<b>&gt;"+logcmd.join(" ")+"</b><br>", true);
 
 	// Clone Repo
-	if(!runFossil(cmd, 0, RUNFLAGS_SILENT_INPUT))
+	return createJob(cmd, RUNFLAGS_SILENT_INPUT|RUNFLAGS_TIMEOUT_SYNC, jobParent);
+}
+
+//------------------------------------------------------------------------------
+bool Fossil::getExeVersion(QString& version)
+{
+	const FossilCapabilities &caps = getCapabilities();
+	if(!caps.isValid())
 		return false;
 
+	version = caps.getVersion();
 	return true;
 }
 
 //------------------------------------------------------------------------------
-bool Fossil::getExeVersion(QString& version)
+void Fossil::setExePath(const QString &path)
+{
+	fossilPath = path;
+	resolvedPath.clear();
+	capabilitiesProbed = false;
+}
+
+//------------------------------------------------------------------------------
+// Probe the executable, unless it was already probed as it is now
+const FossilCapabilities &Fossil::getCapabilities()
 {
+	if(capabilitiesProbed)
+		return capabilities;
+
+	QString exe = getFossilPath();
+	QFileInfo fi(exe);
+	if(!fi.isAbsolute())
+		fi.setFile(QStandardPaths::findExecutable(exe));
+
+	QString key = fi.absoluteFilePath();
+	qint64 stamp = fi.exists() ? fi.lastModified().toMSecsSinceEpoch() : 0;
+	if(stamp && FossilCapabilities::lookup(key, stamp, capabilities))
+	{
+		capabilitiesProbed = true;
+		return capabilities;
+	}
+
+	capabilities = FossilCapabilities();
+
+	// Older versions reject the verbose option
 	QStringList res;
-	if(!runFossil(QStringList() << "version", &res, RUNFLAGS_SILENT_ALL) && res.length()==1)
-		return false;
+	if(!runFossil(QStringList() << "version" << "-verbose", &res, RUNFLAGS_SILENT_ALL|RUNFLAGS_TIMEOUT_METADATA))
+	{
+		res.clear();
+		runFossil(QStringList() << "version", &res, RUNFLAGS_SILENT_ALL|RUNFLAGS_TIMEOUT_METADATA);
+	}
+	capabilities.parseVersion(res);
 
-	if(res.length()==0)
-		return false;
+	// Unavailable, or the probe was aborted. Try again next time
+	if(!capabilities.isValid())
+		return capabilities;
 
-	int off = res[0].indexOf("version ");
-	if(off==-1)
-		return false;
+	res.clear();
+	if(runFossil(QStringList() << "help" << "changes", &res, RUNFLAGS_SILENT_ALL|RUNFLAGS_TIMEOUT_METADATA))
+		capabilities.parseChangesHelp(res);
 
-	version = res[0].mid(off+8);
-	return true;
+	capabilitiesProbed = true;
+	if(stamp)
+		FossilCapabilities::remember(key, stamp, capabilities);
+	return capabilities;
 }
 
 //------------------------------------------------------------------------------
@@ -261,7 +688,7 @@ bool Fossil::diffFile(const QString &repoFile, bool graphical)
 		return runFossil(QStringList() << "gdiff" << QuotePath(repoFile), 0, RUNFLAGS_DETACHED);
 	}
 	else
-		return runFossil(QStringList() << "diff" << QuotePath(repoFile));
+		return runFossil(QStringList() << "diff" << QuotePath(repoFile), 0, RUNFLAGS_TIMEOUT_DIFF);
 }
 
 //------------------------------------------------------------------------------
@@ -304,7 +731,8 @@ bool Fossil::commitFiles(const QStringList& fileList, const QString& comment, co
 
 	params << QuotePaths(fileList);
 
-	runFossil(params);
+	// Can autosync
+	runFossil(params, 0, RUNFLAGS_TIMEOUT_SYNC);
 	QFile::remove(comment_fname);
 	return true;
 }
@@ -401,13 +829,14 @@ bool Fossil::updateWorkspace(QStringList &result, const QString &revision, bool
 
 
 	result.clear();
-	return runFossil(params, &result);
+	// Can autosync
+	return runFossil(params, &result, RUNFLAGS_TIMEOUT_SYNC);
 }
 
 //------------------------------------------------------------------------------
 bool Fossil::getSettings(QStringList &result)
 {
-	return runFossil(QStringList() << "settings", &result, RUNFLAGS_SILENT_ALL);
+	return runFossil(QStringList() << "settings", &result, RUNFLAGS_SILENT_ALL|RUNFLAGS_TIMEOUT_METADATA);
 }
 
 //------------------------------------------------------------------------------
@@ -454,7 +883,7 @@ bool Fossil::getRemoteUrl(QUrl& url)
 	url.clear();
 
 	QStringList out;
-	if(!runFossil(QStringList() << "remote-url", &out, RUNFLAGS_SILENT_ALL))
+	if(!runFossil(QStringList() << "remote-url", &out, RUNFLAGS_SILENT_ALL|RUNFLAGS_TIMEOUT_METADATA))
 		return false;
 
 	QString url_str;
@@ -489,7 +918,7 @@ bool Fossil::stashList(stashmap_t& stashes)
 	stashes.clear();
 	QStringList res;
 
-	if(!runFossil(QStringList() << "stash" << "ls", &res, RUNFLAGS_SILENT_ALL))
+	if(!runFossil(QStringList() << "stash" << "ls", &res, RUNFLAGS_SILENT_ALL|RUNFLAGS_TIMEOUT_METADATA))
 		return false;
 
 	// 19: [5c46757d4b9765] on 2012-04-22 04:41:15
@@ -539,16 +968,23 @@ bool Fossil::stashDrop(const QString& name)
 //------------------------------------------------------------------------------
 bool Fossil::stashDiff(const QString& name)
 {
-	return runFossil(QStringList() << "stash" << "diff" << name, 0);
+	return runFossil(QStringList() << "stash" << "diff" << name, 0, RUNFLAGS_TIMEOUT_DIFF);
 }
 
 //------------------------------------------------------------------------------
 bool Fossil::tagList(QStringMap& tags)
 {
+	{
+		RepositoryDb repo;
+		qint64 checkout_rid = 0;
+		if(openRepositoryDb(repo, checkout_rid) && repo.readTags(tags))
+			return true;
+	}
+
 	tags.clear();
 	QStringList tagnames;
 
-	if(!runFossil(QStringList() << "tag" << "ls", &tagnames, RUNFLAGS_SILENT_ALL))
+	if(!runFossil(QStringList() << "tag" << "ls", &tagnames, RUNFLAGS_SILENT_ALL|RUNFLAGS_TIMEOUT_METADATA))
 		return false;
 
 	QStringList info;
@@ -562,7 +998,7 @@ bool Fossil::tagList(QStringMap& tags)
 		info.clear();
 
 		// Use "whatis" instead of "info" to get extra information like the closed raw-tag
-		if(!runFossil(QStringList() << "whatis" << "tag:"+tag, &info, RUNFLAGS_SILENT_ALL))
+		if(!runFossil(QStringList() << "whatis" << "tag:"+tag, &info, RUNFLAGS_SILENT_ALL|RUNFLAGS_TIMEOUT_METADATA))
 			return false;
 
 		/*
@@ -624,13 +1060,39 @@ bool Fossil::tagDelete(const QString& name, const QString &revision)
 }
 
 //------------------------------------------------------------------------------
-bool Fossil::branchList(QStringList& branches, QStringList& activeBranches)
+bool Fossil::branchList(QStringList& branches, QStringList& activeBranches, branchmap_t *tips)
 {
+	if(tips)
+		tips->clear();
+
+	{
+		RepositoryDb repo;
+		qint64 checkout_rid = 0;
+		branchmap_t open_branches;
+		QString current_branch;
+		if(openRepositoryDb(repo, checkout_rid) && repo.readBranches(checkout_rid, open_branches, current_branch))
+		{
+			branches.clear();
+			activeBranches.clear();
+			for(branchmap_t::const_iterator it=open_branches.begin(); it!=open_branches.end(); ++it)
+			{
+				if(it.key()==current_branch)
+					activeBranches.append(it.key());
+				else
+					branches.append(it.key());
+			}
+
+			if(tips)
+				*tips = open_branches;
+			return true;
+		}
+	}
+
 	branches.clear();
 	activeBranches.clear();
 	QStringList res;
 
-	if(!runFossil(QStringList() << "branch" , &res, RUNFLAGS_SILENT_ALL))
+	if(!runFossil(QStringList() << "branch" , &res, RUNFLAGS_SILENT_ALL|RUNFLAGS_TIMEOUT_METADATA))
 		return false;
 
 	foreach(const QString &line, res)
@@ -700,25 +1162,21 @@ bool Fossil::branchMerge(QStringList &res, const QString& revision, bool integra
 }
 
 //------------------------------------------------------------------------------
-static QString ParseFossilQuery(QString line)
-{
-	// Extract question
-	int qend = line.lastIndexOf('(');
-	if(qend == -1)
-		qend = line.lastIndexOf('[');
-	Q_ASSERT(qend!=-1);
-	line = line.left(qend);
-	line = line.trimmed();
-	line += "?";
-	line[0]=QString(line[0]).toUpper()[0];
-	return line;
+bool Fossil::runFossil(const QStringList &args, QStringList *output, int runFlags)
+{
+	int exit_code = EXIT_FAILURE;
+	if(!runFossilRaw(args, output, &exit_code, runFlags))
+		return false;
+
+	return exit_code == EXIT_SUCCESS;
 }
 
 //------------------------------------------------------------------------------
-bool Fossil::runFossil(const QStringList &args, QStringList *output, int runFlags)
+// Run fossil, handing each output line to the visitor as it arrives
+bool Fossil::runFossil(const QStringList &args, LineScanner::Visitor &visitor, int runFlags)
 {
 	int exit_code = EXIT_FAILURE;
-	if(!runFossilRaw(args, output, &exit_code, runFlags))
+	if(!runFossilRaw(args, 0, &exit_code, runFlags, &visitor))
 		return false;
 
 	return exit_code == EXIT_SUCCESS;
@@ -727,24 +1185,13 @@ bool Fossil::runFossil(const QStringList &args, QStringList *output, int runFlag
 //------------------------------------------------------------------------------
 // Run fossil. Returns true if execution was successful regardless if fossil
 // issued an error
-bool Fossil::runFossilRaw(const QStringList &args, QStringList *output, int *exitCode, int runFlags)
+bool Fossil::runFossilRaw(const QStringList &args, QStringList *output, int *exitCode, int runFlags, LineScanner::Visitor *visitor)
 {
 	bool silent_input = (runFlags & RUNFLAGS_SILENT_INPUT) != 0;
-	bool silent_output = (runFlags & RUNFLAGS_SILENT_OUTPUT) != 0;
 	bool detached = (runFlags & RUNFLAGS_DETACHED) != 0;
 
 	if(!silent_input)
-	{
-		QString params;
-		foreach(QString p, args)
-		{
-			if(p.indexOf(' ')!=-1)
-				params += '"' + p + "\" ";
-			else
-				params += p + ' ';
-		}
-		log("<b>&gt; fossil "+params+"</b><br>", true);
-	}
+		logCommand(args);
 
 	QString wkdir = getWorkspacePath();
 
@@ -766,300 +1213,67 @@ bool Fossil::runFossilRaw(const QStringList &args, QStringList *output, int *exi
 		status_msg = QString("Fossil %0").arg(args[0].toCaseFolded());
 	ScopedStatus status(uiCallback, status_msg);
 
-	// Generate args file
-	const QStringList *final_args = &args;
-	QTemporaryFile args_file;
-	if(!args_file.open())
-	{
-		log(QObject::tr("Could not generate command line file"));
-		return false;
-	}
-
-	// Write BOM
-	args_file.write(reinterpret_cast<const char *>(UTF8_BOM), sizeof(UTF8_BOM));
-
-	// Write Args
-	foreach(const QString &arg, args)
-	{
-		args_file.write(arg.toUtf8());
-		args_file.write("\n");
-	}
-	args_file.close();
+	Q_ASSERT(uiCallback);
+	FossilJob job(fossil, args, wkdir, runFlags, uiCallback);
+	job.setCollectOutput(output != 0);
+	job.setLineVisitor(visitor);
 
-	// Replace args with args filename
-	QStringList run_args;
-	run_args.append("--args");
-	run_args.append(args_file.fileName());
-	final_args = &run_args;
+	if(!job.start())
+		return false;
 
-	// Create fossil process
-	// FIXME: when we are sure this works delete this
-	// LoggedProcess process(parentWidget*/);
-	LoggedProcess process(0);
+	job.waitForFinished();
 
-	process.setWorkingDirectory(wkdir);
+	if(output)
+		output->append(job.getOutput());
 
-	process.start(fossil, *final_args);
-	if(!process.waitForStarted())
-	{
-		log(QObject::tr("Could not start Fossil executable '%0'").arg(fossil)+"\n");
+	if(!job.succeeded() || uiCallback->processAborted())
 		return false;
-	}
-	const QChar EOL_MARK('\n');
-	QString ans_yes = 'y' + EOL_MARK;
-	QString ans_no = 'n' + EOL_MARK;
-	QString ans_always = 'a' + EOL_MARK;
-	QString ans_convert = 'c' + EOL_MARK;
 
-	QString buffer;
+	if(exitCode)
+		*exitCode = job.getExitCode();
 
-#ifdef Q_OS_WIN
-	QTextCodec *codec = QTextCodec::codecForName("UTF-8");
-#else
-	QTextCodec *codec = QTextCodec::codecForLocale();
-#endif
+	return true;
+}
 
-	Q_ASSERT(codec);
-	QTextDecoder *decoder = codec->makeDecoder();
-	Q_ASSERT(decoder);
+//------------------------------------------------------------------------------
+// Prepare a fossil command to run without waiting for it to complete. The
+// caller takes ownership of the returned job, starts it when its turn
+// comes, and follows its progress via signals.
+FossilJob *Fossil::createJob(const QStringList &args, int runFlags, QObject *jobParent)
+{
+	if(!(runFlags & RUNFLAGS_SILENT_INPUT))
+		logCommand(args);
 
-	Q_ASSERT(uiCallback);
-#ifdef QT_DEBUG
-	size_t input_index = 0;
-#endif
+	return new FossilJob(getFossilPath(), args, getWorkspacePath(), runFlags, uiCallback, jobParent);
+}
 
-	while(true)
+//------------------------------------------------------------------------------
+void Fossil::logCommand(const QStringList &args)
+{
+	QString params;
+	foreach(QString p, args)
 	{
-		QProcess::ProcessState state = process.state();
-		qint64 bytes_avail = process.logBytesAvailable();
-
-		if(state!=QProcess::Running && bytes_avail<1)
-			break;
-
-		if(uiCallback->processAborted())
-		{
-			#ifdef Q_OS_WIN		// Verify this is still true on Qt5
-				process.kill(); // QT on windows cannot terminate console processes with QProcess::terminate
-			#else
-				process.terminate();
-			#endif
-			break;
-		}
-
-		QByteArray input;
-		process.getLogAndClear(input);
-
-		#ifdef QT_DEBUG // Log fossil output in debug builds
-		if(!input.isEmpty() && (runFlags & RUNFLAGS_DEBUG) )
-			qDebug() << "[" << ++input_index << "] '" << input.data() << "'\n";
-		#endif
-
-		buffer += decoder->toUnicode(input);
-#if 0 // Keep this for now to simulate bad parses
-		if(runFlags & RUNFLAGS_DEBUG)
-		{
-			static int debug=1;
-			if(debug==1)
-			{
-				buffer = "     4: [df2233aabe09ef] on 2013-02-03 02:51:33\n"
-						 "     History\n"
-						 "     5: [df2233aabe09ef] on 2013-02-15 03:55:37\n"
-						 "     ";
-				debug++;
-			}
-			else if(debug==2)
-			{
-				buffer = " Diff\n"
-						 " ";
-				debug++;
-			}
-			else
-				buffer="";
-		}
-#endif
-		#ifdef QT_DEBUG // breakpoint
-		//if(buffer.indexOf("SQLITE_CANTOPEN")!=-1)
-		//	qDebug() << "Breakpoint\n";
-		#endif
-
-		QCoreApplication::processEvents(QEventLoop::AllEvents, 500); // 500 ms
-
-		if(buffer.isEmpty())
-			continue;
-
-		// Normalize line endings
-		buffer = buffer.replace("\r\n", "\n");
-		buffer = buffer.replace("\r", "\n");
-
-		// Extract the last line
-		int last_line_start = buffer.lastIndexOf(EOL_MARK);
-
-		QString last_line;
-		QString before_last_line;
-		if(last_line_start != -1)
-		{
-			last_line = buffer.mid(last_line_start+1); // Including the EOL
-
-			// Detect previous line
-			if(last_line_start>0)
-			{
-				int before_last_line_start = buffer.lastIndexOf(EOL_MARK, last_line_start-1);
-
-				// No new-line before ?
-				if(before_last_line_start==-1)
-					before_last_line_start = 0; // Use entire line
-				else
-					++before_last_line_start; // Skip new-line
-
-				// Extract previous line
-				before_last_line = buffer.mid(before_last_line_start, last_line_start-before_last_line_start);
-			}
-		}
+		if(p.indexOf(' ')!=-1)
+			params += '"' + p + "\" ";
 		else
-			last_line = buffer;
-
-		last_line = last_line.trimmed();
-
-		// Check if we have a query
-		bool ends_qmark = !last_line.isEmpty() && last_line[last_line.length()-1]=='?';
-		bool have_yn_query = last_line.toLower().indexOf("y/n")!=-1;
-		bool have_yna_query = last_line.toLower().indexOf("a=always/y/n")!=-1 || last_line.toLower().indexOf("yes/no/all")!=-1 || last_line.toLower().indexOf("a=all/y/n")!=-1;
-		bool have_an_query = last_line.toLower().indexOf("a=always/n")!=-1;
-		bool have_acyn_query = last_line.toLower().indexOf("a=all/c=convert/y/n")!=-1;
-
-		bool have_query = ends_qmark && (have_yn_query || have_yna_query || have_an_query || have_acyn_query);
-
-		// Flush all complete lines to the log and output
-		QStringList log_lines = buffer.left(last_line_start).split(EOL_MARK);
-		for(int l=0; l<log_lines.length(); ++l)
-		{
-			// Skip last line if we have a query. This will be handled manually further down
-			if(have_query && l==log_lines.length()-1)
-				continue;
-
-			QString line = log_lines[l].trimmed();
-
-		#ifdef QT_DEBUG
-			if(runFlags & RUNFLAGS_DEBUG)
-			{
-				qDebug() << "LINE: " << line << "\n";
-			}
-		#endif
-
-			if(line.isEmpty())
-				continue;
-
-			if(output)
-				output->append(line);
-
-			if(!silent_output)
-				log(line+"\n");
-		}
-
-		// Remove everything we processed (including the EOL)
-		buffer = buffer.mid(last_line_start+1) ;
-
-		// Now process any query
-		if(have_query && (have_yna_query || have_acyn_query))
-		{
-			log(last_line);
-			QString query = ParseFossilQuery(last_line);
-			QMessageBox::StandardButtons buttons = QMessageBox::YesToAll|QMessageBox::Yes|QMessageBox::No;
-
-			// Add any extra text available to the query
-			before_last_line = before_last_line.trimmed();
-			if(!before_last_line.isEmpty())
-				query = before_last_line + "\n" + query;
-
-			// Map the Convert option to the Apply button
-			if(have_acyn_query)
-				buttons |= QMessageBox::Apply;
-
-			QMessageBox::StandardButton res = uiCallback->Query("Fossil", query, buttons);
-			if(res==QMessageBox::Yes)
-			{
-				process.write(ans_yes.toLatin1());
-				log("Y\n");
-			}
-			else if(res==QMessageBox::YesAll)
-			{
-				process.write(ans_always.toLatin1());
-				log("A\n");
-			}
-			else if(res==QMessageBox::Apply)
-			{
-				process.write(ans_convert.toLatin1());
-				log("C\n");
-			}
-			else
-			{
-				process.write(ans_no.toLatin1());
-				log("N\n");
-			}
-			buffer.clear();
-		}
-		else if(have_query && have_yn_query)
-		{
-			log(last_line);
-			QString query = ParseFossilQuery(last_line);
-			QMessageBox::StandardButton res = uiCallback->Query("Fossil", query, QMessageBox::Yes|QMessageBox::No);
-
-			if(res==QMessageBox::Yes)
-			{
-				process.write(ans_yes.toLatin1());
-				log("Y\n");
-			}
-			else
-			{
-				process.write(ans_no.toLatin1());
-				log("N\n");
-			}
-
-			buffer.clear();
-		}
-		else if(have_query && have_an_query)
-		{
-			log(last_line);
-			QString query = ParseFossilQuery(last_line);
-			QMessageBox::StandardButton res = uiCallback->Query("Fossil", query, QMessageBox::YesToAll|QMessageBox::No);
-			if(res==QMessageBox::YesAll)
-			{
-				process.write(ans_always.toLatin1());
-				log("A\n");
-			}
-			else
-			{
-				process.write(ans_no.toLatin1());
-				log("N\n");
-			}
-			buffer.clear();
-		}
+			params += p + ' ';
 	}
-
-	delete decoder;
-
-	// Must be finished by now
-	process.waitForFinished(5000); // Wait for termination 5 secs maximum
-	Q_ASSERT(process.state()==QProcess::NotRunning);
-
-	QProcess::ExitStatus es = process.exitStatus();
-
-	if(es!=QProcess::NormalExit || uiCallback->processAborted())
-		return false;
-
-	if(exitCode)
-		*exitCode = process.exitCode();
-
-	return true;
+	log("<b>&gt; fossil "+params+"</b><br>", true);
 }
 
 //------------------------------------------------------------------------------
 QString Fossil::getFossilPath()
 {
+	if(!resolvedPath.isEmpty())
+		return resolvedPath;
+
 	// Use the user-specified fossil if available
 	QString fossil_path = fossilPath;
 	if(!fossil_path.isEmpty())
-		return QDir::toNativeSeparators(fossil_path);
+	{
+		resolvedPath = QDir::toNativeSeparators(fossil_path);
+		return resolvedPath;
+	}
 
 	QString fossil_exe = "fossil";
 #ifdef Q_OS_WIN
@@ -1069,10 +1283,10 @@ QString Fossil::getFossilPath()
 	QString fuel_fossil = QDir::toNativeSeparators(QCoreApplication::applicationDirPath() + QDir::separator() + fossil_exe);
 
 	if(QFile::exists(fuel_fossil))
-		return fuel_fossil;
-
-	// Otherwise assume there is a "fossil" executable in the path
-	return fossil_exe;
+		resolvedPath = fuel_fossil;
+	else // Otherwise assume there is a "fossil" executable in the path
+		resolvedPath = fossil_exe;
+	return resolvedPath;
 }
 
 //------------------------------------------------------------------------------
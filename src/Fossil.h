@@ -6,9 +6,13 @@ class QStringList;
 #include <QStringList>
 #include <QUrl>
 #include "LoggedProcess.h"
+#include "FossilJob.h"
+#include "FossilCapabilities.h"
 #include "Utils.h"
 #include "WorkspaceCommon.h"
 
+class RepositoryDb;
+
 class Fossil
 {
 public:
@@ -18,17 +22,18 @@ public:
 
 	// Repositories
 	bool createRepository(const QString &repositoryPath);
-	bool cloneRepository(const QString &repository, const QUrl &url, const QUrl &proxyUrl);
+	FossilJob *cloneRepository(const QString &repository, const QUrl &url, const QUrl &proxyUrl, QObject *jobParent=0);
 
 	// Workspace
 	bool createWorkspace(const QString &repositoryPath, const QString& workspacePath);
 	bool closeWorkspace(bool force=false);
 	void setWorkspace(const QString &_workspacePath);
-	bool pushWorkspace(const QUrl& url);
-	bool pullWorkspace(const QUrl& url);
+	FossilJob *pushWorkspace(const QUrl& url, QObject *jobParent=0);
+	FossilJob *pullWorkspace(const QUrl& url, QObject *jobParent=0);
 	bool undoWorkspace(QStringList& result, bool explainOnly);
 	bool updateWorkspace(QStringList& result, const QString& revision, bool explainOnly);
 	bool statusWorkspace(QStringList& result);
+	bool getIntegrationState(bool &integrating);
 	WorkspaceState getWorkspaceState();
 	static bool isWorkspace(const QString &path);
 
@@ -38,7 +43,13 @@ public:
 	const QString &getWorkspacePath() const { return workspacePath;	}
 
 	// Files
-	bool listFiles(QStringList &files);
+	bool listFiles(FileListVisitor &visitor);
+	bool listChanges(FileListVisitor &visitor);
+	bool listFileStatus(const stringset_t &paths, FileListVisitor &visitor);
+	bool listTrackedFiles(stringset_t &files);
+	bool listExtras(QStringList &files, bool includeIgnored);
+	bool listChangesAndExtras(FileListVisitor &visitor, bool includeIgnored);
+	bool hasCheckoutDb() const;
 	bool diffFile(const QString &repoFile, bool graphical);
 	bool commitFiles(const QStringList &fileList, const QString &comment, const QString& newBranchName, bool isPrivateBranch);
 	bool addFiles(const QStringList& fileList);
@@ -67,7 +78,7 @@ public:
 	bool tagDelete(const QString& name, const QString& revision);
 
 	// Branches
-	bool branchList(QStringList& branches, QStringList& activeBranches);
+	bool branchList(QStringList& branches, QStringList& activeBranches, branchmap_t *tips=0);
 	bool branchNew(const QString& name, const QString& revisionBasis, bool isPrivate=false);
 	bool branchMerge(QStringList& res, const QString& revision, bool integrate, bool force, bool testOnly);
 
@@ -82,23 +93,28 @@ public:
 	QString getUIHttpAddress() const;
 
 	// Fossil executable
-	void setExePath(const QString &path) { fossilPath = path; }
+	void setExePath(const QString &path);
+	const QString &getExePath() const { return fossilPath; }
+	const FossilCapabilities &getCapabilities();
+
+	// Compare the built-in change detection against fossil on every listing
+	void setVerifyChanges(bool verify) { verifyChanges = verify; }
+	bool getVerifyChanges() const { return verifyChanges; }
 	bool getExeVersion(QString &version);
 
-private:
-	enum RunFlags
-	{
-		RUNFLAGS_NONE			= 0<<0,
-		RUNFLAGS_SILENT_INPUT	= 1<<0,
-		RUNFLAGS_SILENT_OUTPUT	= 1<<1,
-		RUNFLAGS_SILENT_ALL		= RUNFLAGS_SILENT_INPUT | RUNFLAGS_SILENT_OUTPUT,
-		RUNFLAGS_DETACHED		= 1<<2,
-		RUNFLAGS_DEBUG			= 1<<3,
-	};
+	// Asynchronous commands
+	FossilJob *createJob(const QStringList &args, int runFlags=RUNFLAGS_NONE, QObject *jobParent=0);
 
+private:
 	void setRepositoryFile(const QString &filename) { repositoryFile = filename; }
 	bool runFossil(const QStringList &args, QStringList *output=0, int runFlags=RUNFLAGS_NONE);
-	bool runFossilRaw(const QStringList &args, QStringList *output, int *exitCode, int runFlags);
+	bool runFossil(const QStringList &args, LineScanner::Visitor &visitor, int runFlags=RUNFLAGS_NONE);
+	bool runFossilRaw(const QStringList &args, QStringList *output, int *exitCode, int runFlags, LineScanner::Visitor *visitor=0);
+	void logCommand(const QStringList &args);
+	bool openRepositoryDb(RepositoryDb &repo, qint64 &checkoutRid);
+	bool readWorkspaceState();
+	bool readFileList(FileListVisitor &visitor, const stringset_t *filePaths=0);
+	bool verifyFileList(FileListVisitor &visitor);
 	QString	getFossilPath();
 
 	void log(const QString &text, bool isHTML=false)
@@ -110,12 +126,16 @@ private:
 	UICallback			*uiCallback;
 	QString				workspacePath;
 	QString				fossilPath;		// The value from the settings
+	QString				resolvedPath;	// The executable actually run
+	FossilCapabilities	capabilities;
+	bool				capabilitiesProbed;
 	QString				repositoryFile;
 	QString				projectName;
 	QString				currentRevision;
 	QStringList			activeTags;
 	LoggedProcess		fossilUI;
 	QString				fossilUIPort;
+	bool				verifyChanges;
 };
 
 
@@ -0,0 +1,120 @@
+#include "FossilCapabilities.h"
+#include <QStringList>
+#include <QMap>
+#include <QMutex>
+#include <QRegExp>
+#include <QSettings>
+
+struct CachedCapabilities
+{
+	qint64				stamp;
+	FossilCapabilities	capabilities;
+};
+typedef QMap<QString, CachedCapabilities> capability_cache_t;
+
+// Workers probe from their own threads
+static QMutex				cacheMutex;
+static capability_cache_t	cache;
+
+///////////////////////////////////////////////////////////////////////////////
+FossilCapabilities::FossilCapabilities()
+	: features(0)
+{
+}
+
+//------------------------------------------------------------------------------
+void FossilCapabilities::parseVersion(const QStringList &lines)
+{
+	version.clear();
+	features &= ~(FEATURE_SHA3|FEATURE_JSON);
+
+	if(lines.isEmpty())
+		return;
+
+	int off = lines[0].indexOf("version ");
+	if(off==-1)
+		return;
+
+	version = lines[0].mid(off+8);
+
+	QRegExp number("^(\\d+)\\.");
+	if(number.indexIn(version)!=-1 && number.cap(1).toInt()>=2)
+		features |= FEATURE_SHA3;
+
+	// The verbose output lists the compile-time options
+	for(int i=1; i<lines.size(); ++i)
+	{
+		if(lines[i].trimmed().startsWith("JSON"))
+			features |= FEATURE_JSON;
+	}
+}
+
+//------------------------------------------------------------------------------
+void FossilCapabilities::parseChangesHelp(const QStringList &lines)
+{
+	QString help = lines.join("\n");
+	if(help.contains("--differ") && help.contains("--classify") && help.contains("--no-merge"))
+		features |= FEATURE_CHANGES_DIFFER;
+	else
+		features &= ~FEATURE_CHANGES_DIFFER;
+}
+
+//------------------------------------------------------------------------------
+bool FossilCapabilities::lookup(const QString &exePath, qint64 stamp, FossilCapabilities &capabilities)
+{
+	QMutexLocker lock(&cacheMutex);
+	capability_cache_t::const_iterator it = cache.find(exePath);
+	if(it==cache.end() || it->stamp!=stamp)
+		return false;
+
+	capabilities = it->capabilities;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+void FossilCapabilities::remember(const QString &exePath, qint64 stamp, const FossilCapabilities &capabilities)
+{
+	QMutexLocker lock(&cacheMutex);
+	CachedCapabilities &c = cache[exePath];
+	c.stamp = stamp;
+	c.capabilities = capabilities;
+}
+
+//------------------------------------------------------------------------------
+void FossilCapabilities::load(QSettings &store)
+{
+	QMutexLocker lock(&cacheMutex);
+
+	int count = store.beginReadArray("FossilCapabilities");
+	for(int i=0; i<count; ++i)
+	{
+		store.setArrayIndex(i);
+		QString path = store.value("Path").toString();
+		if(path.isEmpty() || cache.contains(path))
+			continue;
+
+		CachedCapabilities &c = cache[path];
+		c.stamp = store.value("Stamp").toLongLong();
+		c.capabilities.version = store.value("Version").toString();
+		c.capabilities.features = store.value("Features").toInt();
+	}
+	store.endArray();
+}
+
+//------------------------------------------------------------------------------
+void FossilCapabilities::save(QSettings &store)
+{
+	QMutexLocker lock(&cacheMutex);
+
+	store.beginWriteArray("FossilCapabilities", cache.size());
+	int index = 0;
+	for(capability_cache_t::const_iterator it=cache.begin(); it!=cache.end(); ++it, ++index)
+	{
+		store.setArrayIndex(index);
+		store.setValue("Path", it.key());
+		store.setValue("Stamp", it->stamp);
+		store.setValue("Version", it->capabilities.version);
+		store.setValue("Features", it->capabilities.features);
+	}
+	store.endArray();
+}
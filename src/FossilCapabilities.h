@@ -0,0 +1,46 @@
+#ifndef FOSSILCAPABILITIES_H
+#define FOSSILCAPABILITIES_H
+
+#include <QString>
+#include <QStringList>
+
+class QSettings;
+
+//////////////////////////////////////////////////////////////////////////
+// FossilCapabilities
+// What a fossil executable supports. Each executable is probed once per
+// modification time, and the results are shared by all Fossil instances.
+// The GUI keeps them in the settings between sessions.
+//////////////////////////////////////////////////////////////////////////
+class FossilCapabilities
+{
+public:
+	enum Feature
+	{
+		FEATURE_SHA3			= 1<<0,	// SHA3 artifacts and hash policies, fossil 2.0 and later
+		FEATURE_JSON			= 1<<1,	// Built with the JSON API
+		FEATURE_CHANGES_DIFFER	= 1<<2	// changes --differ --classify --no-merge
+	};
+
+	FossilCapabilities();
+
+	bool				isValid() const { return !version.isEmpty(); }
+	const QString		&getVersion() const { return version; }
+	bool				has(Feature feature) const { return (features & feature)!=0; }
+
+	// Parse the output of "fossil version -verbose" and "fossil help changes"
+	void				parseVersion(const QStringList &lines);
+	void				parseChangesHelp(const QStringList &lines);
+
+	// Shared cache, keyed by the absolute executable path
+	static bool			lookup(const QString &exePath, qint64 stamp, FossilCapabilities &capabilities);
+	static void			remember(const QString &exePath, qint64 stamp, const FossilCapabilities &capabilities);
+	static void			load(QSettings &store);
+	static void			save(QSettings &store);
+
+private:
+	QString				version;
+	int					features;
+};
+
+#endif // FOSSILCAPABILITIES_H
@@ -0,0 +1,417 @@
+#include "FossilDb.h"
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QFileInfo>
+#include <QMultiHash>
+#include <QDateTime>
+#include <QAtomicInt>
+#include "Utils.h"
+
+// Range of repository schemas this reader understands
+static const char		AUX_SCHEMA_MIN[] = "2011-04-25 19:50";
+static const char		AUX_SCHEMA_MAX[] = "2015-01-24";
+
+// How long to wait on a lock held by a fossil process before falling back
+static const int		BUSY_TIMEOUT_MS = 250;
+
+// vmerge.id of a pending integrate merge
+static const int		VMERGE_INTEGRATE = -4;
+
+// Number of rids looked up per blob query
+static const int		BLOB_BATCH_SIZE = 500;
+
+// Julian day of the unix epoch, as used by event.mtime
+static const double		JULIAN_DAY_UNIX_EPOCH = 2440587.5;
+static const double		MSECS_PER_DAY = 86400000.0;
+
+// Checks whether the check-in in the given column carries the closed tag
+#define SQL_IS_CLOSED(rid) "EXISTS(SELECT 1 FROM tagxref AS c WHERE c.rid=" rid \
+	" AND c.tagid=(SELECT tagid FROM tag WHERE tagname='closed') AND c.tagtype>0)"
+
+///////////////////////////////////////////////////////////////////////////////
+FossilDb::FossilDb()
+{
+}
+
+//------------------------------------------------------------------------------
+FossilDb::~FossilDb()
+{
+	close();
+}
+
+//------------------------------------------------------------------------------
+bool FossilDb::isAvailable()
+{
+	static bool available = QSqlDatabase::isDriverAvailable("QSQLITE");
+	return available;
+}
+
+//------------------------------------------------------------------------------
+bool FossilDb::openFile(const QString &filename)
+{
+	close();
+
+	if(!isAvailable() || !QFileInfo(filename).isFile())
+		return false;
+
+	static QAtomicInt next_id;
+	connectionName = QString("fuel-db-%0").arg(next_id.fetchAndAddRelaxed(1));
+
+	db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+	db.setDatabaseName(filename);
+	db.setConnectOptions(QString("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=%0").arg(BUSY_TIMEOUT_MS));
+
+	if(!db.open())
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------------
+void FossilDb::close()
+{
+	if(connectionName.isEmpty())
+		return;
+
+	db.close();
+	db = QSqlDatabase();
+	QSqlDatabase::removeDatabase(connectionName);
+	connectionName.clear();
+}
+
+//------------------------------------------------------------------------------
+// A deferred transaction only takes a shared lock on the first read, and
+// keeps all queries up to endRead() on a consistent snapshot
+bool FossilDb::beginRead()
+{
+	return isOpen() && db.transaction();
+}
+
+//------------------------------------------------------------------------------
+void FossilDb::endRead()
+{
+	if(isOpen())
+		db.rollback();
+}
+
+//------------------------------------------------------------------------------
+bool FossilDb::hasColumns(const QString &table, const QStringList &columns)
+{
+	QSqlRecord record = db.record(table);
+	foreach(const QString &column, columns)
+	{
+		if(record.indexOf(column)==-1)
+			return false;
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool CheckoutDb::open(const QString &_workspacePath)
+{
+	workspacePath = _workspacePath;
+	if(workspacePath.isEmpty())
+		return false;
+
+	// Fossil prefers the newer name when both exist
+	QString filename = workspacePath + PATH_SEPARATOR + FOSSIL_CHECKOUT2;
+	if(!QFileInfo(filename).isFile())
+		filename = workspacePath + PATH_SEPARATOR + FOSSIL_CHECKOUT1;
+
+	if(!openFile(filename))
+		return false;
+
+	if(!hasColumns("vvar", QStringList() << "name" << "value") ||
+		!hasColumns("vfile", QStringList() << "vid" << "chnged" << "deleted" << "rid" << "mtime" << "pathname" << "origname" << "islink" << "isexe") ||
+		!hasColumns("vmerge", QStringList() << "id"))
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+bool CheckoutDb::getVar(const QString &name, QString &value)
+{
+	QSqlQuery query(db);
+	query.prepare("SELECT value FROM vvar WHERE name=?");
+	query.addBindValue(name);
+	if(!query.exec() || !query.next())
+		return false;
+
+	value = query.value(0).toString();
+	return true;
+}
+
+//------------------------------------------------------------------------------
+bool CheckoutDb::getRepositoryFile(QString &filename)
+{
+	QString value;
+	if(!getVar("repository", value) || value.isEmpty())
+		return false;
+
+	filename = QFileInfo(QDir(workspacePath), value).absoluteFilePath();
+	return true;
+}
+
+//------------------------------------------------------------------------------
+bool CheckoutDb::getCheckoutId(qint64 &rid)
+{
+	QString value;
+	if(!getVar("checkout", value))
+		return false;
+
+	bool ok = false;
+	rid = value.toLongLong(&ok);
+	return ok;
+}
+
+//------------------------------------------------------------------------------
+bool CheckoutDb::isIntegrating(bool &integrating)
+{
+	QSqlQuery query(db);
+	query.prepare("SELECT 1 FROM vmerge WHERE id=? LIMIT 1");
+	query.addBindValue(VMERGE_INTEGRATE);
+	if(!query.exec())
+		return false;
+
+	integrating = query.next();
+	return true;
+}
+
+//------------------------------------------------------------------------------
+bool CheckoutDb::readFiles(entrylist_t &entries)
+{
+	entries.clear();
+
+	QSqlQuery query(db);
+	query.setForwardOnly(true);
+	if(!query.exec("SELECT pathname, origname, chnged, deleted, rid, mtime, islink, isexe FROM vfile"
+				   " WHERE vid=(SELECT value FROM vvar WHERE name='checkout')"
+				   " ORDER BY pathname"))
+		return false;
+
+	while(query.next())
+	{
+		FileEntry entry;
+		entry.filePath = query.value(0).toString();
+		QString origname = query.value(1).toString();
+		entry.renamed = !origname.isEmpty() && origname != entry.filePath;
+		entry.changed = query.value(2).toInt();
+		entry.deleted = query.value(3).toBool();
+		entry.rid = query.value(4).toLongLong();
+		entry.mtime = query.value(5).toLongLong();
+		entry.isLink = query.value(6).toBool();
+		entry.isExe = query.value(7).toBool();
+		entry.size = -1;
+		entry.type = WorkspaceFile::TYPE_UNKNOWN;
+		entries.append(entry);
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+bool CheckoutDb::readFileNames(stringset_t &names)
+{
+	names.clear();
+
+	QSqlQuery query(db);
+	query.setForwardOnly(true);
+	if(!query.exec("SELECT pathname FROM vfile"
+				   " WHERE vid=(SELECT value FROM vvar WHERE name='checkout')"))
+		return false;
+
+	while(query.next())
+		names.insert(query.value(0).toString());
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool RepositoryDb::open(const QString &repositoryFile)
+{
+	if(!openFile(repositoryFile))
+		return false;
+
+	if(!hasColumns("config", QStringList() << "name" << "value") ||
+		!hasColumns("blob", QStringList() << "rid" << "uuid" << "size") ||
+		!hasColumns("tag", QStringList() << "tagid" << "tagname") ||
+		!hasColumns("tagxref", QStringList() << "tagid" << "tagtype" << "rid" << "value") ||
+		!hasColumns("event", QStringList() << "objid" << "type" << "mtime" << "user") ||
+		!hasColumns("leaf", QStringList() << "rid"))
+	{
+		close();
+		return false;
+	}
+
+	// Leave schemas we do not know about to the fossil executable
+	QString schema;
+	if(!getConfig("aux-schema", schema) || schema < AUX_SCHEMA_MIN || schema > AUX_SCHEMA_MAX)
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+bool RepositoryDb::getConfig(const QString &name, QString &value)
+{
+	QSqlQuery query(db);
+	query.prepare("SELECT value FROM config WHERE name=?");
+	query.addBindValue(name);
+	if(!query.exec())
+		return false;
+
+	value = query.next() ? query.value(0).toString() : QString();
+	return true;
+}
+
+//------------------------------------------------------------------------------
+bool RepositoryDb::getProjectName(QString &name)
+{
+	return getConfig("project-name", name);
+}
+
+//------------------------------------------------------------------------------
+bool RepositoryDb::getCheckinInfo(qint64 rid, QString &hash, QStringList &tags)
+{
+	QSqlQuery query(db);
+	query.prepare("SELECT uuid FROM blob WHERE rid=?");
+	query.addBindValue(rid);
+	if(!query.exec() || !query.next())
+		return false;
+
+	hash = query.value(0).toString();
+
+	// Same selection as the "tags" line of "fossil info"
+	query.prepare("SELECT substr(tagname, 5) FROM tag, tagxref"
+				  " WHERE tagname GLOB 'sym-*' AND tag.tagid=tagxref.tagid"
+				  " AND tagxref.rid=? AND tagxref.tagtype>0");
+	query.addBindValue(rid);
+	if(!query.exec())
+		return false;
+
+	tags.clear();
+	while(query.next())
+		tags.append(query.value(0).toString());
+	tags.sort();
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Fill in the artifact hash and size of each entry. Fails if any committed
+// file has no matching blob, which means the checkout changed under us.
+bool RepositoryDb::readBlobInfo(CheckoutDb::entrylist_t &entries)
+{
+	// Files with identical content share a blob
+	QMultiHash<qint64, int> pending;
+	for(int i=0; i<entries.size(); ++i)
+	{
+		if(entries[i].rid!=0)
+			pending.insert(entries[i].rid, i);
+	}
+
+	QList<qint64> rids = pending.uniqueKeys();
+	for(int start=0; start<rids.size(); start+=BLOB_BATCH_SIZE)
+	{
+		QStringList batch;
+		for(int i=start; i<rids.size() && i<start+BLOB_BATCH_SIZE; ++i)
+			batch.append(QString::number(rids[i]));
+
+		QSqlQuery query(db);
+		query.setForwardOnly(true);
+		if(!query.exec("SELECT rid, uuid, size FROM blob WHERE rid IN ("+batch.join(",")+")"))
+			return false;
+
+		while(query.next())
+		{
+			qint64 rid = query.value(0).toLongLong();
+			QString hash = query.value(1).toString();
+			qint64 size = query.value(2).toLongLong();
+
+			QMultiHash<qint64, int>::iterator it = pending.find(rid);
+			while(it!=pending.end() && it.key()==rid)
+			{
+				entries[it.value()].hash = hash;
+				entries[it.value()].size = size;
+				it = pending.erase(it);
+			}
+		}
+	}
+
+	return pending.isEmpty();
+}
+
+//------------------------------------------------------------------------------
+// Resolve every symbolic tag to its most recent check-in, the same way
+// "fossil whatis tag:NAME" does. Closed tags, which are essentially closed
+// branches, are skipped like the "fossil tag ls" fallback does.
+bool RepositoryDb::readTags(QStringMap &tags)
+{
+	// SQLite takes the bare columns of an aggregate from the row holding max()
+	QSqlQuery query(db);
+	query.setForwardOnly(true);
+	if(!query.exec("SELECT substr(t.tagname, 5), b.uuid, max(e.mtime), " SQL_IS_CLOSED("x.rid")
+				   " FROM tag AS t, tagxref AS x, event AS e, blob AS b"
+				   " WHERE t.tagname GLOB 'sym-*' AND x.tagid=t.tagid AND x.tagtype>0"
+				   " AND e.objid=x.rid AND e.type='ci' AND b.rid=x.rid"
+				   " GROUP BY t.tagid"))
+		return false;
+
+	tags.clear();
+	while(query.next())
+	{
+		if(query.value(3).toBool())
+			continue;
+		tags.insert(query.value(0).toString(), query.value(1).toString());
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// List the open branches with their most recent check-in. Like "fossil branch"
+// a branch is open while at least one of its leaves is not closed.
+bool RepositoryDb::readBranches(qint64 checkoutRid, branchmap_t &branches, QString &currentBranch)
+{
+	QSqlQuery query(db);
+	query.setForwardOnly(true);
+	if(!query.exec("SELECT x.value, b.uuid, max(e.mtime), e.user,"
+				   " EXISTS(SELECT 1 FROM leaf AS l, tagxref AS lx WHERE lx.rid=l.rid AND lx.tagid=x.tagid"
+				   " AND lx.value=x.value AND lx.tagtype>0 AND NOT " SQL_IS_CLOSED("l.rid") ")"
+				   " FROM tagxref AS x, event AS e, blob AS b"
+				   " WHERE x.tagid=(SELECT tagid FROM tag WHERE tagname='branch') AND x.tagtype>0"
+				   " AND x.value IS NOT NULL AND e.objid=x.rid AND e.type='ci' AND b.rid=x.rid"
+				   " GROUP BY x.value"))
+		return false;
+
+	branches.clear();
+	while(query.next())
+	{
+		if(!query.value(4).toBool())
+			continue;
+
+		BranchTip tip;
+		tip.revision = query.value(1).toString();
+		qint64 msecs = static_cast<qint64>((query.value(2).toDouble() - JULIAN_DAY_UNIX_EPOCH) * MSECS_PER_DAY);
+		tip.lastCheckin = QDateTime::fromMSecsSinceEpoch(msecs);
+		tip.user = query.value(3).toString();
+		branches.insert(query.value(0).toString(), tip);
+	}
+
+	query.prepare("SELECT value FROM tagxref WHERE rid=? AND tagtype>0"
+				  " AND tagid=(SELECT tagid FROM tag WHERE tagname='branch')");
+	query.addBindValue(checkoutRid);
+	if(!query.exec())
+		return false;
+
+	currentBranch = query.next() ? query.value(0).toString() : QString();
+	return true;
+}
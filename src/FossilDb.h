@@ -0,0 +1,96 @@
+#ifndef FOSSILDB_H
+#define FOSSILDB_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QSqlDatabase>
+#include "WorkspaceCommon.h"
+
+//////////////////////////////////////////////////////////////////////////
+// FossilDb
+// Read-only connection to one of the sqlite databases fossil maintains.
+// Connections are meant to be short lived: they are opened, read within a
+// single deferred transaction and closed again, so that a concurrent fossil
+// process is never kept from writing (or on Windows, deleting) the file.
+//////////////////////////////////////////////////////////////////////////
+class FossilDb
+{
+public:
+	FossilDb();
+	virtual ~FossilDb();
+
+	static bool		isAvailable();
+
+	bool			isOpen() const { return db.isOpen(); }
+	QString			getFilename() const { return db.databaseName(); }
+	void			close();
+
+	bool			beginRead();
+	void			endRead();
+
+protected:
+	bool			openFile(const QString &filename);
+	bool			hasColumns(const QString &table, const QStringList &columns);
+
+	QSqlDatabase	db;
+	QString			connectionName;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// CheckoutDb
+// The _FOSSIL_ or .fslckout database of a workspace
+//////////////////////////////////////////////////////////////////////////
+class CheckoutDb : public FossilDb
+{
+public:
+	struct FileEntry
+	{
+		QString				filePath;
+		qint64				rid;
+		qint64				mtime;
+		int					changed;
+		bool				deleted;
+		bool				renamed;
+		bool				isLink;
+		bool				isExe;
+		QString				hash;		// Filled in by the RepositoryDb
+		qint64				size;
+		WorkspaceFile::Type	type;
+	};
+	typedef QVector<FileEntry> entrylist_t;
+
+	bool			open(const QString &workspacePath);
+
+	bool			getRepositoryFile(QString &filename);
+	bool			getCheckoutId(qint64 &rid);
+	bool			isIntegrating(bool &integrating);
+	bool			readFiles(entrylist_t &entries);
+	bool			readFileNames(stringset_t &names);
+
+private:
+	bool			getVar(const QString &name, QString &value);
+
+	QString			workspacePath;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// RepositoryDb
+// The repository database a workspace was opened from
+//////////////////////////////////////////////////////////////////////////
+class RepositoryDb : public FossilDb
+{
+public:
+	bool			open(const QString &repositoryFile);
+
+	bool			getProjectName(QString &name);
+	bool			getCheckinInfo(qint64 rid, QString &hash, QStringList &tags);
+	bool			readBlobInfo(CheckoutDb::entrylist_t &entries);
+	bool			readTags(QStringMap &tags);
+	bool			readBranches(qint64 checkoutRid, branchmap_t &branches, QString &currentBranch);
+
+private:
+	bool			getConfig(const QString &name, QString &value);
+};
+
+#endif // FOSSILDB_H
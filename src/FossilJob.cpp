@@ -0,0 +1,403 @@
+#include "FossilJob.h"
+#include <QDebug>
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QThread>
+#ifndef Q_OS_WIN
+#include <sys/types.h>
+#include <signal.h>
+#endif
+
+static const unsigned char		UTF8_BOM[] = { 0xEF, 0xBB, 0xBF };
+
+///////////////////////////////////////////////////////////////////////////////
+FossilJob::FossilJob(const QString &fossilPath, const QStringList &args, const QString &workingDir, int runFlags, UICallback *callback, QObject *parent)
+	: QObject(parent)
+	, fossilPath(fossilPath)
+	, args(args)
+	, workingDir(workingDir)
+	, runFlags(runFlags)
+	, uiCallback(callback)
+	, process(this)
+	, timeoutMs(0)
+	, lineVisitor(0)
+	, collectOutput(false)
+	, queryAnswered(false)
+	, awaitingAnswer(false)
+	, state(STATE_IDLE)
+	, aborted(false)
+	, timedOut(false)
+	, normalExit(false)
+	, exitCode(EXIT_FAILURE)
+{
+	Q_ASSERT((runFlags & RUNFLAGS_DETACHED) == 0);
+
+	previousLine.reserve(256);
+
+	if(runFlags & RUNFLAGS_TIMEOUT_SYNC)
+		timeoutMs = SYNC_TIMEOUT_MS;
+	else if(runFlags & RUNFLAGS_TIMEOUT_DIFF)
+		timeoutMs = DIFF_TIMEOUT_MS;
+	else if(runFlags & RUNFLAGS_TIMEOUT_METADATA)
+		timeoutMs = METADATA_TIMEOUT_MS;
+
+	watchdog.setInterval(WAIT_SLICE_MS);
+	connect(&watchdog, SIGNAL(timeout()), this, SLOT(checkDeadlines()));
+
+	// LoggedProcess connects its own slot first, so the log is already
+	// populated by the time onReadyRead is invoked
+	connect(&process, SIGNAL(readyReadStandardOutput()), this, SLOT(onReadyRead()));
+	connect(&process, SIGNAL(finished(int, QProcess::ExitStatus)), this, SLOT(onProcessFinished(int, QProcess::ExitStatus)));
+	connect(&process, SIGNAL(error(QProcess::ProcessError)), this, SLOT(onProcessError(QProcess::ProcessError)));
+}
+
+//------------------------------------------------------------------------------
+FossilJob::~FossilJob()
+{
+	if(process.state()!=QProcess::NotRunning)
+	{
+		signalProcess(true);
+		process.waitForFinished(EXIT_WAIT_MS);
+	}
+}
+
+//------------------------------------------------------------------------------
+bool FossilJob::start()
+{
+	Q_ASSERT(state == STATE_IDLE);
+
+	// Generate args file
+	if(!argsFile.open())
+	{
+		if(uiCallback)
+			uiCallback->logText(QObject::tr("Could not generate command line file"), false);
+		finish(false, EXIT_FAILURE);
+		return false;
+	}
+
+	// Write BOM
+	argsFile.write(reinterpret_cast<const char *>(UTF8_BOM), sizeof(UTF8_BOM));
+
+	// Write Args
+	foreach(const QString &arg, args)
+	{
+		argsFile.write(arg.toUtf8());
+		argsFile.write("\n");
+	}
+	argsFile.close();
+
+	// Replace args with args filename
+	QStringList run_args;
+	run_args.append("--args");
+	run_args.append(argsFile.fileName());
+
+	process.setWorkingDirectory(workingDir);
+	state = STATE_RUNNING;
+	process.start(fossilPath, run_args);
+
+	if(!process.waitForStarted())
+	{
+		if(uiCallback)
+			uiCallback->logText(QObject::tr("Could not start Fossil executable '%0'").arg(fossilPath)+"\n", false);
+		finish(false, EXIT_FAILURE);
+		return false;
+	}
+
+	activityTimer.start();
+	watchdog.start();
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Wait for the process to exit. On the GUI thread the events keep flowing,
+// so that the window repaints and the abort can be clicked. Elsewhere the
+// process is pumped directly via its blocking API.
+bool FossilJob::waitForFinished()
+{
+	if(thread()==QCoreApplication::instance()->thread())
+	{
+		if(!isFinished())
+		{
+			QEventLoop loop;
+			connect(this, SIGNAL(finished(FossilJob*)), &loop, SLOT(quit()));
+			loop.exec();
+		}
+		return succeeded();
+	}
+
+	// Timers are not dispatched from here on
+	watchdog.stop();
+
+	while(!isFinished())
+	{
+		checkDeadlines();
+		if(isFinished())
+			break;
+
+		if(process.state()==QProcess::NotRunning)
+		{
+			// Exited without a notification reaching us
+			onReadyRead();
+			onProcessFinished(process.exitCode(), process.exitStatus());
+			break;
+		}
+
+		process.waitForReadyRead(WAIT_SLICE_MS);
+	}
+
+	return succeeded();
+}
+
+//------------------------------------------------------------------------------
+void FossilJob::abort()
+{
+	if(aborted || isFinished())
+		return;
+
+	// Never started
+	if(state==STATE_IDLE)
+	{
+		aborted = true;
+		finish(false, EXIT_FAILURE);
+		return;
+	}
+
+	aborted = true;
+	abortTimer.start();
+	signalProcess(false);
+}
+
+//------------------------------------------------------------------------------
+// Signal the process group of fossil, so that the network helpers and diff
+// tools it started go away with it
+void FossilJob::signalProcess(bool force)
+{
+#ifdef Q_OS_WIN
+	Q_UNUSED(force);
+	process.kill(); // QT on windows cannot terminate console processes with QProcess::terminate
+#else
+	pid_t pid = static_cast<pid_t>(process.processId());
+	if(pid>0 && ::kill(-pid, force ? SIGKILL : SIGTERM)==0)
+		return;
+
+	// Not a group leader after all
+	if(force)
+		process.kill();
+	else
+		process.terminate();
+#endif
+}
+
+//------------------------------------------------------------------------------
+void FossilJob::checkDeadlines()
+{
+	if(!isRunning())
+		return;
+
+	if(!aborted && uiCallback && uiCallback->processAborted())
+		abort();
+
+	if(!aborted && !awaitingAnswer && timeoutMs>0 && activityTimer.hasExpired(timeoutMs))
+	{
+		timedOut = true;
+		if(uiCallback)
+			uiCallback->logText(QObject::tr("Fossil did not respond for %0 seconds").arg(timeoutMs/1000)+"\n", false);
+		abort();
+	}
+
+	// Whatever survived the grace period is killed, and the caller released
+	// right away rather than waiting for the process to be reaped
+	if(aborted && abortTimer.hasExpired(KILL_GRACE_MS))
+	{
+		signalProcess(true);
+		finish(false, EXIT_FAILURE);
+	}
+}
+
+//------------------------------------------------------------------------------
+void FossilJob::answer(QMessageBox::StandardButton button)
+{
+	if(!isRunning())
+		return;
+
+	queryAnswered = true;
+	awaitingAnswer = false;
+	activityTimer.restart();
+
+	const char *reply = "n\n";
+	if(button==QMessageBox::Yes)
+		reply = "y\n";
+	else if(button==QMessageBox::YesAll)
+		reply = "a\n";
+	else if(button==QMessageBox::Apply)
+		reply = "c\n";
+
+	process.write(reply);
+
+	if(uiCallback)
+		uiCallback->logText(QString(QChar(reply[0])).toUpper()+"\n", false);
+}
+
+//------------------------------------------------------------------------------
+void FossilJob::onReadyRead()
+{
+	if(process.isLogEmpty())
+		return;
+
+	QByteArray input;
+	process.getLogAndClear(input);
+	activityTimer.restart();
+
+	// Output after an abort is neither parsed nor answered
+	if(aborted)
+		return;
+
+	#ifdef QT_DEBUG // Log fossil output in debug builds
+	if(runFlags & RUNFLAGS_DEBUG)
+		qDebug() << "'" << input.data() << "'\n";
+	#endif
+
+	scanner.feed(input.constData(), input.size(), *this);
+
+	// Any remaining text is an unterminated line which may be a query
+	LineScanner::QueryType query = scanner.detectQuery();
+	if(query!=LineScanner::QUERY_NONE)
+		handleQuery(query);
+}
+
+//------------------------------------------------------------------------------
+QString FossilJob::decodeLine(const char *data, int length)
+{
+#ifdef Q_OS_WIN
+	return QString::fromUtf8(data, length);
+#else
+	return QString::fromLocal8Bit(data, length);
+#endif
+}
+
+//------------------------------------------------------------------------------
+void FossilJob::onLine(const char *data, int length)
+{
+	previousLine.resize(0);
+	previousLine.append(data, length);
+
+	if(lineVisitor)
+		lineVisitor->onLine(data, length);
+
+	// Only pay for decoding when the text is going somewhere
+	bool logged = uiCallback && !(runFlags & RUNFLAGS_SILENT_OUTPUT);
+	if(!collectOutput && !logged && receivers(SIGNAL(lineReceived(QString)))==0)
+		return;
+
+	QString line = decodeLine(data, length);
+
+#ifdef QT_DEBUG
+	if(runFlags & RUNFLAGS_DEBUG)
+		qDebug() << "LINE: " << line << "\n";
+#endif
+
+	if(collectOutput)
+		output.append(line);
+
+	log(line+"\n");
+	emit lineReceived(line);
+}
+
+//------------------------------------------------------------------------------
+static QString ParseFossilQuery(QString line)
+{
+	// Extract question
+	int qend = line.lastIndexOf('(');
+	if(qend == -1)
+		qend = line.lastIndexOf('[');
+	Q_ASSERT(qend!=-1);
+	line = line.left(qend);
+	line = line.trimmed();
+	line += "?";
+	line[0]=QString(line[0]).toUpper()[0];
+	return line;
+}
+
+//------------------------------------------------------------------------------
+void FossilJob::handleQuery(LineScanner::QueryType type)
+{
+	QMessageBox::StandardButtons buttons;
+	bool with_context = type==LineScanner::QUERY_YNA || type==LineScanner::QUERY_ACYN;
+	if(with_context)
+	{
+		buttons = QMessageBox::YesToAll|QMessageBox::Yes|QMessageBox::No;
+
+		// Map the Convert option to the Apply button
+		if(type==LineScanner::QUERY_ACYN)
+			buttons |= QMessageBox::Apply;
+	}
+	else if(type==LineScanner::QUERY_YN)
+		buttons = QMessageBox::Yes|QMessageBox::No;
+	else if(type==LineScanner::QUERY_AN)
+		buttons = QMessageBox::YesToAll|QMessageBox::No;
+	else
+		return;
+
+	// The query is consumed
+	QByteArray tail = scanner.getTail();
+	scanner.clearTail();
+	QString line = decodeLine(tail.constData(), tail.size());
+
+	if(uiCallback)
+		uiCallback->logText(line, false);
+
+	QString query = ParseFossilQuery(line);
+
+	// Add any extra text available to the query
+	if(with_context && !previousLine.isEmpty())
+		query = decodeLine(previousLine.constData(), previousLine.size()) + "\n" + query;
+
+	// Give any listeners the chance to answer first
+	queryAnswered = false;
+	awaitingAnswer = true;
+	emit queryReceived(query, buttons);
+
+	if(queryAnswered)
+		return;
+
+	QMessageBox::StandardButton res = QMessageBox::No;
+	if(uiCallback)
+		res = uiCallback->Query("Fossil", query, buttons);
+	answer(res);
+}
+
+//------------------------------------------------------------------------------
+void FossilJob::onProcessFinished(int code, QProcess::ExitStatus status)
+{
+	if(isFinished())
+		return;
+
+	// Collect any output still pending
+	onReadyRead();
+
+	// Flush the final unterminated line
+	scanner.flush(*this);
+
+	finish(status==QProcess::NormalExit, code);
+}
+
+//------------------------------------------------------------------------------
+void FossilJob::onProcessError(QProcess::ProcessError error)
+{
+	// Processes that fail to start never emit finished
+	if(error==QProcess::FailedToStart && isRunning())
+		finish(false, EXIT_FAILURE);
+}
+
+//------------------------------------------------------------------------------
+void FossilJob::finish(bool normal, int code)
+{
+	if(isFinished())
+		return;
+
+	watchdog.stop();
+	state = STATE_FINISHED;
+	normalExit = normal;
+	exitCode = code;
+	emit finished(this);
+}
@@ -0,0 +1,136 @@
+#ifndef FOSSILJOB_H
+#define FOSSILJOB_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QMessageBox>
+#include <QTemporaryFile>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "LoggedProcess.h"
+#include "LineScanner.h"
+#include "Utils.h"
+
+enum FossilRunFlags
+{
+	RUNFLAGS_NONE			= 0<<0,
+	RUNFLAGS_SILENT_INPUT	= 1<<0,
+	RUNFLAGS_SILENT_OUTPUT	= 1<<1,
+	RUNFLAGS_SILENT_ALL		= RUNFLAGS_SILENT_INPUT | RUNFLAGS_SILENT_OUTPUT,
+	RUNFLAGS_DETACHED		= 1<<2,
+	RUNFLAGS_DEBUG			= 1<<3,
+
+	// Give up on fossil once it has been silent for the limit of its command class
+	RUNFLAGS_TIMEOUT_METADATA	= 1<<4,
+	RUNFLAGS_TIMEOUT_SYNC		= 1<<5,
+	RUNFLAGS_TIMEOUT_DIFF		= 1<<6,
+};
+
+//////////////////////////////////////////////////////////////////////////
+// FossilJob
+// A single fossil invocation driven by the process signals. Output lines
+// and interactive queries are reported as they arrive. A job can either
+// be left to run asynchronously or be waited upon via waitForFinished().
+// Waiting on the GUI thread runs a local event loop, while a worker thread
+// drives the process directly.
+// Aborting terminates the whole process group of fossil, and kills it if
+// it is still around after KILL_GRACE_MS. The job finishes at that point
+// without waiting any further on the process.
+//////////////////////////////////////////////////////////////////////////
+class FossilJob : public QObject, private LineScanner::Visitor
+{
+	Q_OBJECT
+public:
+	FossilJob(const QString &fossilPath, const QStringList &args, const QString &workingDir, int runFlags, UICallback *callback, QObject *parent=0);
+	~FossilJob();
+
+	bool				start();
+	bool				waitForFinished();
+	void				abort();
+	void				answer(QMessageBox::StandardButton button);
+
+	void				setCollectOutput(bool collect) { collectOutput = collect; }
+	void				setLineVisitor(LineScanner::Visitor *visitor) { lineVisitor = visitor; }
+	const QStringList	&getOutput() const { return output; }
+	const QStringList	&getArgs() const { return args; }
+
+	bool				isRunning() const { return state == STATE_RUNNING; }
+	bool				isFinished() const { return state == STATE_FINISHED; }
+	bool				isAborted() const { return aborted; }
+	bool				isTimedOut() const { return timedOut; }
+	bool				succeeded() const { return isFinished() && normalExit && !aborted; }
+	int					getExitCode() const { return exitCode; }
+
+	// Lines are split on ASCII terminators before decoding, which is safe
+	// for UTF-8 and any other ASCII compatible locale encoding
+	static QString		decodeLine(const char *data, int length);
+
+signals:
+	void				lineReceived(const QString &line);
+	void				queryReceived(const QString &query, QMessageBox::StandardButtons buttons);
+	void				finished(FossilJob *job);
+
+private slots:
+	void				onReadyRead();
+	void				onProcessFinished(int code, QProcess::ExitStatus status);
+	void				onProcessError(QProcess::ProcessError error);
+	void				checkDeadlines();
+
+private:
+	enum State
+	{
+		STATE_IDLE,
+		STATE_RUNNING,
+		STATE_FINISHED
+	};
+
+	enum
+	{
+		WAIT_SLICE_MS		= 25,
+		KILL_GRACE_MS		= 50,	// From SIGTERM to SIGKILL
+		EXIT_WAIT_MS		= 1000,	// For a killed process to be reaped
+
+		METADATA_TIMEOUT_MS	= 60000,
+		SYNC_TIMEOUT_MS		= 120000,
+		DIFF_TIMEOUT_MS		= 60000
+	};
+
+	void				onLine(const char *line, int length);
+	void				handleQuery(LineScanner::QueryType type);
+	void				finish(bool normal, int code);
+	void				signalProcess(bool force);
+	void				log(const QString &text, bool isHTML=false)
+	{
+		if(uiCallback && !(runFlags & RUNFLAGS_SILENT_OUTPUT))
+			uiCallback->logText(text, isHTML);
+	}
+
+	QString				fossilPath;
+	QStringList			args;
+	QString				workingDir;
+	int					runFlags;
+	UICallback			*uiCallback;
+
+	LoggedProcess		process;
+	QTemporaryFile		argsFile;
+	QTimer				watchdog;		// Only while running asynchronously
+	QElapsedTimer		activityTimer;	// Since the last output
+	QElapsedTimer		abortTimer;
+	int					timeoutMs;
+	LineScanner			scanner;
+	LineScanner::Visitor *lineVisitor;
+	QByteArray			previousLine;
+	QStringList			output;
+	bool				collectOutput;
+	bool				queryAnswered;
+	bool				awaitingAnswer;	// The user's think time is not fossil's
+
+	State				state;
+	bool				aborted;
+	bool				timedOut;
+	bool				normalExit;
+	int					exitCode;
+};
+
+#endif // FOSSILJOB_H
@@ -0,0 +1,292 @@
+#include "FuzzyMatcher.h"
+#include <QtConcurrent/QtConcurrentRun>
+#include <QFuture>
+#include <QThread>
+#include <algorithm>
+#include "FileFilter.h"
+
+//////////////////////////////////////////////////////////////////////////
+// ResultLess
+//////////////////////////////////////////////////////////////////////////
+struct ResultLess
+{
+	bool operator()(const FuzzyMatcher::Result &l, const FuzzyMatcher::Result &r) const
+	{
+		if(l.score!=r.score)
+			return l.score > r.score;
+		return l.row < r.row;
+	}
+};
+
+//------------------------------------------------------------------------------
+static bool IsSubsequence(const QVector<ushort> &needle, const QVector<ushort> &haystack)
+{
+	int n = 0;
+	for(int i=0; i<haystack.size() && n<needle.size(); ++i)
+	{
+		if(haystack[i]==needle[n])
+			++n;
+	}
+	return n==needle.size();
+}
+
+//------------------------------------------------------------------------------
+// Keeps the best maxResults of the list, sorted
+static void KeepBest(FuzzyMatcher::resultlist_t &results, int maxResults)
+{
+	if(results.size() > maxResults)
+	{
+		std::nth_element(results.begin(), results.begin()+maxResults, results.end(), ResultLess());
+		results.resize(maxResults);
+	}
+	std::sort(results.begin(), results.end(), ResultLess());
+}
+
+//////////////////////////////////////////////////////////////////////////
+// FuzzyMatcher::MatchTask
+// Scores one chunk of the candidates on a worker thread
+//////////////////////////////////////////////////////////////////////////
+class FuzzyMatcher::MatchTask
+{
+public:
+	typedef void result_type;
+
+	MatchTask(const FuzzyMatcher &matcher, Chunk &chunk, const QVector<ushort> &query, int maxResults)
+		: matcher(matcher)
+		, chunk(chunk)
+		, query(query)
+		, maxResults(maxResults)
+	{
+	}
+
+	void operator()()
+	{
+		matcher.matchChunk(chunk, query, maxResults);
+	}
+
+private:
+	const FuzzyMatcher		&matcher;
+	Chunk					&chunk;
+	const QVector<ushort>	&query;
+	int						maxResults;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+FuzzyMatcher::FuzzyMatcher()
+{
+}
+
+//------------------------------------------------------------------------------
+void FuzzyMatcher::clear()
+{
+	rows.clear();
+	entryOfRow.clear();
+	chars.clear();
+	bonuses.clear();
+	offsets.clear();
+	nameStarts.clear();
+	recentBonuses.clear();
+	recentEntries.clear();
+	lastQuery.clear();
+	lastMatched.clear();
+}
+
+//------------------------------------------------------------------------------
+void FuzzyMatcher::setRows(const FileTable &files, const QVector<int> &fileRows)
+{
+	clear();
+	rows = fileRows;
+	entryOfRow.fill(-1, files.getRowCount());
+
+	chars.reserve(rows.size()*24);
+	bonuses.reserve(rows.size()*24);
+	offsets.resize(rows.size()+1);
+	nameStarts.resize(rows.size());
+
+	for(int e=0; e<rows.size(); ++e)
+	{
+		int row = rows[e];
+		entryOfRow[row] = e;
+		offsets[e] = chars.size();
+
+		QString path = files.getFilePath(row);
+		nameStarts[e] = chars.size() + path.lastIndexOf('/') + 1;
+
+		ushort prev = '/';
+		for(int i=0; i<path.length(); ++i)
+		{
+			ushort c = path[i].unicode();
+
+			int bonus = 0;
+			if(prev=='/')
+				bonus = BONUS_SEGMENT;
+			else if(prev=='_' || prev=='-' || prev=='.' || prev==' ')
+				bonus = BONUS_WORD;
+			else if(QChar(prev).isLower() && QChar(c).isUpper())
+				bonus = BONUS_CAMEL;
+
+			chars.append(FileFilter::foldChar(c));
+			bonuses.append(static_cast<quint8>(bonus));
+			prev = c;
+		}
+	}
+	offsets[rows.size()] = chars.size();
+}
+
+//------------------------------------------------------------------------------
+void FuzzyMatcher::setRecent(const QVector<int> &recentRows)
+{
+	recentBonuses.clear();
+	recentEntries.clear();
+
+	foreach(int row, recentRows)
+	{
+		int entry = row<entryOfRow.size() ? entryOfRow[row] : -1;
+		if(entry<0 || recentBonuses.contains(entry))
+			continue;
+
+		recentBonuses.insert(entry, qMax(BONUS_RECENT - 4*recentEntries.size(), 4));
+		recentEntries.append(entry);
+	}
+}
+
+//------------------------------------------------------------------------------
+int FuzzyMatcher::score(int entry, const ushort *query, int length) const
+{
+	const int begin = offsets[entry];
+	const int end = offsets[entry+1];
+	const ushort *text = chars.constData();
+	const quint8 *bonus = bonuses.constData();
+
+	// Reject the paths that do not contain the query as a subsequence
+	int q = 0;
+	for(int i=begin; i<end && q<length; ++i)
+	{
+		if(text[i]==query[q])
+			++q;
+	}
+	if(q<length)
+		return -1;
+
+	// Align from the end, so that the match leans towards the file name
+	const int name_start = nameStarts[entry];
+	int total = 0;
+	int next = -1;
+	int pos = end-1;
+	for(q=length-1; q>=0; --q, --pos)
+	{
+		while(text[pos]!=query[q])
+			--pos;
+
+		total += SCORE_MATCH + bonus[pos];
+		if(pos>=name_start)
+			total += BONUS_NAME;
+
+		if(next>=0)
+		{
+			if(next==pos+1)
+				total += BONUS_CONSECUTIVE;
+			else
+				total -= qMin(next-pos-1, int(MAX_GAP_PENALTY));
+		}
+		next = pos;
+	}
+
+	// Shorter paths win ties
+	total -= (end-begin) / 8;
+
+	if(!recentBonuses.isEmpty())
+		total += recentBonuses.value(entry);
+
+	return qMax(total, 0);
+}
+
+//------------------------------------------------------------------------------
+void FuzzyMatcher::matchChunk(Chunk &chunk, const QVector<ushort> &query, int maxResults) const
+{
+	for(const int *it=chunk.begin; it!=chunk.end; ++it)
+	{
+		int s = score(*it, query.constData(), query.size());
+		if(s<0)
+			continue;
+
+		// The row holds the entry until match() maps it back
+		chunk.matched.append(*it);
+		Result r = { *it, s };
+		chunk.best.append(r);
+	}
+
+	KeepBest(chunk.best, maxResults);
+}
+
+//------------------------------------------------------------------------------
+void FuzzyMatcher::match(const QString &query, int maxResults, resultlist_t &results)
+{
+	results.clear();
+
+	QVector<ushort> folded;
+	folded.reserve(query.length());
+	foreach(const QChar &c, query)
+	{
+		if(!c.isSpace())
+			folded.append(FileFilter::foldChar(c.unicode()));
+	}
+
+	if(folded.isEmpty())
+	{
+		lastQuery.clear();
+		lastMatched.clear();
+		for(int i=0; i<recentEntries.size() && i<maxResults; ++i)
+		{
+			Result r = { rows[recentEntries[i]], recentBonuses.value(recentEntries[i]) };
+			results.append(r);
+		}
+		return;
+	}
+
+	// Every match of the longer query also matches the previous one
+	QVector<int> all_entries;
+	const QVector<int> *candidates = &lastMatched;
+	if(lastQuery.isEmpty() || !IsSubsequence(lastQuery, folded))
+	{
+		all_entries.resize(rows.size());
+		for(int e=0; e<rows.size(); ++e)
+			all_entries[e] = e;
+		candidates = &all_entries;
+	}
+
+	int chunk_count = 1;
+	if(candidates->size() >= MIN_PARALLEL_ENTRIES)
+		chunk_count = qMax(1, QThread::idealThreadCount());
+
+	QVector<Chunk> chunks(chunk_count);
+	const int *data = candidates->constData();
+	for(int c=0; c<chunk_count; ++c)
+	{
+		chunks[c].begin = data + qint64(candidates->size())*c/chunk_count;
+		chunks[c].end = data + qint64(candidates->size())*(c+1)/chunk_count;
+	}
+
+	// The first chunk is scored on this thread
+	QVector<QFuture<void> > futures;
+	for(int c=1; c<chunk_count; ++c)
+		futures.append(QtConcurrent::run(MatchTask(*this, chunks[c], folded, maxResults)));
+	matchChunk(chunks[0], folded, maxResults);
+	for(int f=0; f<futures.size(); ++f)
+		futures[f].waitForFinished();
+
+	// Chunks are contiguous, so the merged matches keep the candidate order
+	QVector<int> matched;
+	foreach(const Chunk &chunk, chunks)
+	{
+		matched += chunk.matched;
+		results += chunk.best;
+	}
+	KeepBest(results, maxResults);
+
+	for(int i=0; i<results.size(); ++i)
+		results[i].row = rows[results[i].row];
+
+	lastQuery = folded;
+	lastMatched = matched;
+}
@@ -0,0 +1,82 @@
+#ifndef FUZZYMATCHER_H
+#define FUZZYMATCHER_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include "FileTable.h"
+
+//////////////////////////////////////////////////////////////////////////
+// FuzzyMatcher
+// Ranks file paths by how well a query matches them as a subsequence.
+// The folded paths and a per character bonus live in packed arrays that
+// are scored in parallel chunks. A query extending the previous one only
+// rescores the paths the previous one matched.
+//////////////////////////////////////////////////////////////////////////
+class FuzzyMatcher
+{
+public:
+	struct Result
+	{
+		int		row;
+		int		score;
+	};
+	typedef QVector<Result> resultlist_t;
+
+	FuzzyMatcher();
+
+	void				clear();
+	bool				isEmpty() const { return rows.isEmpty(); }
+	void				setRows(const FileTable &files, const QVector<int> &fileRows);
+
+	// Rows opened recently rank higher, most recent first
+	void				setRecent(const QVector<int> &recentRows);
+
+	// The best rows for the query, best first. An empty query lists the
+	// recent rows.
+	void				match(const QString &query, int maxResults, resultlist_t &results);
+
+private:
+	class MatchTask;
+
+	enum
+	{
+		SCORE_MATCH				= 16,
+		BONUS_SEGMENT			= 24,	// First character of a path segment
+		BONUS_WORD				= 16,	// After a '_', '-', '.' or space
+		BONUS_CAMEL				= 12,	// An uppercase after a lowercase
+		BONUS_NAME				= 8,	// Any character of the file name
+		BONUS_CONSECUTIVE		= 12,
+		BONUS_RECENT			= 64,	// For the most recent, decreasing
+		MAX_GAP_PENALTY			= 12,
+		MIN_PARALLEL_ENTRIES	= 16384
+	};
+
+	struct Chunk
+	{
+		const int		*begin;
+		const int		*end;
+		QVector<int>	matched;	// Entries, in candidate order
+		resultlist_t	best;		// Entries with their score
+	};
+
+	int					score(int entry, const ushort *query, int length) const;
+	void				matchChunk(Chunk &chunk, const QVector<ushort> &query, int maxResults) const;
+
+	QVector<int>		rows;
+	QVector<int>		entryOfRow;		// -1 for the rows not listed
+
+	// The packed paths, folded, and the bonus of each of their characters
+	QVector<ushort>		chars;
+	QVector<quint8>		bonuses;
+	QVector<int>		offsets;
+	QVector<int>		nameStarts;
+
+	QHash<int, int>		recentBonuses;	// By entry
+	QVector<int>		recentEntries;
+
+	QVector<ushort>		lastQuery;
+	QVector<int>		lastMatched;
+};
+
+#endif // FUZZYMATCHER_H
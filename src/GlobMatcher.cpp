@@ -0,0 +1,191 @@
+#include "GlobMatcher.h"
+
+///////////////////////////////////////////////////////////////////////////////
+GlobMatcher::GlobMatcher(const QStringList &patterns)
+{
+	foreach(const QString &p, patterns)
+	{
+		if(p.isEmpty())
+			continue;
+
+		if(p.endsWith("/*") && p.length()>2)
+			directoryGlobs << p.left(p.length()-2);
+
+		if(!hasWildcards(p))
+			literals.insert(p);
+		else if(p.length()>1 && p.endsWith('*') && !hasWildcards(p.left(p.length()-1)))
+			prefixes << p.left(p.length()-1);
+		else if(p.length()>1 && p.startsWith('*') && !hasWildcards(p.mid(1)))
+			suffixes << p.mid(1);
+		else
+			globs << p;
+	}
+}
+
+//------------------------------------------------------------------------------
+bool GlobMatcher::isEmpty() const
+{
+	return literals.isEmpty() && prefixes.isEmpty() && suffixes.isEmpty() && globs.isEmpty();
+}
+
+//------------------------------------------------------------------------------
+bool GlobMatcher::hasWildcards(const QString &pattern)
+{
+	for(int i=0; i<pattern.length(); ++i)
+	{
+		QChar c = pattern[i];
+		if(c=='*' || c=='?' || c=='[')
+			return true;
+	}
+	return false;
+}
+
+//------------------------------------------------------------------------------
+bool GlobMatcher::matches(const QString &path) const
+{
+	if(literals.contains(path))
+		return true;
+
+	foreach(const QString &p, prefixes)
+	{
+		if(path.startsWith(p))
+			return true;
+	}
+
+	foreach(const QString &s, suffixes)
+	{
+		if(path.endsWith(s))
+			return true;
+	}
+
+	foreach(const QString &g, globs)
+	{
+		if(matchGlob(g, path))
+			return true;
+	}
+	return false;
+}
+
+//------------------------------------------------------------------------------
+bool GlobMatcher::matchesPath(const QString &path) const
+{
+	for(int i=path.indexOf('/'); i>=0; i=path.indexOf('/', i+1))
+	{
+		if(matches(path.left(i)))
+			return true;
+	}
+	return matches(path);
+}
+
+//------------------------------------------------------------------------------
+bool GlobMatcher::matchesAllBelow(const QString &dirPath) const
+{
+	foreach(const QString &g, directoryGlobs)
+	{
+		if(matchGlob(g, dirPath))
+			return true;
+	}
+	return false;
+}
+
+//------------------------------------------------------------------------------
+bool GlobMatcher::matchGlob(const QString &pattern, const QString &text)
+{
+	const QChar *p = pattern.constData();
+	const QChar *t = text.constData();
+	return matchGlob(p, p+pattern.length(), t, t+text.length());
+}
+
+//------------------------------------------------------------------------------
+// The glob semantics of sqlite's strglob(), which fossil uses
+bool GlobMatcher::matchGlob(const QChar *pattern, const QChar *patternEnd, const QChar *text, const QChar *textEnd)
+{
+	while(pattern<patternEnd)
+	{
+		QChar c = *pattern++;
+
+		if(c=='*')
+		{
+			// Collapse runs of wildcards
+			while(pattern<patternEnd && (*pattern=='*' || *pattern=='?'))
+			{
+				if(*pattern=='?')
+				{
+					if(text==textEnd)
+						return false;
+					++text;
+				}
+				++pattern;
+			}
+
+			if(pattern==patternEnd)
+				return true;
+
+			for(; text<textEnd; ++text)
+			{
+				// Only try positions that can match the next literal
+				if(*pattern!='[' && *text!=*pattern)
+					continue;
+				if(matchGlob(pattern, patternEnd, text, textEnd))
+					return true;
+			}
+			return false;
+		}
+
+		if(text==textEnd)
+			return false;
+
+		if(c=='[')
+		{
+			const QChar *q = pattern;
+			bool invert = false;
+			bool seen = false;
+
+			if(q<patternEnd && *q=='^')
+			{
+				invert = true;
+				++q;
+			}
+
+			// A leading ']' is part of the set
+			if(q<patternEnd && *q==']')
+			{
+				seen = *text==']';
+				++q;
+			}
+
+			while(q<patternEnd && *q!=']')
+			{
+				if(q+2<patternEnd && q[1]=='-' && q[2]!=']')
+				{
+					if(*text>=q[0] && *text<=q[2])
+						seen = true;
+					q += 3;
+				}
+				else
+				{
+					if(*q==*text)
+						seen = true;
+					++q;
+				}
+			}
+
+			// Unterminated set
+			if(q==patternEnd)
+				return false;
+
+			if(seen==invert)
+				return false;
+
+			pattern = q+1;
+			++text;
+			continue;
+		}
+
+		if(c!='?' && c!=*text)
+			return false;
+		++text;
+	}
+
+	return text==textEnd;
+}
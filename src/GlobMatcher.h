@@ -0,0 +1,43 @@
+#ifndef GLOBMATCHER_H
+#define GLOBMATCHER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QSet>
+
+//////////////////////////////////////////////////////////////////////////
+// GlobMatcher
+// A list of fossil glob patterns compiled once, for matching workspace
+// relative paths. As in fossil, '*' and '?' also match '/', and '[...]'
+// matches a character class. Patterns without wildcards, and those with
+// a single leading or trailing '*', are matched without the glob engine.
+//////////////////////////////////////////////////////////////////////////
+class GlobMatcher
+{
+public:
+	GlobMatcher() {}
+	explicit GlobMatcher(const QStringList &patterns);
+
+	bool			isEmpty() const;
+	bool			matches(const QString &path) const;
+
+	// Also true if any of the parent directories of the path match
+	bool			matchesPath(const QString &path) const;
+
+	// True if every path below the directory is matched, as with "build/*"
+	bool			matchesAllBelow(const QString &dirPath) const;
+
+private:
+	static bool		matchGlob(const QChar *pattern, const QChar *patternEnd, const QChar *text, const QChar *textEnd);
+	static bool		matchGlob(const QString &pattern, const QString &text);
+	static bool		hasWildcards(const QString &pattern);
+
+	QSet<QString>	literals;
+	QStringList		prefixes;		// "prefix*"
+	QStringList		suffixes;		// "*suffix"
+	QStringList		globs;
+	QStringList		directoryGlobs;	// The head of the patterns ending in "/*"
+};
+
+#endif // GLOBMATCHER_H
@@ -0,0 +1,177 @@
+#include "LineScanner.h"
+#include <string.h>
+
+//------------------------------------------------------------------------------
+static inline bool IsBlank(char c)
+{
+	return c==' ' || c=='\t' || c=='\v' || c=='\f';
+}
+
+//------------------------------------------------------------------------------
+static void TrimSpan(const char *&begin, const char *&end)
+{
+	while(begin<end && IsBlank(*begin))
+		++begin;
+	while(end>begin && IsBlank(end[-1]))
+		--end;
+}
+
+//------------------------------------------------------------------------------
+// Case-insensitive search for a lowercase ASCII needle
+static bool ContainsNoCase(const char *begin, const char *end, const char *needle)
+{
+	int needle_len = static_cast<int>(strlen(needle));
+	for(const char *p=begin; end-p >= needle_len; ++p)
+	{
+		int i=0;
+		for(; i<needle_len; ++i)
+		{
+			char c = p[i];
+			if(c>='A' && c<='Z')
+				c += 'a'-'A';
+			if(c!=needle[i])
+				break;
+		}
+		if(i==needle_len)
+			return true;
+	}
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+LineScanner::LineScanner()
+	: skipNextLF(false)
+{
+	// Reserving marks the capacity as sticky, so clearing the tail
+	// does not release it
+	tail.reserve(256);
+}
+
+//------------------------------------------------------------------------------
+const char *LineScanner::findEOL(const char *p, const char *end, const char *&nextLF) const
+{
+	// The next LF is cached so that CR-only streams remain linear
+	if(nextLF < p)
+	{
+		nextLF = static_cast<const char *>(memchr(p, '\n', end-p));
+		if(!nextLF)
+			nextLF = end;
+	}
+
+	const char *cr = static_cast<const char *>(memchr(p, '\r', nextLF-p));
+	if(cr)
+		return cr;
+	return nextLF<end ? nextLF : 0;
+}
+
+//------------------------------------------------------------------------------
+const char *LineScanner::skipEOL(const char *eol, const char *end)
+{
+	if(*eol=='\r')
+	{
+		if(eol+1==end)
+			skipNextLF = true; // The LF may arrive with the next chunk
+		else if(eol[1]=='\n')
+			return eol+2;
+	}
+	return eol+1;
+}
+
+//------------------------------------------------------------------------------
+void LineScanner::emitLine(const char *p, const char *end, Visitor &visitor) const
+{
+	TrimSpan(p, end);
+	if(p<end)
+		visitor.onLine(p, static_cast<int>(end-p));
+}
+
+//------------------------------------------------------------------------------
+void LineScanner::feed(const char *data, int length, Visitor &visitor)
+{
+	const char *p = data;
+	const char *end = data + length;
+	const char *next_lf = p-1;
+
+	if(skipNextLF && p<end)
+	{
+		if(*p=='\n')
+			++p;
+		skipNextLF = false;
+	}
+
+	// Complete any line left over from the previous chunk
+	if(!tail.isEmpty())
+	{
+		const char *eol = findEOL(p, end, next_lf);
+		if(!eol)
+		{
+			tail.append(p, static_cast<int>(end-p));
+			return;
+		}
+
+		tail.append(p, static_cast<int>(eol-p));
+		emitLine(tail.constData(), tail.constData()+tail.size(), visitor);
+		tail.resize(0);
+		p = skipEOL(eol, end);
+	}
+
+	// Hand out lines directly from the incoming data
+	while(p<end)
+	{
+		const char *eol = findEOL(p, end, next_lf);
+		if(!eol)
+			break;
+
+		emitLine(p, eol, visitor);
+		p = skipEOL(eol, end);
+	}
+
+	// Keep the unterminated remainder
+	if(p<end)
+		tail.append(p, static_cast<int>(end-p));
+}
+
+//------------------------------------------------------------------------------
+void LineScanner::flush(Visitor &visitor)
+{
+	emitLine(tail.constData(), tail.constData()+tail.size(), visitor);
+	tail.resize(0);
+	skipNextLF = false;
+}
+
+//------------------------------------------------------------------------------
+QByteArray LineScanner::getTail() const
+{
+	const char *begin = tail.constData();
+	const char *end = begin + tail.size();
+	TrimSpan(begin, end);
+	return QByteArray(begin, static_cast<int>(end-begin));
+}
+
+//------------------------------------------------------------------------------
+void LineScanner::clearTail()
+{
+	tail.resize(0);
+}
+
+//------------------------------------------------------------------------------
+LineScanner::QueryType LineScanner::detectQuery() const
+{
+	const char *begin = tail.constData();
+	const char *end = begin + tail.size();
+	TrimSpan(begin, end);
+
+	// Fossil queries always end with a question mark
+	if(begin==end || end[-1]!='?')
+		return QUERY_NONE;
+
+	if(ContainsNoCase(begin, end, "a=all/c=convert/y/n"))
+		return QUERY_ACYN;
+	if(ContainsNoCase(begin, end, "a=always/y/n") || ContainsNoCase(begin, end, "yes/no/all") || ContainsNoCase(begin, end, "a=all/y/n"))
+		return QUERY_YNA;
+	if(ContainsNoCase(begin, end, "y/n"))
+		return QUERY_YN;
+	if(ContainsNoCase(begin, end, "a=always/n"))
+		return QUERY_AN;
+	return QUERY_NONE;
+}
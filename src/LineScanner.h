@@ -0,0 +1,50 @@
+#ifndef LINESCANNER_H
+#define LINESCANNER_H
+
+#include <QByteArray>
+
+//////////////////////////////////////////////////////////////////////////
+// LineScanner
+// Splits a byte stream into trimmed lines. Complete lines are handed to a
+// visitor as spans pointing into the incoming data, so only an unterminated
+// tail is ever copied. CR, LF and CRLF all terminate a line.
+//////////////////////////////////////////////////////////////////////////
+class LineScanner
+{
+public:
+	class Visitor
+	{
+	public:
+		virtual ~Visitor() {}
+		virtual void onLine(const char *line, int length)=0;
+	};
+
+	enum QueryType
+	{
+		QUERY_NONE,
+		QUERY_YN,		// y/n
+		QUERY_YNA,		// a=always/y/n, yes/no/all, a=all/y/n
+		QUERY_AN,		// a=always/n
+		QUERY_ACYN		// a=all/c=convert/y/n
+	};
+
+	LineScanner();
+
+	void		feed(const char *data, int length, Visitor &visitor);
+	void		flush(Visitor &visitor);
+
+	// The unterminated tail, which is where fossil leaves its prompts
+	QByteArray	getTail() const;
+	void		clearTail();
+	QueryType	detectQuery() const;
+
+private:
+	const char	*findEOL(const char *p, const char *end, const char *&nextLF) const;
+	const char	*skipEOL(const char *eol, const char *end);
+	void		emitLine(const char *p, const char *end, Visitor &visitor) const;
+
+	QByteArray	tail;
+	bool		skipNextLF;
+};
+
+#endif // LINESCANNER_H
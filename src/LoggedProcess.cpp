@@ -1,4 +1,7 @@
 #include "LoggedProcess.h"
+#ifndef Q_OS_WIN
+#include <unistd.h>
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
 LoggedProcess::LoggedProcess(QObject *parent) : QProcess(parent)
@@ -20,3 +23,11 @@ void LoggedProcess::onReadyReadStandardOutput()
 	log.append(readAllStandardOutput());
 }
 
+#ifndef Q_OS_WIN
+// Runs in the child before exec. Leading a process group of its own lets
+// the child be stopped along with anything it spawned
+void LoggedProcess::setupChildProcess()
+{
+	::setsid();
+}
+#endif
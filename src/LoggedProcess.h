@@ -13,6 +13,11 @@ public:
 	bool isLogEmpty() const { return log.isEmpty(); }
 	qint64 logBytesAvailable() const { return log.size(); }
 
+protected:
+#ifndef Q_OS_WIN
+	void setupChildProcess();
+#endif
+
 private slots:
 	void onReadyReadStandardOutput();
 
@@ -13,6 +13,9 @@
 #include <QLabel>
 #include <QSettings>
 #include <QShortcut>
+#include <QStandardPaths>
+#include <QTimer>
+#include <algorithm>
 #include "SettingsDialog.h"
 #include "FslSettingsDialog.h"
 #include "SearchBox.h"
@@ -22,84 +25,55 @@
 #include "RevisionDialog.h"
 #include "RemoteDialog.h"
 #include "AboutDialog.h"
+#include "QuickOpenDialog.h"
 #include "Utils.h"
 
 //-----------------------------------------------------------------------------
-enum
-{
-	COLUMN_STATUS,
-	COLUMN_FILENAME,
-	COLUMN_EXTENSION,
-	COLUMN_MODIFIED,
-	COLUMN_PATH
-};
-
 enum
 {
 	TAB_LOG,
 	TAB_BROWSER
 };
 
-enum
+//////////////////////////////////////////////////////////////////////////
+// InputBlocker
+// Drops the user input to the window while it waits on fossil, except for
+// what it takes to abort
+//////////////////////////////////////////////////////////////////////////
+class InputBlocker : public QObject
 {
-	ROLE_WORKSPACE_ITEM = Qt::UserRole+1
-};
-
-struct WorkspaceItem
-{
-	enum
-	{
-		TYPE_UNKNOWN,
-		TYPE_WORKSPACE,
-		TYPE_FOLDER,
-		TYPE_STASHES,
-		TYPE_STASH,
-		TYPE_BRANCHES,
-		TYPE_BRANCH,
-		TYPE_TAGS,
-		TYPE_TAG,
-		TYPE_REMOTES,
-		TYPE_REMOTE,
-	};
-
-	enum
-	{
-		STATE_DEFAULT,
-		STATE_UNCHANGED,
-		STATE_MODIFIED,
-		STATE_UNKNOWN
-	};
-
-
-	WorkspaceItem()
-	: Type(TYPE_UNKNOWN)
-	, State(STATE_DEFAULT)
-	{
-	}
-
-	WorkspaceItem(int type, const QString &value, int state=STATE_DEFAULT)
-	: Type(type), State(state), Value(value)
+public:
+	InputBlocker(QAction *abortAction, QWidget *abortButton, QObject *parent)
+		: QObject(parent)
+		, abortAction(abortAction)
+		, abortButton(abortButton)
 	{
 	}
 
-	WorkspaceItem(const WorkspaceItem &other)
+	bool eventFilter(QObject *watched, QEvent *event)
 	{
-		Type = other.Type;
-		State = other.State;
-		Value = other.Value;
+		switch(event->type())
+		{
+		case QEvent::Shortcut:
+			return watched!=abortAction;
+		case QEvent::MouseButtonPress:
+		case QEvent::MouseButtonRelease:
+		case QEvent::MouseButtonDblClick:
+		case QEvent::KeyPress:
+		case QEvent::KeyRelease:
+		case QEvent::Wheel:
+		case QEvent::ContextMenu:
+			// The window forwards the input to its widgets
+			return watched->isWidgetType() && watched!=abortButton;
+		default:
+			return false;
+		}
 	}
 
-	int Type;
-	int State;
-	QString Value;
-
-
-	operator QVariant() const
-	{
-		return QVariant::fromValue(*this);
-	}
+private:
+	QAction	*abortAction;
+	QWidget	*abortButton;
 };
-Q_DECLARE_METATYPE(WorkspaceItem)
 
 ///////////////////////////////////////////////////////////////////////////////
 MainWindow::MainWindow(Settings &_settings, QWidget *parent, QString *workspacePath) :
@@ -136,11 +110,6 @@ MainWindow::MainWindow(Settings &_settings, QWidget *parent, QString *workspaceP
 		SLOT( onFileViewDragOut() ),
 		Qt::DirectConnection );
 
-	QStringList header;
-	header << tr("Status") << tr("File") << tr("Extension") << tr("Modified") << tr("Path");
-	getWorkspace().getFileModel().setHorizontalHeaderLabels(header);
-	getWorkspace().getFileModel().horizontalHeaderItem(COLUMN_STATUS)->setTextAlignment(Qt::AlignCenter);
-
 	// Needed on OSX as the preset value from the GUI editor is not always reflected
 	ui->fileTableView->horizontalHeader()->setDefaultAlignment(Qt::AlignLeft);
 #if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
@@ -150,13 +119,18 @@ MainWindow::MainWindow(Settings &_settings, QWidget *parent, QString *workspaceP
 #endif
 	ui->fileTableView->horizontalHeader()->setStretchLastSection(true);
 
+	// All rows have the same height, so the view never measures them
+	int row_height = qMax(ui->fileTableView->fontMetrics().height(), style()->pixelMetric(QStyle::PM_SmallIconSize)) + 4;
+	ui->fileTableView->verticalHeader()->setDefaultSectionSize(row_height);
+#if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
+	ui->fileTableView->verticalHeader()->setResizeMode(QHeaderView::Fixed);
+#else
+	ui->fileTableView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+#endif
+
 	// workspaceTreeView
 	ui->workspaceTreeView->setModel(&getWorkspace().getTreeModel());
 
-	header.clear();
-	header << tr("Workspace");
-	getWorkspace().getTreeModel().setHorizontalHeaderLabels(header);
-
 	connect( ui->workspaceTreeView->selectionModel(),
 		SIGNAL( selectionChanged(const QItemSelection &, const QItemSelection &) ),
 		SLOT( onWorkspaceTreeViewSelectionChanged(const QItemSelection &, const QItemSelection &) ),
@@ -265,6 +239,7 @@ MainWindow::MainWindow(Settings &_settings, QWidget *parent, QString *workspaceP
 	abortButton->setDefaultAction(ui->actionAbortOperation);
 	ui->statusBar->insertPermanentWidget(2, abortButton);
 	ui->actionAbortOperation->setEnabled(false);
+	inputBlocker = new InputBlocker(ui->actionAbortOperation, abortButton, this);
 
 #ifdef Q_OS_MACX
 	// Native applications on OSX don't have menu icons
@@ -311,6 +286,12 @@ MainWindow::MainWindow(Settings &_settings, QWidget *parent, QString *workspaceP
 		SLOT( onSearchBoxTextChanged(const QString&)),
 		Qt::DirectConnection );
 
+	// Filter once typing pauses rather than on every keystroke
+	searchTimer = new QTimer(this);
+	searchTimer->setSingleShot(true);
+	searchTimer->setInterval(SEARCH_DELAY_MS);
+	connect(searchTimer, SIGNAL(timeout()), this, SLOT(onSearchTimeout()));
+
 	// Add another spacer to the right
 	spacer = new QWidget();
 	spacer->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Expanding);
@@ -321,9 +302,35 @@ MainWindow::MainWindow(Settings &_settings, QWidget *parent, QString *workspaceP
 
 	uiCallback.init(this);
 
+	operations = new OperationQueue(this);
+	refreshOperation = 0;
+	activeJobOperation = 0;
+	ui->operationPanel->setQueue(operations);
+	connect(operations, SIGNAL(preempted(int)), this, SLOT(onOperationPreempted(int)));
+
+	// Keeps the views current between refreshes
+	workspaceWatcher = new WorkspaceWatcher(this);
+	connect(workspaceWatcher, SIGNAL(statusReady()), this, SLOT(onWatchedChanges()));
+	connect(workspaceWatcher, SIGNAL(rescanNeeded()), this, SLOT(onRescanNeeded()));
+
+	// Spare the probe of a fossil executable already seen
+	FossilCapabilities::load(*settings.GetStore());
+
 	// Need to be before applySettings which sets the last workspace
 	getWorkspace().Init(&uiCallback, settings.GetValue(FUEL_SETTING_FOSSIL_PATH).toString());
 
+	// Portable installs keep the snapshots next to their settings
+	{
+		QSettings *store = settings.GetStore();
+		QString snapshot_dir;
+		if(store->format()==QSettings::IniFormat)
+			snapshot_dir = QFileInfo(store->fileName()).absolutePath();
+		else
+			snapshot_dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+		if(!snapshot_dir.isEmpty())
+			getWorkspace().setSnapshotDir(snapshot_dir + PATH_SEPARATOR "snapshots");
+	}
+
 	applySettings();
 
 	// Apply any explicit workspace path if available
@@ -374,7 +381,28 @@ void MainWindow::addWorkspaceHistory(const QString &dir)
 //------------------------------------------------------------------------------
 void MainWindow::on_actionRefresh_triggered()
 {
+	scheduleRefresh();
+}
+
+//------------------------------------------------------------------------------
+// Requests made before the refresh starts are served by it
+void MainWindow::scheduleRefresh()
+{
+	operations->enqueue(tr("Refresh"), OperationQueue::ACCESS_READ, this, "onRefreshOperation", "refresh");
+}
+
+//------------------------------------------------------------------------------
+void MainWindow::onRefreshOperation(int id)
+{
+	refreshOperation = id;
 	refresh();
+
+	// Otherwise finished along with the scan
+	if(!getWorkspace().isScanning())
+	{
+		refreshOperation = 0;
+		operations->finish(id);
+	}
 }
 
 //------------------------------------------------------------------------------
@@ -527,7 +555,7 @@ void MainWindow::on_actionNewRepository_triggered()
 	if(!ui->actionViewUnknown->isChecked())
 		ui->actionViewUnknown->setChecked(true);
 
-	refresh();
+	scheduleRefresh();
 }
 
 //------------------------------------------------------------------------------
@@ -549,7 +577,7 @@ void MainWindow::on_actionCloseRepository_triggered()
 											"Perhaps there are uncommitted changes available\n"
 											"Would you like to force closing this workspace?")))
 		{
-			refresh();
+			scheduleRefresh();
 			return;
 		}
 
@@ -559,13 +587,13 @@ void MainWindow::on_actionCloseRepository_triggered()
 	if(!success)
 	{
 		QMessageBox::critical(this, tr("Error"), tr("Could not close the workspace."), QMessageBox::Ok);
-		refresh();
+		scheduleRefresh();
 		return;
 	}
 
 	stopUI();
 	setCurrentWorkspace("");
-	refresh();
+	scheduleRefresh();
 }
 
 //------------------------------------------------------------------------------
@@ -579,12 +607,31 @@ void MainWindow::on_actionCloneRepository_triggered()
 
 	stopUI();
 
-	if(!getWorkspace().cloneRepository(repository, url, url_proxy))
+	FossilJob *job = getWorkspace().cloneRepository(repository, url, url_proxy, this);
+	if(!runJob(job, SLOT(onCloneFinished(FossilJob*))))
 	{
 		QMessageBox::critical(this, tr("Error"), tr("Could not clone the repository"), QMessageBox::Ok);
 		return;
 	}
 
+	// Keep the clone details until the job completes
+	job->setProperty("url", url);
+	job->setProperty("repository", repository);
+}
+
+//------------------------------------------------------------------------------
+void MainWindow::onCloneFinished(FossilJob *job)
+{
+	if(!job->succeeded())
+	{
+		if(!job->isAborted())
+			QMessageBox::critical(this, tr("Error"), tr("Could not clone the repository"), QMessageBox::Ok);
+		return;
+	}
+
+	QUrl url = job->property("url").toUrl();
+	QString repository = job->property("repository").toString();
+
 	if(!openWorkspace(repository))
 		return;
 
@@ -688,9 +735,11 @@ bool MainWindow::refresh()
 {
 	QString title = "Fuel";
 
+	// The state tells the repository, against which the cached settings are checked
+	WorkspaceState st = getWorkspace().getState();
 	loadFossilSettings();
 
-	bool valid = scanWorkspace();
+	bool valid = scanWorkspace(st);
 	if(valid)
 	{
 		const QString &project_name = getWorkspace().getProjectName();
@@ -704,13 +753,11 @@ bool MainWindow::refresh()
 }
 
 //------------------------------------------------------------------------------
-bool MainWindow::scanWorkspace()
+// Starts a scan on a worker thread. The views fill in as it progresses
+bool MainWindow::scanWorkspace(WorkspaceState st)
 {
-	setBusy(true);
 	bool valid = true;
-
-	// Load repository info
-	WorkspaceState st = getWorkspace().getState();
+	ScanWorker *worker = 0;
 	QString status;
 
 	if(st==WORKSPACE_STATE_NOTFOUND)
@@ -752,19 +799,25 @@ bool MainWindow::scanWorkspace()
 			TrimStringList(ignore_patterns);
 		}
 
-		getWorkspace().scanWorkspace(ui->actionViewUnknown->isChecked(),
-								ui->actionViewIgnored->isChecked(),
-								ui->actionViewModified->isChecked(),
-								ui->actionViewUnchanged->isChecked(),
-								ignore_patterns,
-								uiCallback
-								);
-
-		// Build default versions list
-		versionList += getWorkspace().getBranches();
-		versionList += getWorkspace().getTags().keys();
+		applyViewFilter();
+
+		// Supersedes any scan still running
+		worker = getWorkspace().beginScan(ignore_patterns, this);
+		if(worker)
+		{
+			connect(worker, SIGNAL(batchReady()), this, SLOT(onScanBatch()));
+			connect(worker, SIGNAL(progress(QString)), this, SLOT(onScanProgress(QString)));
+			connect(worker, SIGNAL(logged(QString,bool)), this, SLOT(onScanLogged(QString,bool)));
+			connect(worker, SIGNAL(finished()), this, SLOT(onScanFinished()));
+		}
+
+		const Fossil &bridge = getWorkspace().fossil();
+		workspaceWatcher->start(getWorkspace().getPath(), bridge.getRepositoryFile(), bridge.getExePath(), bridge.getVerifyChanges(), ignore_patterns);
+
 		lblTags->setText(" " + getWorkspace().getActiveTags().join(" ") + " ");
 	}
+	else
+		workspaceWatcher->stop();
 
 	updateWorkspaceView();
 	updateFileView();
@@ -772,318 +825,167 @@ bool MainWindow::scanWorkspace()
 	setStatus(status);
 	lblTags->setVisible(valid);
 
-	setBusy(false);
+	if(worker)
+	{
+		uiCallback.beginProgress(QObject::tr("Updating..."));
+		worker->start();
+	}
+
 	return valid;
 }
 
 //------------------------------------------------------------------------------
-static void addPathToTree(QStandardItem &root, const QString &path, const QIcon &iconDefault, const QIcon &iconUnchanged, const QIcon &iconModified, const QIcon &iconUnknown, const pathstate_map_t &pathState)
+void MainWindow::onScanBatch()
 {
-	QStringList dirs = path.split(PATH_SEPARATOR);
-	QStandardItem *parent = &root;
-
-	QString fullpath;
-	for(QStringList::iterator it = dirs.begin(); it!=dirs.end(); ++it)
-	{
-		const QString &dir = *it;
-		fullpath += dir;
-
-		// Find the child that matches this subdirectory
-		bool found = false;
-		for(int r=0; r<parent->rowCount(); ++r)
-		{
-			QStandardItem *child = parent->child(r, 0);
-			Q_ASSERT(child);
-			if(child->text() == dir)
-			{
-				parent = child;
-				found = true;
-			}
-		}
-
-		if(!found) // Generate it
-		{
-			int state = WorkspaceItem::STATE_DEFAULT;
-
-			pathstate_map_t::const_iterator state_it = pathState.find(fullpath);
-			if(state_it != pathState.end())
-			{
-				WorkspaceFile::Type type = state_it.value();
-
-				if(type & (WorkspaceFile::TYPE_MODIFIED))
-					state = WorkspaceItem::STATE_MODIFIED;
-				else if(type == WorkspaceFile::TYPE_UNKNOWN)
-					state = WorkspaceItem::STATE_UNKNOWN;
-				else
-					state = WorkspaceItem::STATE_UNCHANGED;
-			}
-
-			QStandardItem *child = new QStandardItem(dir);
-			child->setData(WorkspaceItem(WorkspaceItem::TYPE_FOLDER, fullpath, state), ROLE_WORKSPACE_ITEM);
-
-			QString tooltip = fullpath;
-
-			if(state == WorkspaceItem::STATE_UNCHANGED)
-			{
-				child->setIcon(iconUnchanged);
-				tooltip += " " + QObject::tr("Unchanged");
-			}
-			else if(state == WorkspaceItem::STATE_MODIFIED)
-			{
-				child->setIcon(iconModified);
-				tooltip += " " + QObject::tr("Modified");
-			}
-			else if(state == WorkspaceItem::STATE_UNKNOWN)
-			{
-				child->setIcon(iconUnknown);
-				tooltip += " " + QObject::tr("Unknown");
-			}
-			else
-				child->setIcon(iconDefault);
+	if(!getWorkspace().applyScanBatch(qobject_cast<ScanWorker *>(sender())))
+		return;
 
-			child->setToolTip(tooltip);
+	updateWorkspaceView();
+	updateFileView();
+}
 
-			parent->appendRow(child);
-			parent = child;
-		}
+//------------------------------------------------------------------------------
+void MainWindow::onScanProgress(const QString &text)
+{
+	ui->statusBar->showMessage(text);
+}
 
-		fullpath += PATH_SEPARATOR;
-	}
+//------------------------------------------------------------------------------
+void MainWindow::onScanLogged(const QString &text, bool isHTML)
+{
+	log(text, isHTML);
 }
 
 //------------------------------------------------------------------------------
-void MainWindow::updateWorkspaceView()
+void MainWindow::onScanFinished()
 {
-	// Record expanded tree-node names, and selection
-	name_modelindex_map_t name_map;
-	BuildNameToModelIndex(name_map, getWorkspace().getTreeModel());
-	stringset_t expanded_items;
-	stringset_t selected_items;
+	ScanWorker *worker = qobject_cast<ScanWorker *>(sender());
+	bool current = getWorkspace().finishScan(worker, uiCallback);
+	if(worker)
+		worker->deleteLater();
+
+	// A newer scan is running
+	if(!current)
+		return;
 
-	const QItemSelection selection = ui->workspaceTreeView->selectionModel()->selection();
+	updateVersionList();
+	updateWorkspaceView();
+	updateFileView();
+	uiCallback.endProgress();
 
-	for(name_modelindex_map_t::const_iterator it=name_map.begin(); it!=name_map.end(); ++it)
+	if(refreshOperation)
 	{
-		const QModelIndex mi = it.value();
-		if(ui->workspaceTreeView->isExpanded(mi))
-			expanded_items.insert(it.key());
-
-		if(selection.contains(mi))
-			selected_items.insert(it.key());
+		operations->finish(refreshOperation);
+		refreshOperation = 0;
 	}
+}
 
-	// Clear content except headers
-	getWorkspace().getTreeModel().removeRows(0, getWorkspace().getTreeModel().rowCount());
-
-	QStandardItem *workspace = new QStandardItem(getCachedIcon(":icons/icon-item-folder"), tr("Files") );
-	workspace->setData(WorkspaceItem(WorkspaceItem::TYPE_WORKSPACE, ""), ROLE_WORKSPACE_ITEM);
-	workspace->setEditable(false);
+//------------------------------------------------------------------------------
+// Build default versions list
+void MainWindow::updateVersionList()
+{
+	versionList.clear();
+	versionList += getWorkspace().getBranches();
+	versionList += getWorkspace().getTags().keys();
+}
 
-	getWorkspace().getTreeModel().appendRow(workspace);
-	if(viewMode == VIEWMODE_TREE)
+//------------------------------------------------------------------------------
+// After an operation that only touched the listed files and metadata
+// categories. Falls back to a full refresh when that is not enough
+bool MainWindow::refreshFiles(const QStringList &paths, int categories, bool checkoutChanged)
+{
+	if(!getWorkspace().refreshFiles(paths, categories, checkoutChanged))
 	{
-		// FIXME: Change paths to map to allow for automatic sorting
-		QStringList paths = getWorkspace().getPaths().toList();
-		paths.sort();
-
-		foreach(const QString &dir, paths)
-		{
-			if(dir.isEmpty())
-				continue;
-
-			addPathToTree(*workspace, dir,
-						  getCachedIcon(":icons/icon-item-folder"),
-						  getCachedIcon(":icons/icon-item-folder-unchanged"),
-						  getCachedIcon(":icons/icon-item-folder-modified"),
-						  getCachedIcon(":icons/icon-item-folder-unknown"),
-						  getWorkspace().getPathState());
-		}
-
-		// Expand root folder
-		ui->workspaceTreeView->setExpanded(workspace->index(), true);
+		scheduleRefresh();
+		return true;
 	}
 
-	// Branches
-	QStandardItem *branches = new QStandardItem(getCachedIcon(":icons/icon-item-branch"), tr("Branches"));
-	branches->setData(WorkspaceItem(WorkspaceItem::TYPE_BRANCHES, ""), ROLE_WORKSPACE_ITEM);
-	branches->setEditable(false);
-	getWorkspace().getTreeModel().appendRow(branches);
-	foreach(const QString &branch_name, getWorkspace().getBranches())
-	{
-		QStandardItem *branch = new QStandardItem(getCachedIcon(":icons/icon-item-branch"), branch_name);
-		branch->setData(WorkspaceItem(WorkspaceItem::TYPE_BRANCH, branch_name), ROLE_WORKSPACE_ITEM);
-
-		bool active = getWorkspace().getActiveTags().contains(branch_name);
-		if(active)
-		{
-			QFont font = branch->font();
-			font.setBold(true);
-			branch->setFont(font);
-		}
-		branches->appendRow(branch);
-	}
+	if(checkoutChanged)
+		lblTags->setText(" " + getWorkspace().getActiveTags().join(" ") + " ");
 
-	// Tags
-	QStandardItem *tags = new QStandardItem(getCachedIcon(":icons/icon-item-tag"), tr("Tags"));
-	tags->setData(WorkspaceItem(WorkspaceItem::TYPE_TAGS, ""), ROLE_WORKSPACE_ITEM);
-	tags->setEditable(false);
-	getWorkspace().getTreeModel().appendRow(tags);
-	for(QStringMap::const_iterator it=getWorkspace().getTags().begin(); it!=getWorkspace().getTags().end(); ++it)
-	{
-		const QString &tag_name = it.key();
+	if(categories & (MetadataCache::CATEGORY_BRANCHES|MetadataCache::CATEGORY_TAGS))
+		updateVersionList();
 
-		QStandardItem *tag = new QStandardItem(getCachedIcon(":icons/icon-item-tag"), tag_name);
-		tag->setData(WorkspaceItem(WorkspaceItem::TYPE_TAG, tag_name), ROLE_WORKSPACE_ITEM);
+	updateWorkspaceView();
+	updateFileView();
+	return true;
+}
 
-		bool active = getWorkspace().getActiveTags().contains(tag_name);
-		if(active)
-		{
-			QFont font = tag->font();
-			font.setBold(true);
-			tag->setFont(font);
-		}
-		tags->appendRow(tag);
-	}
+//------------------------------------------------------------------------------
+void MainWindow::onWatchedChanges()
+{
+	operations->enqueue(tr("Apply changes"), OperationQueue::ACCESS_READ, this, "onWatchedOperation", "watch");
+}
 
-	// Stashes
-	QStandardItem *stashes = new QStandardItem(getCachedIcon(":icons/icon-action-repo-open"), tr("Stashes"));
-	stashes->setData(WorkspaceItem(WorkspaceItem::TYPE_STASHES, ""), ROLE_WORKSPACE_ITEM);
-	stashes->setEditable(false);
-	getWorkspace().getTreeModel().appendRow(stashes);
-	for(stashmap_t::const_iterator it= getWorkspace().getStashes().begin(); it!=getWorkspace().getStashes().end(); ++it)
+//------------------------------------------------------------------------------
+void MainWindow::onWatchedOperation(int id)
+{
+	if(getWorkspace().applyWatchedChanges(*workspaceWatcher))
 	{
-		QStandardItem *stash = new QStandardItem(getCachedIcon(":icons/icon-action-repo-open"), it.key());
-		stash->setData(WorkspaceItem(WorkspaceItem::TYPE_STASH, it.value()), ROLE_WORKSPACE_ITEM);
-		stashes->appendRow(stash);
+		updateWorkspaceView();
+		updateFileView();
 	}
+	operations->finish(id);
+}
 
-	// Remotes
-	QStandardItem *remotes = new QStandardItem(getCachedIcon(":icons/icon-item-remote"), tr("Remotes"));
-	remotes->setData(WorkspaceItem(WorkspaceItem::TYPE_REMOTES, ""), ROLE_WORKSPACE_ITEM);
-	remotes->setEditable(false);
-	getWorkspace().getTreeModel().appendRow(remotes);
-	for(remote_map_t::const_iterator it=getWorkspace().getRemotes().begin(); it!=getWorkspace().getRemotes().end(); ++it)
-	{
-		QStandardItem *remote_item = new QStandardItem(getCachedIcon(":icons/icon-item-remote"), it->name);
-		remote_item->setData(WorkspaceItem(WorkspaceItem::TYPE_REMOTE, it->url.toString()), ROLE_WORKSPACE_ITEM);
+//------------------------------------------------------------------------------
+// An interactive operation needs what the background work is using
+void MainWindow::onOperationPreempted(int id)
+{
+	if(id!=refreshOperation)
+		return;
 
-		remote_item->setToolTip(UrlToStringDisplay(it->url));
+	// The files are scanned again once the interactive operation is done
+	getWorkspace().abortScan();
+	scheduleRefresh();
+}
 
-		// Mark the default url as bold
-		if(it->isDefault)
-		{
-			QFont font = remote_item->font();
-			font.setBold(true);
-			remote_item->setFont(font);
-		}
-		remotes->appendRow(remote_item);
-	}
+//------------------------------------------------------------------------------
+void MainWindow::onRescanNeeded()
+{
+	scheduleRefresh();
+}
 
-	// Expand previously selected nodes
-	name_map.clear();
-	BuildNameToModelIndex(name_map, getWorkspace().getTreeModel());
+//------------------------------------------------------------------------------
+void MainWindow::updateWorkspaceView()
+{
+	// The model keeps the nodes that still exist, along with their expansion and selection
+	getWorkspace().getTreeModel().update(getWorkspace(), viewMode==VIEWMODE_TREE);
 
-	for(stringset_t::const_iterator it=expanded_items.begin(); it!=expanded_items.end(); ++it)
-	{
-		name_modelindex_map_t::const_iterator mi_it = name_map.find(*it);
-		if(mi_it!=name_map.end())
-			ui->workspaceTreeView->setExpanded(mi_it.value(), true);
-	}
+	// Rebuilt from the new tree on the next quick open
+	quickOpenMatcher.clear();
 
-	// Select previous selected item
-	for(stringset_t::const_iterator it=selected_items.begin(); it!=selected_items.end(); ++it)
-	{
-		name_modelindex_map_t::const_iterator mi_it = name_map.find(*it);
-		if(mi_it!=name_map.end())
-		{
-			const QModelIndex &mi = mi_it.value();
-			ui->workspaceTreeView->selectionModel()->select(mi, QItemSelectionModel::Select);
-		}
-	}
+	// Expand root folder
+	if(viewMode == VIEWMODE_TREE)
+		ui->workspaceTreeView->setExpanded(getWorkspace().getTreeModel().index(0, 0), true);
 }
 
 //------------------------------------------------------------------------------
 void MainWindow::updateFileView()
 {
-	// Clear content except headers
-	getWorkspace().getFileModel().removeRows(0, getWorkspace().getFileModel().rowCount());
-
-	struct { WorkspaceFile::Type type; QString text; const char *icon; }
-	stats[] =
-	{
-		{   WorkspaceFile::TYPE_EDITTED, tr("Edited"), ":icons/icon-item-edited" },
-		{   WorkspaceFile::TYPE_UNCHANGED, tr("Unchanged"), ":icons/icon-item-unchanged" },
-		{   WorkspaceFile::TYPE_ADDED, tr("Added"), ":icons/icon-item-added" },
-		{   WorkspaceFile::TYPE_DELETED, tr("Deleted"), ":icons/icon-item-deleted" },
-		{   WorkspaceFile::TYPE_RENAMED, tr("Renamed"), ":icons/icon-item-renamed" },
-		{   WorkspaceFile::TYPE_MISSING, tr("Missing"), ":icons/icon-item-missing" },
-		{   WorkspaceFile::TYPE_CONFLICTED, tr("Conflicted"), ":icons/icon-item-conflicted" },
-		{   WorkspaceFile::TYPE_MERGED, tr("Merged"), ":icons/icon-item-edited" },
-	};
-
 	bool display_path = viewMode==VIEWMODE_LIST || selectedDirs.count() > 1;
 
-	const QString &status_unknown = QString(tr("Unknown"));
-	const QString &search_text = searchBox->text();
-
-	size_t item_id=0;
-	for(filemap_t::iterator it = getWorkspace().getFiles().begin(); it!=getWorkspace().getFiles().end(); ++it)
+	// In Tree mode only the files of the selected dirs are shown
+	const DirTree &tree = getWorkspace().getDirTree();
+	QVector<int> rows;
+	if(viewMode==VIEWMODE_TREE)
 	{
-		const WorkspaceFile &e = *it.value();
-		const QString &path = e.getPath();
-		const QString &file_path = e.getFilePath();
-		QString native_file_path = QDir::toNativeSeparators(file_path);
-
-		// Apply filter if available
-		if(!search_text.isEmpty() && !native_file_path.contains(search_text, Qt::CaseInsensitive))
-			continue;
-
-		// In Tree mode, filter all items not included in the current dir
-		if(viewMode==VIEWMODE_TREE && !selectedDirs.contains(path))
-			continue;
-
-		// Status Column
-		const QString *status_text = &status_unknown;
-		const char *status_icon_path= ":icons/icon-item-unknown"; // Default icon
-
-		for(size_t t=0; t<COUNTOF(stats); ++t)
+		foreach(const QString &dir, selectedDirs)
 		{
-			if(e.getType() == stats[t].type)
-			{
-				status_text = &stats[t].text;
-				status_icon_path = stats[t].icon;
-				break;
-			}
-		}
-
-		QStandardItem *status = new QStandardItem(getCachedIcon(status_icon_path), *status_text);
-		status->setToolTip(*status_text);
-		getWorkspace().getFileModel().setItem(item_id, COLUMN_STATUS, status);
-
-		QFileInfo finfo = e.getFileInfo();
-
-		const QIcon *icon = &getCachedFileIcon(finfo);
-
-		QStandardItem *filename_item = 0;
-		getWorkspace().getFileModel().setItem(item_id, COLUMN_PATH, new QStandardItem(path));
-
-		if(display_path)
-			filename_item = new QStandardItem(*icon, native_file_path);
-		else
-			filename_item = new QStandardItem(*icon, e.getFilename());
-
-		Q_ASSERT(filename_item);
-		// Keep the path in the user data
-		filename_item->setData(file_path);
-		getWorkspace().getFileModel().setItem(item_id, COLUMN_FILENAME, filename_item);
-
-		getWorkspace().getFileModel().setItem(item_id, COLUMN_EXTENSION, new QStandardItem(finfo.suffix()));
-		getWorkspace().getFileModel().setItem(item_id, COLUMN_MODIFIED, new QStandardItem(finfo.lastModified().toString(Qt::SystemLocaleShortDate)));
+			int dir_id = tree.findDir(dir);
+			if(dir_id<0)
+				continue;
 
-		++item_id;
+			const DirTree::Node &node = tree.getNode(dir_id);
+			for(int i=node.firstFile; i<node.lastFile; ++i)
+				rows.append(tree.getFileRows()[i]);
+		}
 	}
+	else
+		rows = tree.getFileRows();
 
-	ui->fileTableView->resizeRowsToContents();
+	// The model orders and filters the rows, and only formats the ones in view
+	getWorkspace().getFileModel().setRows(rows, display_path);
 }
 
 //------------------------------------------------------------------------------
@@ -1279,6 +1181,8 @@ void MainWindow::updateSettings()
 		++active_actions;
 	}
 	store->endArray();
+
+	FossilCapabilities::save(*store);
 }
 
 //------------------------------------------------------------------------------
@@ -1340,12 +1244,12 @@ void MainWindow::getSelectionPaths(stringset_t &paths)
 // Select all workspace files that match the includeMask
 void MainWindow::getAllFilenames(QStringList &filenames, int includeMask)
 {
-	for(filemap_t::iterator it=getWorkspace().getFiles().begin(); it!=getWorkspace().getFiles().end(); ++it)
+	for(FileTable::const_iterator it=getWorkspace().getFiles().begin(); it!=getWorkspace().getFiles().end(); ++it)
 	{
-		const WorkspaceFile &e = *(*it);
+		const WorkspaceFile &e = *it;
 
 		// Skip unwanted file types
-		if(!(includeMask & e.getType()))
+		if(!(includeMask & e.getType()) || !getWorkspace().isVisible(e))
 			continue;
 
 		filenames.append(e.getFilePath());
@@ -1363,72 +1267,67 @@ void MainWindow::getDirViewSelection(QStringList &filenames, int includeMask, bo
 		getSelectionPaths(paths);
 	}
 
-	// Select the actual files form the selected directories
-	for(filemap_t::iterator it=getWorkspace().getFiles().begin(); it!=getWorkspace().getFiles().end(); ++it)
-	{
-		const WorkspaceFile &e = *(*it);
-
-		// Skip unwanted file types
-		if(!(includeMask & e.getType()))
-			continue;
-
-		bool include = true;
+	// Without a folder selected, the root folder includes all files
+	if(paths.empty())
+		paths.insert("");
 
-		// If we have a limited set of paths to filter, check them
-		if(!paths.empty())
-			include = false;
+	// The files below each folder are one range of the tree's rows
+	const DirTree &tree = getWorkspace().getDirTree();
+	const FileTable &files = getWorkspace().getFiles();
+	DirTree::rangelist_t ranges;
+	tree.getTreeRanges(paths.toList(), ranges);
 
-		for(stringset_t::iterator p_it=paths.begin(); p_it!=paths.end(); ++p_it)
+	for(int r=0; r<ranges.size(); ++r)
+	{
+		for(int i=ranges[r].first; i<ranges[r].second; ++i)
 		{
-			const QString &path = *p_it;
-			// An empty path is the root folder, so it includes all files
-			// If the file's path starts with this, we include id
-			if(path.isEmpty() || e.getPath().indexOf(path)==0)
-			{
-				include = true;
-				break;
-			}
-		}
+			int row = tree.getFileRows()[i];
 
-		if(!include)
-			continue;
+			// Skip unwanted file types
+			if(!(includeMask & files.getType(row)))
+				continue;
 
-		filenames.append(e.getFilePath());
+			filenames.append(files.getFilePath(row));
+		}
 	}
-
 }
 
 //------------------------------------------------------------------------------
 void MainWindow::getFileViewSelection(QStringList &filenames, int includeMask, bool allIfEmpty)
 {
-	QModelIndexList selection = ui->fileTableView->selectionModel()->selectedIndexes();
-	if(selection.empty() && allIfEmpty)
+	const FileTableModel &model = getWorkspace().getFileModel();
+	const FileTable &files = getWorkspace().getFiles();
+
+	// Walk the selected row ranges rather than every selected cell
+	QVector<int> model_rows;
+	QItemSelection selection = ui->fileTableView->selectionModel()->selection();
+	foreach(const QItemSelectionRange &range, selection)
 	{
-		ui->fileTableView->selectAll();
-		selection = ui->fileTableView->selectionModel()->selectedIndexes();
-		ui->fileTableView->clearSelection();
+		if(range.left()>FileTableModel::COLUMN_FILENAME || range.right()<FileTableModel::COLUMN_FILENAME)
+			continue;
+		for(int r=range.top(); r<=range.bottom(); ++r)
+			model_rows.append(r);
 	}
 
-	for(QModelIndexList::iterator mi_it = selection.begin(); mi_it!=selection.end(); ++mi_it)
+	if(model_rows.empty() && allIfEmpty)
 	{
-		const QModelIndex &mi = *mi_it;
+		for(int r=0; r<model.rowCount(); ++r)
+			model_rows.append(r);
+	}
 
-		// FIXME: we are being called once per cell of each row
-		// but we only need column 1. There must be a better way
-		if(mi.column()!=COLUMN_FILENAME)
-			continue;
+	// Ranges may overlap, list each file once in view order
+	std::sort(model_rows.begin(), model_rows.end());
+	model_rows.erase(std::unique(model_rows.begin(), model_rows.end()), model_rows.end());
 
-		QVariant data = getWorkspace().getFileModel().data(mi, Qt::UserRole+1);
-		QString filename = data.toString();
-		filemap_t::iterator e_it = getWorkspace().getFiles().find(filename);
-		Q_ASSERT(e_it!=getWorkspace().getFiles().end());
-		const WorkspaceFile &e = *e_it.value();
+	foreach(int model_row, model_rows)
+	{
+		int row = model.getFileRow(model_row);
 
 		// Skip unwanted files
-		if(!(includeMask & e.getType()))
+		if(!(includeMask & files.getType(row)))
 			continue;
 
-		filenames.append(filename);
+		filenames.append(files.getFilePath(row));
 	}
 }
 //------------------------------------------------------------------------------
@@ -1484,6 +1383,7 @@ void MainWindow::on_actionDiff_triggered()
 	QStringList selection;
 	getSelectionFilenames(selection, WorkspaceFile::TYPE_REPO);
 
+	ScopedOperation operation(*operations, tr("Diff"), OperationQueue::ACCESS_READ);
 	for(QStringList::iterator it = selection.begin(); it!=selection.end(); ++it)
 		if(!diffFile(*it))
 			return;
@@ -1614,10 +1514,11 @@ void MainWindow::on_actionCommit_triggered()
 	if(commit_files.size() != all_modified_files.size())
 		files = commit_files;
 
+	ScopedOperation operation(*operations, tr("Commit"), OperationQueue::ACCESS_WRITE);
 	if(!getWorkspace().commitFiles(files, msg, branch_name, private_branch))
 		QMessageBox::critical(this, tr("Error"), tr("Could not commit changes."), QMessageBox::Ok);
 
-	refresh();
+	refreshFiles(files.isEmpty() ? all_modified_files : files, MetadataCache::CATEGORY_BRANCHES|MetadataCache::CATEGORY_TAGS, true);
 }
 
 //------------------------------------------------------------------------------
@@ -1634,10 +1535,11 @@ void MainWindow::on_actionAdd_triggered()
 		return;
 
 	// Do Add
+	ScopedOperation operation(*operations, tr("Add files"), OperationQueue::ACCESS_WRITE);
 	if(!getWorkspace().addFiles(selection))
 		QMessageBox::critical(this, tr("Error"), tr("Could not add files."), QMessageBox::Ok);
 
-	refresh();
+	refreshFiles(selection);
 }
 
 //------------------------------------------------------------------------------
@@ -1659,6 +1561,8 @@ void MainWindow::on_actionDelete_triggered()
 	if(!FileActionDialog::run(this, tr("Remove files"), tr("The following files will be removed from the repository.")+"\n"+tr("Are you sure?"), all_files, tr("Also delete the local files"), &remove_local ))
 		return;
 
+	ScopedOperation operation(*operations, tr("Remove files"), OperationQueue::ACCESS_WRITE);
+
 	// Remove repository files
 	if(!repo_files.empty())
 	{
@@ -1677,7 +1581,7 @@ void MainWindow::on_actionDelete_triggered()
 		}
 	}
 
-	refresh();
+	refreshFiles(all_files);
 }
 
 //------------------------------------------------------------------------------
@@ -1693,10 +1597,11 @@ void MainWindow::on_actionRevert_triggered()
 		return;
 
 	// Do Revert
+	ScopedOperation operation(*operations, tr("Revert files"), OperationQueue::ACCESS_WRITE);
 	if(!getWorkspace().revertFiles(modified_files))
 		QMessageBox::critical(this, tr("Error"), tr("Could not revert files."), QMessageBox::Ok);
 
-	refresh();
+	refreshFiles(modified_files);
 }
 
 //------------------------------------------------------------------------------
@@ -1724,10 +1629,11 @@ void MainWindow::on_actionRename_triggered()
 	}
 
 	// Do Rename
+	ScopedOperation operation(*operations, tr("Rename"), OperationQueue::ACCESS_WRITE);
 	if(!getWorkspace().renameFile(fi_before.filePath(), fi_after.filePath(), true))
 		QMessageBox::critical(this, tr("Error"), tr("Could not rename file '%0' to '%1'").arg(fi_before.filePath(), fi_after.filePath()), QMessageBox::Ok);
 
-	refresh();
+	refreshFiles(QStringList() << fi_before.filePath() << fi_after.filePath());
 }
 
 //------------------------------------------------------------------------------
@@ -1767,10 +1673,11 @@ void MainWindow::on_actionUndo_triggered()
 		return;
 
 	// Do Undo
+	ScopedOperation operation(*operations, tr("Undo"), OperationQueue::ACCESS_WRITE);
 	if(!getWorkspace().undo(res, false))
 		QMessageBox::critical(this, tr("Error"), tr("Could not undo changes."), QMessageBox::Ok);
 
-	refresh();
+	scheduleRefresh();
 }
 
 //------------------------------------------------------------------------------
@@ -1801,7 +1708,7 @@ void MainWindow::loadFossilSettings()
 	// Also retrieve the fossil global settings
 	QStringList out;
 
-	if(!getWorkspace().fossil().getSettings(out))
+	if(!getWorkspace().getSettings(out))
 		return;
 
 	QStringMap kv;
@@ -1864,32 +1771,56 @@ void MainWindow::on_actionFossilSettings_triggered()
 		Q_ASSERT(type == Settings::Setting::TYPE_FOSSIL_GLOBAL || type == Settings::Setting::TYPE_FOSSIL_LOCAL);
 
 		QString value = it.value().Value.toString();
-		getWorkspace().fossil().setSetting(name, value, type == Settings::Setting::TYPE_FOSSIL_GLOBAL);
+		getWorkspace().setSetting(name, value, type == Settings::Setting::TYPE_FOSSIL_GLOBAL);
+	}
+}
+
+//------------------------------------------------------------------------------
+void MainWindow::applyViewFilter()
+{
+	getWorkspace().setViewFilter(ui->actionViewUnknown->isChecked(),
+								ui->actionViewIgnored->isChecked(),
+								ui->actionViewModified->isChecked(),
+								ui->actionViewUnchanged->isChecked());
+}
+
+//------------------------------------------------------------------------------
+// Filter the files in memory unless the view needs files the last scan skipped
+void MainWindow::updateViewFilter()
+{
+	applyViewFilter();
+	if(!getWorkspace().isViewCovered())
+	{
+		scheduleRefresh();
+		return;
 	}
+
+	updateWorkspaceView();
+	updateFileView();
 }
 
 //------------------------------------------------------------------------------
 void MainWindow::on_actionViewModified_triggered()
 {
-	refresh();
+	updateViewFilter();
 }
 
 //------------------------------------------------------------------------------
 void MainWindow::on_actionViewUnchanged_triggered()
 {
-	refresh();
+	updateViewFilter();
 }
 
 //------------------------------------------------------------------------------
 void MainWindow::on_actionViewUnknown_triggered()
 {
-	refresh();
+	updateViewFilter();
 }
 
 //------------------------------------------------------------------------------
 void MainWindow::on_actionViewIgnored_triggered()
 {
-	refresh();
+	updateViewFilter();
 }
 
 //------------------------------------------------------------------------------
@@ -1899,7 +1830,7 @@ void MainWindow::on_actionViewAll_triggered()
 	ui->actionViewUnchanged->setChecked(true);
 	ui->actionViewUnknown->setChecked(true);
 	ui->actionViewIgnored->setChecked(true);
-	refresh();
+	updateViewFilter();
 }
 
 //------------------------------------------------------------------------------
@@ -1909,7 +1840,7 @@ void MainWindow::on_actionViewModifedOnly_triggered()
 	ui->actionViewUnchanged->setChecked(false);
 	ui->actionViewUnknown->setChecked(false);
 	ui->actionViewIgnored->setChecked(false);
-	refresh();
+	updateViewFilter();
 }
 
 //------------------------------------------------------------------------------
@@ -1931,6 +1862,72 @@ void MainWindow::on_actionViewAsFolders_triggered()
 	updateFileView();
 }
 
+//------------------------------------------------------------------------------
+void MainWindow::on_actionQuickOpen_triggered()
+{
+	FileTable &files = getWorkspace().getFiles();
+	if(quickOpenMatcher.isEmpty())
+		quickOpenMatcher.setRows(files, getWorkspace().getDirTree().getFileRows());
+
+	QVector<int> recent_rows;
+	foreach(const QString &path, quickOpenHistory)
+	{
+		int row = files.find(path);
+		if(row>=0)
+			recent_rows.append(row);
+	}
+	quickOpenMatcher.setRecent(recent_rows);
+
+	QString file_path;
+	if(!QuickOpenDialog::run(this, quickOpenMatcher, files, file_path))
+		return;
+
+	quickOpenHistory.removeAll(file_path);
+	quickOpenHistory.prepend(file_path);
+	while(quickOpenHistory.size() > MAX_QUICKOPEN_HISTORY)
+		quickOpenHistory.removeLast();
+
+	selectFile(file_path);
+}
+
+//------------------------------------------------------------------------------
+// Shows the file in the views, selects it and applies the double-click action
+void MainWindow::selectFile(const QString &filePath)
+{
+	FileTable &files = getWorkspace().getFiles();
+	int file_row = files.find(filePath);
+	if(file_row<0)
+		return;
+
+	// Select the folder of the file so that the file view lists it
+	if(viewMode==VIEWMODE_TREE)
+	{
+		QModelIndex folder = getWorkspace().getTreeModel().findFolder(files.getDirPath(files.getDirId(file_row)));
+		if(folder.isValid())
+		{
+			ui->workspaceTreeView->scrollTo(folder);
+			ui->workspaceTreeView->selectionModel()->setCurrentIndex(folder, QItemSelectionModel::ClearAndSelect);
+		}
+	}
+
+	FileTableModel &model = getWorkspace().getFileModel();
+	int row = model.findRow(file_row);
+	if(row<0 && !searchBox->text().isEmpty())
+	{
+		searchBox->clear();
+		row = model.findRow(file_row);
+	}
+	if(row<0)
+		return;
+
+	QModelIndex mi = model.index(row, FileTableModel::COLUMN_FILENAME);
+	ui->fileTableView->selectionModel()->setCurrentIndex(mi, QItemSelectionModel::ClearAndSelect|QItemSelectionModel::Rows);
+	ui->fileTableView->scrollTo(mi);
+	ui->fileTableView->setFocus();
+
+	on_fileTableView_doubleClicked(mi);
+}
+
 //------------------------------------------------------------------------------
 void MainWindow::onWorkspaceTreeViewSelectionChanged(const QItemSelection &/*selected*/, const QItemSelection &/*deselected*/)
 {
@@ -2000,6 +1997,9 @@ void MainWindow::on_workspaceTreeView_doubleClicked(const QModelIndex &index)
 //------------------------------------------------------------------------------
 void MainWindow::on_actionRenameFolder_triggered()
 {
+	// The rows must not change while the files are collected and moved
+	ScopedOperation operation(*operations, tr("Rename Folder"), OperationQueue::ACCESS_WRITE);
+
 	stringset_t paths;
 	getSelectionPaths(paths);
 
@@ -2044,26 +2044,37 @@ void MainWindow::on_actionRenameFolder_triggered()
 
 	QString new_path = old_path.left(dir_start) + new_name;
 
-	if(getWorkspace().getPaths().contains(new_path))
+	if(getWorkspace().getDirTree().findDir(new_path)>=0)
 	{
 		QMessageBox::critical(this, tr("Error"), tr("Cannot rename folder.")+"\n" +tr("This folder exists already."));
 		return;
 	}
 
-	// Collect the files to be moved
-	filelist_t files_to_move;
+	// Collect the files to be moved, from the rows below the folder
+	const DirTree &tree = getWorkspace().getDirTree();
+	const FileTable &files = getWorkspace().getFiles();
+	DirTree::rangelist_t ranges;
+	tree.getTreeRanges(QStringList() << old_path, ranges);
+
+	QStringList files_to_move;
+	QStringList new_file_paths;
 	QStringList new_paths;
-	QStringList operations;
-	foreach(WorkspaceFile *r, getWorkspace().getFiles())
+	QStringList actions;
+	for(int r=0; r<ranges.size(); ++r)
 	{
-		if(r->getPath().indexOf(old_path)!=0)
-			continue;
+		for(int i=ranges[r].first; i<ranges[r].second; ++i)
+		{
+			WorkspaceFile f = files.at(tree.getFileRows()[i]);
+			if(!getWorkspace().isVisible(f))
+				continue;
 
-		files_to_move.append(r);
-		QString new_dir = new_path + r->getPath().mid(old_path.length());
-		new_paths.append(new_dir);
-		QString new_file_path =  new_dir + PATH_SEPARATOR + r->getFilename();
-		operations.append(r->getFilePath() + " -> " + new_file_path);
+			QString new_dir = new_path + f.getPath().mid(old_path.length());
+			QString new_file_path = new_dir + PATH_SEPARATOR + f.getFilename();
+			files_to_move.append(f.getFilePath());
+			new_paths.append(new_dir);
+			new_file_paths.append(new_file_path);
+			actions.append(f.getFilePath() + " -> " + new_file_path);
+		}
 	}
 
 	if(files_to_move.empty())
@@ -2072,7 +2083,7 @@ void MainWindow::on_actionRenameFolder_triggered()
 	bool move_local = false;
 	if(!FileActionDialog::run(this, tr("Rename Folder"), tr("Renaming folder '%0' to '%1'\n"
 							  "The following files will be moved in the repository.").arg(old_path, new_path)+"\n"+tr("Are you sure?"),
-							  operations,
+							  actions,
 							  tr("Also move the workspace files"), &move_local)) {
 		return;
 	}
@@ -2081,10 +2092,7 @@ void MainWindow::on_actionRenameFolder_triggered()
 	Q_ASSERT(files_to_move.length() == new_paths.length());
 	for(int i=0; i<files_to_move.length(); ++i)
 	{
-		WorkspaceFile *r = files_to_move[i];
-		const QString &new_file_path = new_paths[i] + PATH_SEPARATOR + r->getFilename();
-
-		if(!getWorkspace().renameFile(r->getFilePath(), new_file_path, false))
+		if(!getWorkspace().renameFile(files_to_move[i], new_file_paths[i], false))
 		{
 			log(tr("Move aborted due to errors")+"\n");
 			goto _exit;
@@ -2117,8 +2125,8 @@ void MainWindow::on_actionRenameFolder_triggered()
 	// Now that target directories exist copy files
 	for(int i=0; i<files_to_move.length(); ++i)
 	{
-		WorkspaceFile *r = files_to_move[i];
-		QString new_file_path = new_paths[i] + PATH_SEPARATOR + r->getFilename();
+		const QString &old_file_path = files_to_move[i];
+		const QString &new_file_path = new_file_paths[i];
 
 		if(QFile::exists(new_file_path))
 		{
@@ -2126,11 +2134,11 @@ void MainWindow::on_actionRenameFolder_triggered()
 			goto _exit;
 		}
 
-		log(tr("Copying file '%0' to '%1'").arg(r->getFilePath(), new_file_path)+"\n");
+		log(tr("Copying file '%0' to '%1'").arg(old_file_path, new_file_path)+"\n");
 
-		if(!QFile::copy(r->getFilePath(), new_file_path))
+		if(!QFile::copy(old_file_path, new_file_path))
 		{
-			QMessageBox::critical(this, tr("Error"), tr("Cannot copy file '%0' to '%1'").arg(r->getFilePath(), new_file_path));
+			QMessageBox::critical(this, tr("Error"), tr("Cannot copy file '%0' to '%1'").arg(old_file_path, new_file_path));
 			goto _exit;
 		}
 	}
@@ -2138,19 +2146,19 @@ void MainWindow::on_actionRenameFolder_triggered()
 	// Finally delete old files
 	for(int i=0; i<files_to_move.length(); ++i)
 	{
-		WorkspaceFile *r = files_to_move[i];
+		const QString &old_file_path = files_to_move[i];
 
-		log(tr("Removing old file '%0'").arg(r->getFilePath())+"\n");
+		log(tr("Removing old file '%0'").arg(old_file_path)+"\n");
 
-		if(!QFile::exists(r->getFilePath()))
+		if(!QFile::exists(old_file_path))
 		{
-			QMessageBox::critical(this, tr("Error"), tr("Source file '%0' does not exist").arg(r->getFilePath()));
+			QMessageBox::critical(this, tr("Error"), tr("Source file '%0' does not exist").arg(old_file_path));
 			goto _exit;
 		}
 
-		if(!QFile::remove(r->getFilePath()))
+		if(!QFile::remove(old_file_path))
 		{
-			QMessageBox::critical(this, tr("Error"), tr("Cannot remove file '%0'").arg(r->getFilePath()));
+			QMessageBox::critical(this, tr("Error"), tr("Cannot remove file '%0'").arg(old_file_path));
 			goto _exit;
 		}
 	}
@@ -2158,7 +2166,7 @@ void MainWindow::on_actionRenameFolder_triggered()
 	log(tr("Folder renamed completed. Don't forget to commit!")+"\n");
 
 _exit:
-	refresh();
+	scheduleRefresh();
 }
 
 //------------------------------------------------------------------------------
@@ -2224,10 +2232,11 @@ void MainWindow::on_actionCreateStash_triggered()
 	}
 
 	// Do Stash
+	ScopedOperation operation(*operations, tr("Create Stash"), OperationQueue::ACCESS_WRITE);
 	if(!getWorkspace().stashNew(stashed_files, stash_name, revert))
 		QMessageBox::critical(this, tr("Error"), tr("Could not create stash."), QMessageBox::Ok);
 
-	refresh();
+	refreshFiles(revert ? stashed_files : QStringList(), MetadataCache::CATEGORY_STASHES);
 }
 
 //------------------------------------------------------------------------------
@@ -2243,6 +2252,8 @@ void MainWindow::on_actionApplyStash_triggered()
 	if(!FileActionDialog::run(this, tr("Apply Stash"), tr("The following stashes will be applied.")+"\n"+tr("Are you sure?"), stashes, tr("Delete after applying"), &delete_stashes))
 		return;
 
+	ScopedOperation operation(*operations, tr("Apply Stash"), OperationQueue::ACCESS_WRITE);
+
 	// Apply stashes
 	for(QStringList::iterator it=stashes.begin(); it!=stashes.end(); ++it)
 	{
@@ -2271,7 +2282,7 @@ void MainWindow::on_actionApplyStash_triggered()
 		}
 	}
 
-	refresh();
+	scheduleRefresh();
 }
 
 //------------------------------------------------------------------------------
@@ -2286,6 +2297,8 @@ void MainWindow::on_actionDeleteStash_triggered()
 	if(!FileActionDialog::run(this, tr("Delete Stashes"), tr("The following stashes will be deleted.")+"\n"+tr("Are you sure?"), stashes))
 		return;
 
+	ScopedOperation operation(*operations, tr("Delete Stashes"), OperationQueue::ACCESS_WRITE);
+
 	// Delete stashes
 	for(QStringList::iterator it=stashes.begin(); it!=stashes.end(); ++it)
 	{
@@ -2300,7 +2313,7 @@ void MainWindow::on_actionDeleteStash_triggered()
 		}
 	}
 
-	refresh();
+	refreshFiles(QStringList(), MetadataCache::CATEGORY_STASHES);
 }
 
 //------------------------------------------------------------------------------
@@ -2366,7 +2379,7 @@ void MainWindow::on_fileTableView_customContextMenuRequested(const QPoint &pos)
 			QString fname = getWorkspace().getPath() + PATH_SEPARATOR + fnames[0];
 			fname = QDir::toNativeSeparators(fname);
 			if(ShowExplorerMenu((HWND)winId(), fname, gpos))
-				refresh();
+				scheduleRefresh();
 		}
 	}
 	else
@@ -2476,10 +2489,11 @@ void MainWindow::dropEvent(QDropEvent *event)
 				return;
 
 			// Do Add
+			ScopedOperation operation(*operations, tr("Add files"), OperationQueue::ACCESS_WRITE);
 			if(!getWorkspace().addFiles(newfiles))
 				QMessageBox::critical(this, tr("Error"), tr("Could not add files."), QMessageBox::Ok);
 
-			refresh();
+			refreshFiles(newfiles);
 		}
 	}
 }
@@ -2504,13 +2518,67 @@ void MainWindow::on_actionAbortOperation_triggered()
 {
 	operationAborted = true;
 	uiCallback.abortProcess();
+	getWorkspace().abortScan();
+	if(activeJob)
+		activeJob->abort();
 	log("<br><b>* "+tr("Operation Aborted")+" *</b><br>", true);
 }
 
+//------------------------------------------------------------------------------
+// Track a fossil job running in the background. The window remains responsive
+// but busy until the job completes, at which point finishedSlot is invoked.
+bool MainWindow::runJob(FossilJob *job, const char *finishedSlot)
+{
+	if(!job)
+		return false;
+
+	activeJob = job;
+	setBusy(true);
+	QString title = QString("Fossil %0").arg(job->getArgs().first().toCaseFolded());
+	uiCallback.beginProgress(title);
+
+	// Clean-up first so that the handler finds the window idle
+	connect(job, SIGNAL(finished(FossilJob*)), this, SLOT(onJobFinished(FossilJob*)));
+	connect(job, SIGNAL(finished(FossilJob*)), this, finishedSlot);
+
+	// Started once the operations it would disturb are done
+	activeJobOperation = operations->enqueue(title, OperationQueue::ACCESS_WRITE, this, "onJobOperation");
+	return true;
+}
+
+//------------------------------------------------------------------------------
+void MainWindow::onJobOperation(int id)
+{
+	// Aborted while waiting
+	if(!activeJob || id!=activeJobOperation)
+	{
+		operations->finish(id);
+		return;
+	}
+
+	// A failure to start finishes the job
+	activeJob->start();
+}
+
+//------------------------------------------------------------------------------
+void MainWindow::onJobFinished(FossilJob *job)
+{
+	if(activeJob == job)
+	{
+		activeJob = 0;
+		operations->finish(activeJobOperation);
+		activeJobOperation = 0;
+	}
+
+	uiCallback.endProgress();
+	setBusy(false);
+	job->deleteLater();
+}
+
 //------------------------------------------------------------------------------
 void MainWindow::fullRefresh()
 {
-	refresh();
+	scheduleRefresh();
 	// Select the Root of the tree to update the file view
 	selectRootDir();
 }
@@ -2523,7 +2591,29 @@ void MainWindow::MainWinUICallback::logText(const QString& text, bool isHTML)
 }
 
 //------------------------------------------------------------------------------
+// Fossil commands waited upon keep the events flowing, so the input and the
+// queued operations are held back until they are done
 void MainWindow::MainWinUICallback::beginProcess(const QString& text)
+{
+	Q_ASSERT(mainWindow);
+	QCoreApplication::instance()->installEventFilter(mainWindow->inputBlocker);
+	blockingInput = true;
+	mainWindow->operations->hold();
+	beginProgress(text);
+}
+
+//------------------------------------------------------------------------------
+void MainWindow::MainWinUICallback::endProcess()
+{
+	Q_ASSERT(mainWindow);
+	QCoreApplication::instance()->removeEventFilter(mainWindow->inputBlocker);
+	blockingInput = false;
+	mainWindow->operations->release();
+	endProgress();
+}
+
+//------------------------------------------------------------------------------
+void MainWindow::MainWinUICallback::beginProgress(const QString& text)
 {
 	Q_ASSERT(mainWindow);
 	aborted = false;
@@ -2544,9 +2634,10 @@ void MainWindow::MainWinUICallback::updateProcess(const QString& text)
 }
 
 //------------------------------------------------------------------------------
-void MainWindow::MainWinUICallback::endProcess()
+void MainWindow::MainWinUICallback::endProgress()
 {
 	Q_ASSERT(mainWindow);
+	aborted = false;
 	mainWindow->ui->statusBar->clearMessage();
 	mainWindow->lblTags->setHidden(false);
 	mainWindow->progressBar->setHidden(true);
@@ -2558,7 +2649,15 @@ void MainWindow::MainWinUICallback::endProcess()
 //------------------------------------------------------------------------------
 QMessageBox::StandardButton MainWindow::MainWinUICallback::Query(const QString &title, const QString &query, QMessageBox::StandardButtons buttons)
 {
-	return DialogQuery(mainWindow, title, query, buttons);
+	// The query needs the input that is held back from the window
+	if(blockingInput)
+		QCoreApplication::instance()->removeEventFilter(mainWindow->inputBlocker);
+
+	QMessageBox::StandardButton res = DialogQuery(mainWindow, title, query, buttons);
+
+	if(blockingInput)
+		QCoreApplication::instance()->installEventFilter(mainWindow->inputBlocker);
+	return res;
 }
 
 //------------------------------------------------------------------------------
@@ -2605,10 +2704,11 @@ void MainWindow::updateRevision(const QString &revision)
 		return;
 
 	// Do update
+	ScopedOperation operation(*operations, tr("Update"), OperationQueue::ACCESS_WRITE);
 	if(!getWorkspace().update(res, selected_revision, false))
 		QMessageBox::critical(this, tr("Error"), tr("Could not update the repository."), QMessageBox::Ok);
 
-	refresh();
+	scheduleRefresh();
 }
 
 //------------------------------------------------------------------------------
@@ -2627,10 +2727,11 @@ void MainWindow::on_actionCreateTag_triggered()
 		return;
 	}
 
+	ScopedOperation operation(*operations, tr("Create Tag"), OperationQueue::ACCESS_WRITE);
 	if(!getWorkspace().tagNew(name, revision))
 		QMessageBox::critical(this, tr("Error"), tr("Could not create tag."), QMessageBox::Ok);
 
-	refresh();
+	scheduleRefresh();
 }
 
 //------------------------------------------------------------------------------
@@ -2648,15 +2749,18 @@ void MainWindow::on_actionDeleteTag_triggered()
 
 	const QString &revision = getWorkspace().getTags()[tagname];
 
+	ScopedOperation operation(*operations, tr("Delete Tag"), OperationQueue::ACCESS_WRITE);
 	if(!getWorkspace().tagDelete(tagname, revision))
 		QMessageBox::critical(this, tr("Error"), tr("Could not delete tag."), QMessageBox::Ok);
 
-	refresh();
+	scheduleRefresh();
 }
 
 //------------------------------------------------------------------------------
 void MainWindow::on_actionCreateBranch_triggered()
 {
+	ScopedOperation operation(*operations, tr("Create Branch"), OperationQueue::ACCESS_WRITE);
+
 	// Default to current revision
 	QString revision = getWorkspace().getCurrentRevision();
 
@@ -2703,12 +2807,13 @@ void MainWindow::mergeRevision(const QString &defaultRevision)
 		return;
 
 	// Do update
+	ScopedOperation operation(*operations, tr("Merge"), OperationQueue::ACCESS_WRITE);
 	if(!getWorkspace().branchMerge(res, revision, integrate, force, false))
 		QMessageBox::critical(this, tr("Error"), tr("Merge failed."), QMessageBox::Ok);
 	else
 		log(tr("Merge completed. Don't forget to commit!")+"\n");
 
-	refresh();
+	scheduleRefresh();
 }
 
 //------------------------------------------------------------------------------
@@ -2722,9 +2827,22 @@ void MainWindow::on_actionMergeBranch_triggered()
 }
 
 //------------------------------------------------------------------------------
-void MainWindow::onSearchBoxTextChanged(const QString &)
+void MainWindow::onSearchBoxTextChanged(const QString &text)
 {
-	updateFileView();
+	// Clearing the filter is applied right away
+	if(text.isEmpty())
+	{
+		searchTimer->stop();
+		onSearchTimeout();
+	}
+	else
+		searchTimer->start();
+}
+
+//------------------------------------------------------------------------------
+void MainWindow::onSearchTimeout()
+{
+	getWorkspace().getFileModel().setFilterText(searchBox->text());
 }
 
 //------------------------------------------------------------------------------
@@ -2793,7 +2911,7 @@ void MainWindow::on_actionPushRemote_triggered()
 	if(!url.isLocalFile())
 		KeychainGet(this, url, *settings.GetStore());
 
-	if(!getWorkspace().push(url))
+	if(!runJob(getWorkspace().push(url, this), SLOT(onPushFinished(FossilJob*))))
 		QMessageBox::critical(this, tr("Error"), tr("Could not push to the remote repository."), QMessageBox::Ok);
 }
 
@@ -2811,7 +2929,7 @@ void MainWindow::on_actionPullRemote_triggered()
 	if(!url.isLocalFile())
 		KeychainGet(this, url, *settings.GetStore());
 
-	if(!getWorkspace().pull(url))
+	if(!runJob(getWorkspace().pull(url, this), SLOT(onPullFinished(FossilJob*))))
 		QMessageBox::critical(this, tr("Error"), tr("Could not pull from the remote repository."), QMessageBox::Ok);
 }
 
@@ -2830,7 +2948,7 @@ void MainWindow::on_actionPush_triggered()
 	if(!url.isLocalFile())
 		KeychainGet(this, url, *settings.GetStore());
 
-	if(!getWorkspace().push(url))
+	if(!runJob(getWorkspace().push(url, this), SLOT(onPushFinished(FossilJob*))))
 		QMessageBox::critical(this, tr("Error"), tr("Could not push to the remote repository."), QMessageBox::Ok);
 }
 
@@ -2849,7 +2967,21 @@ void MainWindow::on_actionPull_triggered()
 	if(!url.isLocalFile())
 		KeychainGet(this, url, *settings.GetStore());
 
-	if(!getWorkspace().pull(url))
+	if(!runJob(getWorkspace().pull(url, this), SLOT(onPullFinished(FossilJob*))))
+		QMessageBox::critical(this, tr("Error"), tr("Could not pull from the remote repository."), QMessageBox::Ok);
+}
+
+//------------------------------------------------------------------------------
+void MainWindow::onPushFinished(FossilJob *job)
+{
+	if(!job->succeeded() && !job->isAborted())
+		QMessageBox::critical(this, tr("Error"), tr("Could not push to the remote repository."), QMessageBox::Ok);
+}
+
+//------------------------------------------------------------------------------
+void MainWindow::onPullFinished(FossilJob *job)
+{
+	if(!job->succeeded() && !job->isAborted())
 		QMessageBox::critical(this, tr("Error"), tr("Could not pull from the remote repository."), QMessageBox::Ok);
 }
 
@@ -4,8 +4,11 @@
 #include <QMainWindow>
 #include <QStringList>
 #include <QFileIconProvider>
+#include <QPointer>
 #include "AppSettings.h"
 #include "Workspace.h"
+#include "FuzzyMatcher.h"
+#include "OperationQueue.h"
 
 namespace Ui {
 	class MainWindow;
@@ -23,10 +26,14 @@ public:
 	~MainWindow();
 	bool diffFile(const QString& repoFile);
 	void fullRefresh();
+	void setVerifyChanges(bool verify) { getWorkspace().fossil().setVerifyChanges(verify); }
 
 private:
 	bool refresh();
-	bool scanWorkspace();
+	bool scanWorkspace(WorkspaceState st);
+	bool refreshFiles(const QStringList &paths, int categories=0, bool checkoutChanged=false);
+	void updateVersionList();
+	void scheduleRefresh();
 	void applySettings();
 	void updateSettings();
 	void updateRevision(const QString& revision);
@@ -50,10 +57,14 @@ private:
 	void loadFossilSettings();
 	void updateWorkspaceView();
 	void updateFileView();
+	void applyViewFilter();
+	void updateViewFilter();
 	void selectRootDir();
+	void selectFile(const QString &filePath);
 	void mergeRevision(const QString& defaultRevision);
 	void updateCustomActions();
 	void invokeCustomAction(int actionId);
+	bool runJob(FossilJob *job, const char *finishedSlot);
 
 	void fossilBrowse(const QString &fossilUrl);
 	void dragEnterEvent(class QDragEnterEvent *event);
@@ -76,8 +87,23 @@ private slots:
 	void onWorkspaceTreeViewSelectionChanged(const class QItemSelection &selected, const class QItemSelection &deselected);
 	void onFileViewDragOut();
 	void onSearchBoxTextChanged(const QString &text);
+	void onSearchTimeout();
+	void onScanBatch();
+	void onScanProgress(const QString &text);
+	void onScanLogged(const QString &text, bool isHTML);
+	void onScanFinished();
+	void onWatchedChanges();
+	void onRefreshOperation(int id);
+	void onWatchedOperation(int id);
+	void onJobOperation(int id);
+	void onOperationPreempted(int id);
+	void onRescanNeeded();
 	void onSearch();
 	void onCustomActionTriggered();
+	void onJobFinished(FossilJob *job);
+	void onPushFinished(FossilJob *job);
+	void onPullFinished(FossilJob *job);
+	void onCloneFinished(FossilJob *job);
 
 	// Designer slots
 	void on_actionRefresh_triggered();
@@ -113,6 +139,7 @@ private slots:
 	void on_actionViewModifedOnly_triggered();
 	void on_actionViewAsList_triggered();
 	void on_actionViewAsFolders_triggered();
+	void on_actionQuickOpen_triggered();
 	void on_actionOpenFolder_triggered();
 	void on_actionRenameFolder_triggered();
 	void on_actionNewRepository_triggered();
@@ -140,7 +167,7 @@ private:
 	class MainWinUICallback : public UICallback
 	{
 	public:
-		MainWinUICallback() : mainWindow(0), aborted(false)
+		MainWinUICallback() : mainWindow(0), aborted(false), blockingInput(false)
 		{}
 
 		void init(class MainWindow *mainWindow)
@@ -153,19 +180,26 @@ private:
 		virtual void updateProcess(const QString& text);
 		virtual bool processAborted() const { return aborted; }
 		virtual void endProcess();
+
+		// The progress of work that leaves the window responsive
+		void beginProgress(const QString& text);
+		void endProgress();
 		virtual QMessageBox::StandardButton Query(const QString &title, const QString &query, QMessageBox::StandardButtons buttons);
 		void abortProcess() { aborted = true; }
 
 	private:
 		class MainWindow *mainWindow;
 		bool aborted;
+		bool blockingInput;
 	};
 
 	friend class MainWinUICallback;
 
 	enum
 	{
-		MAX_RECENT=5
+		MAX_RECENT=5,
+		SEARCH_DELAY_MS=120,	// Typing pause before the file view is filtered
+		MAX_QUICKOPEN_HISTORY=20
 	};
 
 	typedef QMap<QString, QIcon> icon_map_t;
@@ -179,9 +213,12 @@ private:
 	class QAction		*workspaceActionSeparator;
 	class QProgressBar	*progressBar;
 	class QToolButton	*abortButton;
+	class QObject		*inputBlocker;
 	class QLabel		*lblTags;
 	class SearchBox		*searchBox;
 	class QShortcut		*searchShortcut;
+	class QTimer		*searchTimer;
+	class WorkspaceWatcher	*workspaceWatcher;
 	QMenu				*menuWorkspace;
 	QMenu				*menuStashes;
 	QMenu				*menuTags;
@@ -200,8 +237,15 @@ private:
 
 	Settings			&settings;
 	QStringList			workspaceHistory;
+	FuzzyMatcher		quickOpenMatcher;
+	QStringList			quickOpenHistory;	// Most recent first
 
 	MainWinUICallback	uiCallback;
+	QPointer<FossilJob>	activeJob;
+	int					activeJobOperation;
+
+	OperationQueue		*operations;
+	int					refreshOperation;	// The queued refresh whose scan is running
 
 	ViewMode			viewMode;
 };
@@ -0,0 +1,204 @@
+#include "MetadataCache.h"
+#include <QFileInfo>
+#include <QDateTime>
+#include <QFile>
+#include <QDir>
+#include <QDataStream>
+
+// Offset of the file change counter in the sqlite header
+static const int	SQLITE_CHANGE_COUNTER_OFFSET = 24;
+
+//------------------------------------------------------------------------------
+static void StampFile(QVector<qint64> &stamp, const QString &filename)
+{
+	QFileInfo fi(filename);
+	if(!fi.exists())
+	{
+		stamp << -1;
+		return;
+	}
+	stamp << fi.lastModified().toMSecsSinceEpoch() << fi.size();
+}
+
+//------------------------------------------------------------------------------
+// Stamp a sqlite database. Commits in rollback journal mode bump the change
+// counter in the header, while in WAL mode they grow the -wal file.
+static void StampDatabase(QVector<qint64> &stamp, const QString &filename)
+{
+	StampFile(stamp, filename);
+	StampFile(stamp, filename+"-wal");
+
+	qint64 counter = -1;
+	QFile file(filename);
+	unsigned char header[4];
+	if(file.open(QIODevice::ReadOnly) && file.seek(SQLITE_CHANGE_COUNTER_OFFSET) && file.read(reinterpret_cast<char *>(header), sizeof(header))==sizeof(header))
+		counter = (quint32(header[0])<<24) | (quint32(header[1])<<16) | (quint32(header[2])<<8) | quint32(header[3]);
+	stamp << counter;
+}
+
+//------------------------------------------------------------------------------
+// The locations fossil looks for its global configuration database
+static QStringList GetGlobalConfigFiles()
+{
+	QStringList files;
+#ifdef Q_OS_WIN
+	const char *vars[] = { "FOSSIL_HOME", "LOCALAPPDATA", "APPDATA", "USERPROFILE" };
+	for(size_t i=0; i<COUNTOF(vars); ++i)
+	{
+		QString dir = QString::fromLocal8Bit(qgetenv(vars[i]));
+		if(!dir.isEmpty())
+			files << dir + PATH_SEPARATOR "_fossil";
+	}
+#else
+	QString fossil_home = QString::fromLocal8Bit(qgetenv("FOSSIL_HOME"));
+	if(!fossil_home.isEmpty())
+		files << fossil_home + PATH_SEPARATOR ".fossil";
+
+	QString config_home = QString::fromLocal8Bit(qgetenv("XDG_CONFIG_HOME"));
+	if(config_home.isEmpty())
+		config_home = QDir::homePath() + PATH_SEPARATOR ".config";
+	files << config_home + PATH_SEPARATOR "fossil.db";
+	files << QDir::homePath() + PATH_SEPARATOR ".fossil";
+#endif
+	return files;
+}
+
+//------------------------------------------------------------------------------
+static QDataStream &operator<<(QDataStream &out, const BranchTip &tip)
+{
+	return out << tip.revision << tip.lastCheckin << tip.user;
+}
+
+//------------------------------------------------------------------------------
+static QDataStream &operator>>(QDataStream &in, BranchTip &tip)
+{
+	return in >> tip.revision >> tip.lastCheckin >> tip.user;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+MetadataCache::MetadataCache()
+	: validCategories(0)
+	, hits(0)
+	, misses(0)
+{
+}
+
+//------------------------------------------------------------------------------
+int MetadataCache::indexOf(Category category)
+{
+	switch(category)
+	{
+	case CATEGORY_SETTINGS:
+		return 0;
+	case CATEGORY_STASHES:
+		return 1;
+	case CATEGORY_BRANCHES:
+		return 2;
+	case CATEGORY_TAGS:
+		return 3;
+	default:
+		Q_ASSERT(0);
+		return 0;
+	}
+}
+
+//------------------------------------------------------------------------------
+void MetadataCache::setPaths(const QString &_workspacePath, const QString &_repositoryFile)
+{
+	if(_workspacePath==workspacePath && _repositoryFile==repositoryFile)
+		return;
+
+	workspacePath = _workspacePath;
+	repositoryFile = _repositoryFile;
+	invalidate();
+}
+
+//------------------------------------------------------------------------------
+void MetadataCache::invalidate(int categories)
+{
+	validCategories &= ~categories;
+}
+
+//------------------------------------------------------------------------------
+MetadataCache::stamp_t MetadataCache::captureStamp(Category category) const
+{
+	stamp_t stamp;
+
+	// Stashes live in the checkout database, everything else in the repository
+	if(category==CATEGORY_STASHES)
+	{
+		StampDatabase(stamp, workspacePath + PATH_SEPARATOR FOSSIL_CHECKOUT1);
+		StampDatabase(stamp, workspacePath + PATH_SEPARATOR FOSSIL_CHECKOUT2);
+		return stamp;
+	}
+
+	StampDatabase(stamp, repositoryFile);
+
+	if(category==CATEGORY_SETTINGS)
+	{
+		foreach(const QString &f, GetGlobalConfigFiles())
+			StampDatabase(stamp, f);
+
+		// Versionable settings
+		QDir versioned(workspacePath + PATH_SEPARATOR ".fossil-settings");
+		foreach(const QFileInfo &fi, versioned.entryInfoList(QDir::Files, QDir::Name))
+			stamp << fi.lastModified().toMSecsSinceEpoch() << fi.size();
+	}
+
+	return stamp;
+}
+
+//------------------------------------------------------------------------------
+bool MetadataCache::lookup(Category category)
+{
+	int index = indexOf(category);
+	stamp_t stamp = captureStamp(category);
+
+	if((validCategories & category) && stamps[index]==stamp)
+	{
+		++hits;
+		return true;
+	}
+
+	++misses;
+	validCategories &= ~category;
+	pendingStamps[index] = stamp;
+	return false;
+}
+
+//------------------------------------------------------------------------------
+void MetadataCache::store(Category category)
+{
+	int index = indexOf(category);
+	stamps[index] = pendingStamps[index];
+	validCategories |= category;
+}
+
+//------------------------------------------------------------------------------
+void MetadataCache::save(QDataStream &out) const
+{
+	out << workspacePath << repositoryFile << qint32(validCategories);
+	for(int i=0; i<CATEGORY_COUNT; ++i)
+		out << stamps[i];
+	out << settings << stashes << branches << branchTips << tags;
+}
+
+//------------------------------------------------------------------------------
+// The categories keep their stamps, so lookup() revalidates them as usual
+bool MetadataCache::load(QDataStream &in)
+{
+	qint32 valid = 0;
+	in >> workspacePath >> repositoryFile >> valid;
+	for(int i=0; i<CATEGORY_COUNT; ++i)
+		in >> stamps[i];
+	in >> settings >> stashes >> branches >> branchTips >> tags;
+
+	if(in.status()!=QDataStream::Ok)
+	{
+		invalidate();
+		return false;
+	}
+
+	validCategories = valid & CATEGORY_ALL;
+	return true;
+}
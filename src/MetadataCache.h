@@ -0,0 +1,79 @@
+#ifndef METADATACACHE_H
+#define METADATACACHE_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QDataStream>
+#include "Utils.h"
+#include "WorkspaceCommon.h"
+
+//////////////////////////////////////////////////////////////////////////
+// MetadataCache
+// Keeps the workspace metadata that rarely changes between refreshes.
+// Each category is stamped with the state of the files fossil stores it
+// in, and is dropped once any of them change or when Fuel itself
+// invalidates it after running a command that modifies it.
+//////////////////////////////////////////////////////////////////////////
+class MetadataCache
+{
+public:
+	enum Category
+	{
+		CATEGORY_SETTINGS	= 1<<0,
+		CATEGORY_STASHES	= 1<<1,
+		CATEGORY_BRANCHES	= 1<<2,
+		CATEGORY_TAGS		= 1<<3,
+		CATEGORY_ALL		= CATEGORY_SETTINGS|CATEGORY_STASHES|CATEGORY_BRANCHES|CATEGORY_TAGS
+	};
+
+	MetadataCache();
+
+	void				setPaths(const QString &workspacePath, const QString &repositoryFile);
+	void				invalidate(int categories=CATEGORY_ALL);
+
+	// Returns true if the category can be used as is. On a miss the
+	// current stamp is taken, to be committed by a subsequent store()
+	bool				lookup(Category category);
+	void				store(Category category);
+
+	// Persists the data along with the stamps it was valid for
+	void				save(QDataStream &out) const;
+	bool				load(QDataStream &in);
+
+	int					getHits() const { return hits; }
+	int					getMisses() const { return misses; }
+
+	QStringList			&getSettings() { return settings; }
+	stashmap_t			&getStashes() { return stashes; }
+	QStringList			&getBranches() { return branches; }
+	branchmap_t			&getBranchTips() { return branchTips; }
+	QStringMap			&getTags() { return tags; }
+
+private:
+	enum
+	{
+		CATEGORY_COUNT = 4
+	};
+
+	typedef QVector<qint64> stamp_t;
+
+	static int			indexOf(Category category);
+	stamp_t				captureStamp(Category category) const;
+
+	QString				workspacePath;
+	QString				repositoryFile;
+	stamp_t				stamps[CATEGORY_COUNT];
+	stamp_t				pendingStamps[CATEGORY_COUNT];
+	int					validCategories;
+	int					hits;
+	int					misses;
+
+	QStringList			settings;
+	stashmap_t			stashes;
+	QStringList			branches;
+	branchmap_t			branchTips;
+	QStringMap			tags;
+};
+
+#endif // METADATACACHE_H
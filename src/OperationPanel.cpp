@@ -0,0 +1,110 @@
+#include "OperationPanel.h"
+#include <QHeaderView>
+#include <QCoreApplication>
+
+// The texts keep the MainWindow context of the rest of the window
+static const char *const COLUMN_TITLES[] =
+{
+	QT_TRANSLATE_NOOP("MainWindow", "Operation"),
+	QT_TRANSLATE_NOOP("MainWindow", "State"),
+	QT_TRANSLATE_NOOP("MainWindow", "Waited"),
+	QT_TRANSLATE_NOOP("MainWindow", "Ran")
+};
+
+//------------------------------------------------------------------------------
+static QString FormatMsecs(qint64 msecs)
+{
+	if(msecs<0)
+		return QString();
+	if(msecs<1000)
+		return QCoreApplication::translate("MainWindow", "%0 ms").arg(msecs);
+	return QCoreApplication::translate("MainWindow", "%0 s").arg(msecs/1000.0, 0, 'f', 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+OperationPanel::OperationPanel(QWidget *parent)
+	: QTreeWidget(parent)
+{
+	setColumnCount(COLUMN_COUNT);
+	QStringList titles;
+	for(int i=0; i<COLUMN_COUNT; ++i)
+		titles << QCoreApplication::translate("MainWindow", COLUMN_TITLES[i]);
+	setHeaderLabels(titles);
+	setRootIsDecorated(false);
+	setSelectionMode(QAbstractItemView::NoSelection);
+	setFrameShape(QFrame::NoFrame);
+	header()->setSectionResizeMode(COLUMN_OPERATION, QHeaderView::Stretch);
+	header()->setStretchLastSection(false);
+
+	updateTimer.setInterval(UPDATE_INTERVAL_MS);
+	connect(&updateTimer, SIGNAL(timeout()), this, SLOT(updateItems()));
+}
+
+//------------------------------------------------------------------------------
+void OperationPanel::setQueue(OperationQueue *_queue)
+{
+	if(queue)
+		disconnect(queue, 0, this, 0);
+
+	queue = _queue;
+	if(queue)
+		connect(queue, SIGNAL(changed()), this, SLOT(updateItems()));
+	updateItems();
+}
+
+//------------------------------------------------------------------------------
+void OperationPanel::addItem(const OperationQueue::Operation &op)
+{
+	QString state;
+	qint64 waited = op.waitMsecs;
+	qint64 ran = op.runMsecs;
+
+	switch(op.state)
+	{
+	case OperationQueue::STATE_PENDING:
+		state = QCoreApplication::translate("MainWindow", "Waiting");
+		waited = op.timer.elapsed();
+		break;
+	case OperationQueue::STATE_RUNNING:
+		state = QCoreApplication::translate("MainWindow", "Running");
+		ran = op.timer.elapsed();
+		break;
+	case OperationQueue::STATE_FINISHED:
+		state = waited<0 ? QCoreApplication::translate("MainWindow", "Dropped") : QCoreApplication::translate("MainWindow", "Done");
+		break;
+	}
+
+	QTreeWidgetItem *item = new QTreeWidgetItem(this);
+	item->setText(COLUMN_OPERATION, op.title);
+	item->setText(COLUMN_STATE, state);
+	item->setText(COLUMN_WAITED, FormatMsecs(waited));
+	item->setText(COLUMN_RAN, FormatMsecs(ran));
+
+	if(op.state==OperationQueue::STATE_FINISHED)
+	{
+		for(int i=0; i<COLUMN_COUNT; ++i)
+			item->setForeground(i, palette().brush(QPalette::Disabled, QPalette::Text));
+	}
+}
+
+//------------------------------------------------------------------------------
+void OperationPanel::updateItems()
+{
+	clear();
+	if(!queue)
+	{
+		updateTimer.stop();
+		return;
+	}
+
+	foreach(const OperationQueue::Operation &op, queue->getOperations())
+		addItem(op);
+	foreach(const OperationQueue::Operation &op, queue->getHistory())
+		addItem(op);
+
+	// Only the active operations have times that change
+	if(queue->isIdle())
+		updateTimer.stop();
+	else if(!updateTimer.isActive())
+		updateTimer.start();
+}
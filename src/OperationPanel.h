@@ -0,0 +1,45 @@
+#ifndef OPERATIONPANEL_H
+#define OPERATIONPANEL_H
+
+#include <QTreeWidget>
+#include <QTimer>
+#include "OperationQueue.h"
+
+//////////////////////////////////////////////////////////////////////////
+// OperationPanel
+// Lists the queued and running operations with their wait times, and
+// the ones that finished recently
+//////////////////////////////////////////////////////////////////////////
+class OperationPanel : public QTreeWidget
+{
+	Q_OBJECT
+public:
+	explicit OperationPanel(QWidget *parent=0);
+
+	void				setQueue(OperationQueue *queue);
+
+private slots:
+	void				updateItems();
+
+private:
+	enum
+	{
+		COLUMN_OPERATION,
+		COLUMN_STATE,
+		COLUMN_WAITED,
+		COLUMN_RAN,
+		COLUMN_COUNT
+	};
+
+	enum
+	{
+		UPDATE_INTERVAL_MS = 1000	// For the times of the active operations
+	};
+
+	void				addItem(const OperationQueue::Operation &op);
+
+	QPointer<OperationQueue>	queue;
+	QTimer				updateTimer;
+};
+
+#endif // OPERATIONPANEL_H
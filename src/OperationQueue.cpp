@@ -0,0 +1,205 @@
+#include "OperationQueue.h"
+#include <QMetaObject>
+
+///////////////////////////////////////////////////////////////////////////////
+OperationQueue::OperationQueue(QObject *parent)
+	: QObject(parent)
+	, nextId(1)
+	, holdCount(0)
+	, schedulePending(false)
+{
+}
+
+//------------------------------------------------------------------------------
+int OperationQueue::enqueue(const QString &title, Access access, QObject *target, const char *member, const QString &key)
+{
+	if(!key.isEmpty())
+	{
+		foreach(const Operation &op, operations)
+		{
+			if(op.state==STATE_PENDING && op.key==key)
+				return op.id;
+		}
+	}
+
+	Operation op;
+	op.id = nextId++;
+	op.title = title;
+	op.key = key;
+	op.priority = PRIORITY_BACKGROUND;
+	op.access = access;
+	op.state = STATE_PENDING;
+	op.target = target;
+	op.member = member;
+	op.waitMsecs = -1;
+	op.runMsecs = -1;
+	op.timer.start();
+	operations.append(op);
+
+	requestSchedule();
+	emit changed();
+	return op.id;
+}
+
+//------------------------------------------------------------------------------
+int OperationQueue::begin(const QString &title, Access access)
+{
+	Operation op;
+	op.id = nextId++;
+	op.title = title;
+	op.priority = PRIORITY_INTERACTIVE;
+	op.access = access;
+	op.state = STATE_RUNNING;
+	op.waitMsecs = 0;
+	op.runMsecs = -1;
+	op.timer.start();
+	operations.append(op);
+
+	// Collected first, as the receivers may finish them right away
+	QList<int> conflicting;
+	foreach(const Operation &other, operations)
+	{
+		if(other.state==STATE_RUNNING && other.priority==PRIORITY_BACKGROUND && conflicts(op, other))
+			conflicting.append(other.id);
+	}
+	foreach(int id, conflicting)
+		emit preempted(id);
+
+	emit changed();
+	return op.id;
+}
+
+//------------------------------------------------------------------------------
+void OperationQueue::hold()
+{
+	++holdCount;
+}
+
+//------------------------------------------------------------------------------
+void OperationQueue::release()
+{
+	Q_ASSERT(holdCount>0);
+	if(--holdCount==0)
+		requestSchedule();
+}
+
+//------------------------------------------------------------------------------
+void OperationQueue::finish(int id)
+{
+	for(int i=0; i<operations.size(); ++i)
+	{
+		Operation &op = operations[i];
+		if(op.id!=id)
+			continue;
+
+		// Dropped before it started, as when its target went away
+		if(op.state==STATE_RUNNING)
+			op.runMsecs = op.timer.elapsed();
+		op.state = STATE_FINISHED;
+		op.target = 0;
+
+		history.prepend(op);
+		while(history.size() > MAX_HISTORY)
+			history.removeLast();
+		operations.removeAt(i);
+
+		requestSchedule();
+		emit changed();
+		return;
+	}
+}
+
+//------------------------------------------------------------------------------
+bool OperationQueue::conflicts(const Operation &op, const Operation &other)
+{
+	return op.access==ACCESS_WRITE || other.access==ACCESS_WRITE;
+}
+
+//------------------------------------------------------------------------------
+// Background work also waits for any interactive operation to finish
+bool OperationQueue::canStart(const Operation &op) const
+{
+	foreach(const Operation &other, operations)
+	{
+		if(other.state!=STATE_RUNNING)
+			continue;
+		if(other.priority==PRIORITY_INTERACTIVE || conflicts(op, other))
+			return false;
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------------
+void OperationQueue::start(Operation &op)
+{
+	op.state = STATE_RUNNING;
+	op.waitMsecs = op.timer.restart();
+
+	// Queued, so that the handler runs outside of the scheduling
+	QMetaObject::invokeMethod(this, "dispatch", Qt::QueuedConnection, Q_ARG(int, op.id));
+}
+
+//------------------------------------------------------------------------------
+void OperationQueue::dispatch(int id)
+{
+	for(int i=0; i<operations.size(); ++i)
+	{
+		Operation &op = operations[i];
+		if(op.id!=id)
+			continue;
+
+		// Held since it was started. It starts over once released
+		if(holdCount>0)
+		{
+			op.state = STATE_PENDING;
+			emit changed();
+			return;
+		}
+
+		QPointer<QObject> target = op.target;
+		QByteArray member = op.member;
+		if(!target || !QMetaObject::invokeMethod(target, member.constData(), Qt::DirectConnection, Q_ARG(int, id)))
+			finish(id);
+		return;
+	}
+}
+
+//------------------------------------------------------------------------------
+void OperationQueue::requestSchedule()
+{
+	if(schedulePending)
+		return;
+
+	schedulePending = true;
+	QMetaObject::invokeMethod(this, "schedule", Qt::QueuedConnection);
+}
+
+//------------------------------------------------------------------------------
+void OperationQueue::schedule()
+{
+	schedulePending = false;
+	if(holdCount>0)
+		return;
+
+	bool started = false;
+	for(int i=0; i<operations.size(); ++i)
+	{
+		Operation &op = operations[i];
+		if(op.state!=STATE_PENDING)
+			continue;
+
+		if(!canStart(op))
+		{
+			// Later reads do not overtake a waiting write
+			if(op.access==ACCESS_WRITE)
+				break;
+			continue;
+		}
+
+		start(op);
+		started = true;
+	}
+
+	if(started)
+		emit changed();
+}
@@ -0,0 +1,129 @@
+#ifndef OPERATIONQUEUE_H
+#define OPERATIONQUEUE_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QPointer>
+#include <QElapsedTimer>
+
+//////////////////////////////////////////////////////////////////////////
+// OperationQueue
+// Schedules the fossil operations of a workspace. Interactive operations
+// start right away, and the running background operations they conflict
+// with are asked to stop via preempted(). Background operations wait
+// their turn in order, behind any interactive one, and a pending one with
+// the same key as a new request absorbs it. Reading operations run
+// concurrently, while a writing one runs alone. Every started operation
+// must be finish()ed.
+//////////////////////////////////////////////////////////////////////////
+class OperationQueue : public QObject
+{
+	Q_OBJECT
+public:
+	enum Priority
+	{
+		PRIORITY_INTERACTIVE,
+		PRIORITY_BACKGROUND
+	};
+
+	enum Access
+	{
+		ACCESS_READ,
+		ACCESS_WRITE
+	};
+
+	enum State
+	{
+		STATE_PENDING,
+		STATE_RUNNING,
+		STATE_FINISHED
+	};
+
+	struct Operation
+	{
+		int					id;
+		QString				title;
+		QString				key;
+		Priority			priority;
+		Access				access;
+		State				state;
+		QPointer<QObject>	target;
+		QByteArray			member;		// Invoked with the id once started
+		QElapsedTimer		timer;		// Since queued, then since started
+		qint64				waitMsecs;	// -1 until started
+		qint64				runMsecs;	// -1 until finished
+	};
+	typedef QList<Operation> operationlist_t;
+
+	explicit OperationQueue(QObject *parent=0);
+
+	// Queues background work. member is the name of a slot taking the
+	// operation id. Returns the id of the operation that will run it
+	int					enqueue(const QString &title, Access access, QObject *target, const char *member, const QString &key=QString());
+
+	// Starts interactive work now
+	int					begin(const QString &title, Access access);
+
+	// Holds back the start of queued operations, as while the GUI waits on
+	// fossil. Calls nest
+	void				hold();
+	void				release();
+
+	// The pending and running operations, then the recently finished ones
+	const operationlist_t	&getOperations() const { return operations; }
+	const operationlist_t	&getHistory() const { return history; }
+	bool				isIdle() const { return operations.isEmpty(); }
+
+public slots:
+	void				finish(int id);
+
+signals:
+	void				changed();
+	void				preempted(int id);
+
+private slots:
+	void				schedule();
+	void				dispatch(int id);
+
+private:
+	enum
+	{
+		MAX_HISTORY = 20
+	};
+
+	static bool			conflicts(const Operation &op, const Operation &other);
+	bool				canStart(const Operation &op) const;
+	void				start(Operation &op);
+	void				requestSchedule();
+
+	operationlist_t		operations;
+	operationlist_t		history;		// Most recent first
+	int					nextId;
+	int					holdCount;
+	bool				schedulePending;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// ScopedOperation
+// An interactive operation for the duration of a scope
+//////////////////////////////////////////////////////////////////////////
+class ScopedOperation
+{
+public:
+	ScopedOperation(OperationQueue &queue, const QString &title, OperationQueue::Access access)
+		: queue(queue), id(queue.begin(title, access))
+	{
+	}
+
+	~ScopedOperation()
+	{
+		queue.finish(id);
+	}
+
+private:
+	OperationQueue	&queue;
+	int				id;
+};
+
+#endif // OPERATIONQUEUE_H
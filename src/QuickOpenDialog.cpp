@@ -0,0 +1,93 @@
+#include "QuickOpenDialog.h"
+#include "ui_QuickOpenDialog.h"
+#include <QApplication>
+#include <QKeyEvent>
+#include <QDir>
+
+//-----------------------------------------------------------------------------
+QuickOpenDialog::QuickOpenDialog(QWidget *parent, FuzzyMatcher &matcher, const FileTable &files) :
+	QDialog(parent),
+	ui(new Ui::QuickOpenDialog),
+	matcher(matcher),
+	files(files)
+{
+	ui->setupUi(this);
+	ui->lineQuery->installEventFilter(this);
+}
+
+//-----------------------------------------------------------------------------
+QuickOpenDialog::~QuickOpenDialog()
+{
+	delete ui;
+}
+
+//-----------------------------------------------------------------------------
+bool QuickOpenDialog::run(QWidget *parent, FuzzyMatcher &matcher, const FileTable &files, QString &filePath)
+{
+	QuickOpenDialog dlg(parent, matcher, files);
+
+	// List the recent files
+	dlg.on_lineQuery_textChanged("");
+
+	if(dlg.exec() != QDialog::Accepted)
+		return false;
+
+	QListWidgetItem *item = dlg.ui->listResults->currentItem();
+	if(!item)
+		return false;
+
+	filePath = item->data(Qt::UserRole).toString();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+bool QuickOpenDialog::eventFilter(QObject *watched, QEvent *event)
+{
+	// Let the keyboard move through the results while typing
+	if(watched==ui->lineQuery && event->type()==QEvent::KeyPress)
+	{
+		int key = static_cast<QKeyEvent *>(event)->key();
+		if(key==Qt::Key_Up || key==Qt::Key_Down || key==Qt::Key_PageUp || key==Qt::Key_PageDown)
+		{
+			QApplication::sendEvent(ui->listResults, event);
+			return true;
+		}
+	}
+	return QDialog::eventFilter(watched, event);
+}
+
+//-----------------------------------------------------------------------------
+void QuickOpenDialog::on_lineQuery_textChanged(const QString &text)
+{
+	FuzzyMatcher::resultlist_t results;
+	matcher.match(text, MAX_RESULTS, results);
+
+	ui->listResults->setUpdatesEnabled(false);
+	ui->listResults->clear();
+	foreach(const FuzzyMatcher::Result &r, results)
+	{
+		QString name = files.getName(r.row);
+		QString dir = files.getDirPath(files.getDirId(r.row));
+
+		QListWidgetItem *item = new QListWidgetItem(dir.isEmpty() ? name : name + "    " + QDir::toNativeSeparators(dir));
+		item->setData(Qt::UserRole, files.getFilePath(r.row));
+		ui->listResults->addItem(item);
+	}
+
+	if(ui->listResults->count()>0)
+		ui->listResults->setCurrentRow(0);
+	ui->listResults->setUpdatesEnabled(true);
+}
+
+//-----------------------------------------------------------------------------
+void QuickOpenDialog::on_lineQuery_returnPressed()
+{
+	if(ui->listResults->currentItem())
+		accept();
+}
+
+//-----------------------------------------------------------------------------
+void QuickOpenDialog::on_listResults_itemDoubleClicked(QListWidgetItem *)
+{
+	accept();
+}
@@ -0,0 +1,40 @@
+#ifndef QUICKOPENDIALOG_H
+#define QUICKOPENDIALOG_H
+
+#include <QDialog>
+#include "FuzzyMatcher.h"
+
+namespace Ui {
+class QuickOpenDialog;
+}
+
+class QuickOpenDialog : public QDialog
+{
+	Q_OBJECT
+
+public:
+	explicit QuickOpenDialog(QWidget *parent, FuzzyMatcher &matcher, const FileTable &files);
+	~QuickOpenDialog();
+
+	static bool run(QWidget *parent, FuzzyMatcher &matcher, const FileTable &files, QString &filePath);
+
+protected:
+	bool eventFilter(QObject *watched, QEvent *event);
+
+private slots:
+	void on_lineQuery_textChanged(const QString &text);
+	void on_lineQuery_returnPressed();
+	void on_listResults_itemDoubleClicked(class QListWidgetItem *item);
+
+private:
+	enum
+	{
+		MAX_RESULTS = 50
+	};
+
+	Ui::QuickOpenDialog *ui;
+	FuzzyMatcher		&matcher;
+	const FileTable		&files;
+};
+
+#endif // QUICKOPENDIALOG_H
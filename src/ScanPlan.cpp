@@ -0,0 +1,81 @@
+#include "ScanPlan.h"
+#include <QStringList>
+#include <QObject>
+
+static const char *STEP_NAMES[] = { "listing", "changes", "tracked", "walk", "extras" };
+
+///////////////////////////////////////////////////////////////////////////////
+ScanPlan::ScanPlan(int content, bool checkoutDbAvailable)
+	: coverage(0)
+	, steps(0)
+{
+	for(int i=0; i<STEP_COUNT; ++i)
+		durations[i] = -1;
+
+	if(content & CONTENT_UNCHANGED)
+	{
+		steps |= STEP_LISTING;
+		coverage |= CONTENT_UNCHANGED|CONTENT_MODIFIED;
+	}
+	else if(content & CONTENT_MODIFIED)
+	{
+		steps |= STEP_CHANGES;
+		coverage |= CONTENT_MODIFIED;
+	}
+
+	if(content & CONTENT_UNKNOWN)
+	{
+		// The listing tells the tracked files apart already
+		if(steps & STEP_LISTING)
+			steps |= STEP_WALK;
+		else if(checkoutDbAvailable)
+			steps |= STEP_WALK|STEP_TRACKED;
+		else
+			steps |= STEP_EXTRAS;
+
+		coverage |= content & (CONTENT_UNKNOWN|CONTENT_IGNORED);
+	}
+}
+
+//------------------------------------------------------------------------------
+int ScanPlan::indexOf(Step step)
+{
+	for(int i=0; i<STEP_COUNT; ++i)
+	{
+		if(step == 1<<i)
+			return i;
+	}
+	Q_ASSERT(0);
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+void ScanPlan::fallBackToExtras()
+{
+	steps &= ~(STEP_WALK|STEP_TRACKED);
+	steps |= STEP_EXTRAS;
+}
+
+//------------------------------------------------------------------------------
+void ScanPlan::setDuration(Step step, qint64 msecs)
+{
+	durations[indexOf(step)] = msecs;
+}
+
+//------------------------------------------------------------------------------
+QString ScanPlan::describe() const
+{
+	QStringList names;
+	QStringList timings;
+	for(int i=0; i<STEP_COUNT; ++i)
+	{
+		if(!(steps & (1<<i)))
+			continue;
+
+		names << STEP_NAMES[i];
+		if(durations[i]>=0)
+			timings << QObject::tr("%0 %1 ms").arg(STEP_NAMES[i]).arg(durations[i]);
+	}
+
+	return QObject::tr("Scan plan %0 (%1)").arg(names.join("+")).arg(timings.join(", "));
+}
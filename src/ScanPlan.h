@@ -0,0 +1,59 @@
+#ifndef SCANPLAN_H
+#define SCANPLAN_H
+
+#include <QString>
+
+//////////////////////////////////////////////////////////////////////////
+// ScanPlan
+// The least work needed to list the file types of the current view.
+// Unchanged files need the full listing of the tracked files, modified
+// ones only the changes, and unknown files either a filesystem walk
+// checked against the tracked files, or fossil extras.
+//////////////////////////////////////////////////////////////////////////
+class ScanPlan
+{
+public:
+	enum Content
+	{
+		CONTENT_UNKNOWN		= 1<<0,
+		CONTENT_IGNORED		= 1<<1,
+		CONTENT_MODIFIED	= 1<<2,
+		CONTENT_UNCHANGED	= 1<<3,
+		CONTENT_ALL			= CONTENT_UNKNOWN|CONTENT_IGNORED|CONTENT_MODIFIED|CONTENT_UNCHANGED
+	};
+
+	enum Step
+	{
+		STEP_LISTING	= 1<<0,	// All tracked files
+		STEP_CHANGES	= 1<<1,	// Modified tracked files
+		STEP_TRACKED	= 1<<2,	// Names of the tracked files from the checkout database
+		STEP_WALK		= 1<<3,	// Filesystem walk
+		STEP_EXTRAS		= 1<<4	// Unknown files from fossil extras
+	};
+
+	ScanPlan(int content, bool checkoutDbAvailable);
+
+	// The content the plan produces, which may exceed the requested one
+	int					getCoverage() const { return coverage; }
+	bool				hasStep(Step step) const { return (steps & step)!=0; }
+
+	// Replace the walk with fossil extras when the tracked files are not available
+	void				fallBackToExtras();
+
+	void				setDuration(Step step, qint64 msecs);
+	QString				describe() const;
+
+private:
+	enum
+	{
+		STEP_COUNT = 5
+	};
+
+	static int			indexOf(Step step);
+
+	int					coverage;
+	int					steps;
+	qint64				durations[STEP_COUNT];
+};
+
+#endif // SCANPLAN_H
@@ -0,0 +1,306 @@
+#include "ScanWorker.h"
+#include <QtConcurrent/QtConcurrentRun>
+#include <QDir>
+#include <QFileInfo>
+#include "Fossil.h"
+#include "ScanPlan.h"
+#include "GlobMatcher.h"
+#include "DirectoryWalker.h"
+
+//////////////////////////////////////////////////////////////////////////
+// ScanWorker::Callback
+// Forwards the log to the GUI thread and aborts fossil on cancellation
+//////////////////////////////////////////////////////////////////////////
+class ScanWorker::Callback : public UICallback
+{
+public:
+	Callback(ScanWorker &worker) : worker(worker)
+	{
+	}
+
+	virtual void logText(const QString &text, bool isHTML) { emit worker.logged(text, isHTML); }
+	virtual void beginProcess(const QString &/*text*/) {}
+	virtual void updateProcess(const QString &/*text*/) {}
+	virtual bool processAborted() const { return worker.isCancelled(); }
+	virtual void endProcess() {}
+	virtual QMessageBox::StandardButton Query(const QString &/*title*/, const QString &/*query*/, QMessageBox::StandardButtons /*buttons*/)
+	{
+		return QMessageBox::No;
+	}
+
+private:
+	ScanWorker &worker;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// ScanWorker::ListingVisitor
+// Publishes each file as it is listed
+//////////////////////////////////////////////////////////////////////////
+class ScanWorker::ListingVisitor : public FileListVisitor
+{
+public:
+	ListingVisitor(ScanWorker &worker, const GlobMatcher *ignoreMatcher=0) : worker(worker), ignoreMatcher(ignoreMatcher)
+	{
+	}
+
+	void onFile(WorkspaceFile::Type type, const QString &fname)
+	{
+		// Tracked files are never ignored. Only a listing along with the
+		// extras has any others
+		bool ignored = type==WorkspaceFile::TYPE_UNKNOWN && ignoreMatcher && ignoreMatcher->matchesPath(fname);
+		worker.publish(fname, type, ignored);
+	}
+
+private:
+	ScanWorker &worker;
+	const GlobMatcher *ignoreMatcher;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// WalkTask
+// Runs a DirectoryWalker on a worker thread
+//////////////////////////////////////////////////////////////////////////
+class WalkTask
+{
+public:
+	typedef bool result_type;
+
+	WalkTask(DirectoryWalker &walker, DirectoryWalker::entrylist_t &entries, qint64 &msecs)
+		: walker(walker)
+		, entries(entries)
+		, msecs(msecs)
+	{
+	}
+
+	bool operator()()
+	{
+		QElapsedTimer timer;
+		timer.start();
+		bool ok = walker.walk(entries);
+		msecs = timer.elapsed();
+		return ok;
+	}
+
+private:
+	DirectoryWalker					&walker;
+	DirectoryWalker::entrylist_t	&entries;
+	qint64							&msecs;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+ScanWorker::ScanWorker(const QString &workspacePath, const QString &repositoryFile, const QString &fossilExe,
+					   bool verifyChanges, const QStringList &ignorePatterns, int viewContent, int tableSize, QObject *parent)
+	: QThread(parent)
+	, workspacePath(workspacePath)
+	, repositoryFile(repositoryFile)
+	, fossilExe(fossilExe)
+	, verifyChanges(verifyChanges)
+	, ignorePatterns(ignorePatterns)
+	, viewContent(viewContent)
+	, tableSize(tableSize)
+	, signalled(false)
+	, success(false)
+	, coverage(0)
+	, integrating(false)
+{
+}
+
+//------------------------------------------------------------------------------
+ScanWorker::~ScanWorker()
+{
+	cancel();
+	wait();
+}
+
+//------------------------------------------------------------------------------
+void ScanWorker::takeBatch(entrylist_t &entries)
+{
+	QMutexLocker lock(&batchMutex);
+	entries.clear();
+	entries.swap(batch);
+	signalled = false;
+}
+
+//------------------------------------------------------------------------------
+void ScanWorker::publish(const QString &path, WorkspaceFile::Type type, bool ignored)
+{
+	Entry e = { path, type, ignored };
+	pending.append(e);
+	found.insert(path);
+	flush(false);
+}
+
+//------------------------------------------------------------------------------
+void ScanWorker::flush(bool force)
+{
+	if(pending.isEmpty())
+		return;
+
+	int rows = qMax(tableSize, found.size());
+	if(!force && batchTimer.elapsed() < BATCH_INTERVAL_MS * (1 + rows/BATCH_BACKOFF_FILES))
+		return;
+
+	bool notify = false;
+	{
+		QMutexLocker lock(&batchMutex);
+		batch += pending;
+		notify = !signalled;
+		signalled = true;
+	}
+	pending.clear();
+	batchTimer.restart();
+
+	// One queued signal at a time, the receiver takes everything there is
+	if(notify)
+		emit batchReady();
+}
+
+//------------------------------------------------------------------------------
+void ScanWorker::run()
+{
+	Callback callback(*this);
+	success = scan(callback);
+	flush(true);
+}
+
+//------------------------------------------------------------------------------
+bool ScanWorker::scan(UICallback &callback)
+{
+	Fossil bridge;
+	bridge.Init(&callback, fossilExe);
+	bridge.setWorkspace(workspacePath);
+	bridge.setVerifyChanges(verifyChanges);
+
+	// Only gather what the view filter needs
+	ScanPlan plan(viewContent, bridge.hasCheckoutDb());
+	bool include_ignored = (plan.getCoverage() & ScanPlan::CONTENT_IGNORED)!=0;
+
+	ListingVisitor listing(*this);
+	GlobMatcher ignore_matcher(ignorePatterns);
+	DirectoryWalker walker(workspacePath, ignore_matcher, include_ignored);
+	DirectoryWalker::entrylist_t walked_files;
+	stringset_t tracked_files;
+	QStringList extra_files;
+	qint64 walk_msecs = -1;
+	QFuture<bool> walk;
+	QElapsedTimer timer;
+	QElapsedTimer progress_timer;
+	bool ok = true;
+	bool extras_listed = false;
+
+	batchTimer.start();
+
+	// Walk the filesystem while fossil lists the tracked files
+	if(plan.hasStep(ScanPlan::STEP_WALK))
+		walk = QtConcurrent::run(WalkTask(walker, walked_files, walk_msecs));
+
+	if(plan.hasStep(ScanPlan::STEP_LISTING))
+	{
+		timer.start();
+		ok = bridge.listFiles(listing);
+		plan.setDuration(ScanPlan::STEP_LISTING, timer.elapsed());
+	}
+	else if(plan.hasStep(ScanPlan::STEP_CHANGES))
+	{
+		timer.start();
+
+		// Newer fossils list the extras along with the changes in one pass
+		if(plan.hasStep(ScanPlan::STEP_EXTRAS) && bridge.getCapabilities().has(FossilCapabilities::FEATURE_CHANGES_DIFFER))
+		{
+			ListingVisitor differ(*this, &ignore_matcher);
+			ok = bridge.listChangesAndExtras(differ, include_ignored);
+			extras_listed = true;
+		}
+		else
+			ok = bridge.listChanges(listing);
+		plan.setDuration(ScanPlan::STEP_CHANGES, timer.elapsed());
+	}
+
+	// Show the tracked files while the walk completes
+	flush(true);
+
+	if(ok && !isCancelled() && plan.hasStep(ScanPlan::STEP_TRACKED))
+	{
+		timer.start();
+		if(bridge.listTrackedFiles(tracked_files))
+			plan.setDuration(ScanPlan::STEP_TRACKED, timer.elapsed());
+		else
+			plan.fallBackToExtras();
+	}
+
+	if(!plan.hasStep(ScanPlan::STEP_WALK) || !ok || isCancelled())
+		walker.abort();
+
+	if(ok && !isCancelled() && plan.hasStep(ScanPlan::STEP_EXTRAS) && !extras_listed)
+	{
+		timer.start();
+		ok = bridge.listExtras(extra_files, include_ignored);
+		plan.setDuration(ScanPlan::STEP_EXTRAS, timer.elapsed());
+	}
+
+	progress_timer.start();
+	while(walk.isRunning())
+	{
+		if(isCancelled())
+			walker.abort();
+
+		if(progress_timer.elapsed() >= PROGRESS_INTERVAL_MS)
+		{
+			emit progress(QObject::tr("%0 directories").arg(walker.getDirectoryCount()));
+			progress_timer.restart();
+		}
+		msleep(10);
+	}
+
+	if(plan.hasStep(ScanPlan::STEP_WALK))
+	{
+		ok = ok && walk.result();
+		plan.setDuration(ScanPlan::STEP_WALK, walk_msecs);
+	}
+
+	if(!ok || isCancelled())
+		return false;
+
+	if(plan.hasStep(ScanPlan::STEP_WALK))
+	{
+		QString repository_path;
+		if(!repositoryFile.isEmpty())
+			repository_path = QDir(workspacePath).relativeFilePath(QFileInfo(repositoryFile).absoluteFilePath());
+
+		foreach(const DirectoryWalker::Entry &e, walked_files)
+		{
+			if(isCancelled())
+				return false;
+
+			// Skip fossil files
+			QString filename = e.path.mid(e.path.lastIndexOf('/')+1);
+			if(filename == FOSSIL_CHECKOUT1 || filename == FOSSIL_CHECKOUT2 || e.path == repository_path)
+				continue;
+
+			// Skip tracked files
+			if(found.contains(e.path) || tracked_files.contains(e.path))
+				continue;
+
+			publish(e.path, WorkspaceFile::TYPE_UNKNOWN, e.ignored);
+		}
+	}
+
+	foreach(const QString &f, extra_files)
+	{
+		if(isCancelled())
+			return false;
+
+		if(found.contains(f))
+			continue;
+
+		publish(f, WorkspaceFile::TYPE_UNKNOWN, ignore_matcher.matchesPath(f));
+	}
+
+	coverage = plan.getCoverage();
+	description = plan.describe();
+
+	// Check if the repository needs integration
+	integrating = false;
+	bridge.getIntegrationState(integrating);
+	return true;
+}
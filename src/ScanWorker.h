@@ -0,0 +1,96 @@
+#ifndef SCANWORKER_H
+#define SCANWORKER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QVector>
+#include "Utils.h"
+#include "WorkspaceCommon.h"
+
+//////////////////////////////////////////////////////////////////////////
+// ScanWorker
+// Gathers the files of a workspace on its own thread, with its own
+// Fossil instance. The files found are handed over in batches so that
+// the views fill in while the scan runs; batchReady() is emitted at most
+// every BATCH_INTERVAL_MS, and less often as the table grows, since each
+// batch updates the whole view. The results are read once the thread has
+// finished.
+//////////////////////////////////////////////////////////////////////////
+class ScanWorker : public QThread
+{
+	Q_OBJECT
+public:
+	struct Entry
+	{
+		QString				path;
+		WorkspaceFile::Type	type;
+		bool				ignored;
+	};
+	typedef QVector<Entry> entrylist_t;
+
+	ScanWorker(const QString &workspacePath, const QString &repositoryFile, const QString &fossilExe,
+			   bool verifyChanges, const QStringList &ignorePatterns, int viewContent, int tableSize, QObject *parent=0);
+	~ScanWorker();
+
+	void				cancel() { cancelled.store(1); }
+	bool				isCancelled() const { return cancelled.load()!=0; }
+
+	// Moves the files found since the last call to entries
+	void				takeBatch(entrylist_t &entries);
+
+	// Valid once the thread has finished
+	bool				succeeded() const { return success; }
+	int					getCoverage() const { return coverage; }
+	const QString		&getDescription() const { return description; }
+	bool				isIntegrating() const { return integrating; }
+
+signals:
+	void				batchReady();
+	void				progress(const QString &text);
+	void				logged(const QString &text, bool isHTML);
+
+protected:
+	void				run();
+
+private:
+	class Callback;
+	class ListingVisitor;
+
+	enum
+	{
+		BATCH_INTERVAL_MS		= 200,
+		BATCH_BACKOFF_FILES		= 20000,	// Each this many files in the table add BATCH_INTERVAL_MS
+		PROGRESS_INTERVAL_MS	= 250	// Rate of the progress updates while waiting on the directory walk
+	};
+
+	bool				scan(UICallback &callback);
+	void				publish(const QString &path, WorkspaceFile::Type type, bool ignored);
+	void				flush(bool force);
+
+	QString				workspacePath;
+	QString				repositoryFile;
+	QString				fossilExe;
+	bool				verifyChanges;
+	QStringList			ignorePatterns;
+	int					viewContent;
+	int					tableSize;		// Rows the table had before the scan
+	QAtomicInt			cancelled;
+
+	entrylist_t			pending;		// Found since the last flush, only used by the thread
+	stringset_t			found;			// All the paths found, so the unknown files skip them
+	QElapsedTimer		batchTimer;
+
+	QMutex				batchMutex;
+	entrylist_t			batch;			// Flushed, but not taken yet
+	bool				signalled;		// batchReady() was emitted since the last take
+
+	bool				success;
+	int					coverage;
+	QString				description;
+	bool				integrating;
+};
+
+#endif // SCANWORKER_H
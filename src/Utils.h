@@ -53,10 +53,6 @@ QStringList					QuotePaths(const QStringList &paths);
 QString						SelectExe(QWidget *parent, const QString &description);
 
 
-typedef QMap<QString, QModelIndex> name_modelindex_map_t;
-void						GetStandardItemTextRecursive(QString &name, const QStandardItem &item, const QChar &separator='/');
-void						BuildNameToModelIndex(name_modelindex_map_t &map, const QStandardItem &item);
-void						BuildNameToModelIndex(name_modelindex_map_t &map, const QStandardItemModel &model);
 bool						KeychainSet(QObject* parent, const QUrl& url, QSettings &settings);
 bool						KeychainGet(QObject* parent, QUrl& url, QSettings &settings);
 bool						KeychainDelete(QObject* parent, const QUrl& url, QSettings &settings);
@@ -1,9 +1,21 @@
 #include "Workspace.h"
-#include <QCoreApplication>
+#include <QSaveFile>
+#include <QDataStream>
 #include "Utils.h"
 
+// Identifies the snapshot files, and their layout
+static const quint32	SNAPSHOT_MAGIC = 0x4655454C;	// FUEL
+static const quint32	SNAPSHOT_VERSION = 2;
+
 //-----------------------------------------------------------------------------
 Workspace::Workspace()
+	: viewUnknown(true)
+	, viewIgnored(true)
+	, viewModified(true)
+	, viewUnchanged(true)
+	, coverage(0)
+	, fromSnapshot(false)
+	, repoFileModel(files)
 {
 }
 //-----------------------------------------------------------------------------
@@ -16,17 +28,18 @@ Workspace::~Workspace()
 //------------------------------------------------------------------------------
 void Workspace::clearState()
 {
-	// Dispose RepoFiles
-	foreach(WorkspaceFile *r, getFiles())
-		delete r;
-
+	cancelScan();
+	repoFileModel.clear();
 	getFiles().clear();
-	getPaths().clear();
-	pathState.clear();
+	dirTree.clear();
 	stashMap.clear();
 	branchNames.clear();
+	branchTips.clear();
 	tags.clear();
 	isIntegrated = false;
+	coverage = 0;
+	fromSnapshot = false;
+	repoFileModel.setMarkStale(false);
 }
 
 //------------------------------------------------------------------------------
@@ -65,6 +78,7 @@ bool Workspace::switchWorkspace(const QString& workspace, QSettings &store)
 	storeWorkspace(store);
 	clearState();
 	remotes.clear();
+	invalidateMetadata();
 
 	fossil().setWorkspace("");
 	if(workspace.isEmpty())
@@ -99,6 +113,8 @@ bool Workspace::switchWorkspace(const QString& workspace, QSettings &store)
 	store.endArray();
 	store.endGroup();
 
+	loadSnapshot();
+
 #if 0 // FIXME: Disabled this because if fossil's remote does not match exactly what we have stored (url and username), it will be automatically added every-time
 	// Add the default url from fossil
 	QUrl default_remote;
@@ -120,247 +136,350 @@ bool Workspace::switchWorkspace(const QString& workspace, QSettings &store)
 }
 
 //------------------------------------------------------------------------------
-bool Workspace::scanDirectory(QFileInfoList &entries, const QString& dirPath, const QString &baseDir, const QStringList &ignorePatterns, UICallback &uiCallback)
+void Workspace::setViewFilter(bool showUnknown, bool showIgnored, bool showModified, bool showUnchanged)
 {
-	QDir dir(dirPath);
-
-	uiCallback.updateProcess(dirPath);
-
-	QFileInfoList list = dir.entryInfoList(QDir::Dirs | QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot);
-	for (int i=0; i<list.count(); ++i)
-	{
-		if(uiCallback.processAborted())
-			return false;
+	viewUnknown = showUnknown;
+	viewIgnored = showIgnored;
+	viewModified = showModified;
+	viewUnchanged = showUnchanged;
+	applyViewFilter();
+}
 
-		QFileInfo info = list[i];
-		QString filepath = info.filePath();
-		QString rel_path = filepath;
-		rel_path.remove(baseDir+PATH_SEPARATOR);
+//------------------------------------------------------------------------------
+bool Workspace::isVisible(const WorkspaceFile &file) const
+{
+	WorkspaceFile::Type type = file.getType();
+	if(type & WorkspaceFile::TYPE_UNKNOWN)
+		return viewUnknown && (viewIgnored || !file.isIgnored());
+	if(type & WorkspaceFile::TYPE_MODIFIED)
+		return viewModified;
+	if(type & WorkspaceFile::TYPE_UNCHANGED)
+		return viewUnchanged;
+	return true;
+}
 
-		// Skip ignored files
-		if(!ignorePatterns.isEmpty() && QDir::match(ignorePatterns, rel_path))
-			continue;
+//------------------------------------------------------------------------------
+int Workspace::getViewContent() const
+{
+	int content = 0;
+	if(viewUnknown)
+		content |= ScanPlan::CONTENT_UNKNOWN | (viewIgnored ? ScanPlan::CONTENT_IGNORED : 0);
+	if(viewModified)
+		content |= ScanPlan::CONTENT_MODIFIED;
+	if(viewUnchanged)
+		content |= ScanPlan::CONTENT_UNCHANGED;
+	return content;
+}
 
-		if (info.isDir())
-		{
-			if(!scanDirectory(entries, filepath, baseDir, ignorePatterns, uiCallback))
-				return false;
-		}
-		else
-			entries.push_back(info);
-	}
-	return true;
+//------------------------------------------------------------------------------
+bool Workspace::isViewCovered() const
+{
+	return (getViewContent() & ~coverage)==0;
 }
 
 //------------------------------------------------------------------------------
-static bool StringLengthDescending(const QString &l, const QString &r)
+// Rebuild the directories and their state from the visible files
+void Workspace::applyViewFilter()
 {
-	return l.length() > r.length();
+	QVector<int> rows;
+	rows.reserve(files.size());
+	for(FileTable::const_iterator it=files.begin(); it!=files.end(); ++it)
+	{
+		if(isVisible(*it))
+			rows.append(it.getRow());
+	}
+
+	dirTree.build(files, rows);
 }
 
 //------------------------------------------------------------------------------
-void Workspace::scanWorkspace(bool scanLocal, bool scanIgnored, bool scanModified, bool scanUnchanged, const QStringList &ignorePatterns, UICallback &uiCallback)
+ScanWorker *Workspace::beginScan(const QStringList &ignorePatterns, QObject *workerParent)
 {
-	// Scan all workspace files
-	QFileInfoList all_files;
-	QString wkdir = fossil().getWorkspacePath();
+	cancelScan();
 
+	QString wkdir = fossil().getWorkspacePath();
 	if(wkdir.isEmpty())
-		return;
+		return 0;
 
-	// Retrieve the status of files tracked by fossil
-	QStringList res;
-	if(!fossil().listFiles(res))
-		return;
+	// Rows of files that are still there keep their ids
+	files.setRootPath(wkdir);
+	files.beginUpdate();
+	repoFileModel.setMarkStale(fromSnapshot);
+	ignoreMatcher = GlobMatcher(ignorePatterns);
 
-	bool scan_files = scanLocal;
+	scanWorker = new ScanWorker(wkdir, fossil().getRepositoryFile(), fossil().getExePath(), fossil().getVerifyChanges(),
+								ignorePatterns, getViewContent(), files.size(), workerParent);
+	return scanWorker;
+}
 
-	clearState();
+//------------------------------------------------------------------------------
+// Adds the files found so far. False if nothing changed
+bool Workspace::applyScanBatch(ScanWorker *worker)
+{
+	if(!worker || worker!=scanWorker)
+		return false;
 
-	QStringList paths;
+	ScanWorker::entrylist_t entries;
+	worker->takeBatch(entries);
+	if(entries.isEmpty())
+		return false;
 
-	uiCallback.beginProcess("");
-	if(scan_files)
-	{
-		QCoreApplication::processEvents();
+	foreach(const ScanWorker::Entry &e, entries)
+		files.insert(e.path, e.type, e.ignored);
 
-		QStringList ignore;
-		if(!scanIgnored)
-			ignore = ignorePatterns;
+	applyViewFilter();
+	return true;
+}
 
-		if(!scanDirectory(all_files, wkdir, wkdir, ignore, uiCallback))
-			goto _done;
+//------------------------------------------------------------------------------
+// False if the worker was superseded, in which case nothing changes
+bool Workspace::finishScan(ScanWorker *worker, UICallback &uiCallback)
+{
+	if(!worker || worker!=scanWorker)
+		return false;
+	scanWorker = 0;
 
-		for(QFileInfoList::iterator it=all_files.begin(); it!=all_files.end(); ++it)
+	if(!worker->succeeded())
+	{
+		// Keep the previous listing, with the rows seen so far updated.
+		// The rows of a snapshot stay marked until a scan completes
+		if(!fromSnapshot)
 		{
-			QString filename = it->fileName();
-			QString fullpath = it->absoluteFilePath();
-
-			// Skip fossil files
-			if(filename == FOSSIL_CHECKOUT1 || filename == FOSSIL_CHECKOUT2 || (!fossil().getRepositoryFile().isEmpty() && QFileInfo(fullpath) == QFileInfo(fossil().getRepositoryFile())))
-				continue;
-
-			WorkspaceFile::Type type = WorkspaceFile::TYPE_UNKNOWN;
-
-			WorkspaceFile *rf = new WorkspaceFile(*it, type, wkdir);
-			const QString &path = rf->getPath();
-			getFiles().insert(rf->getFilePath(), rf);
-			getPaths().insert(path);
-
-			// Add or merge file state into directory state
-			pathstate_map_t::iterator state_it = pathState.find(path);
-			if(state_it != pathState.end())
-				state_it.value() = static_cast<WorkspaceFile::Type>(state_it.value() | type);
-			else
-			{
-				pathState.insert(path, type);
-				paths.append(path); // keep path in list for depth sort
-			}
+			files.cancelUpdate();
+			repoFileModel.setMarkStale(false);
 		}
+		applyViewFilter();
+		return true;
 	}
-	uiCallback.endProcess();
-
-	uiCallback.beginProcess(QObject::tr("Updating..."));
 
-	// Update Files and Directories
-	for(QStringList::iterator line_it=res.begin(); line_it!=res.end(); ++line_it)
-	{
-		QString line = (*line_it).trimmed();
-		if(line.length()==0)
-			continue;
+	ScanWorker::entrylist_t entries;
+	worker->takeBatch(entries);
+	foreach(const ScanWorker::Entry &e, entries)
+		files.insert(e.path, e.type, e.ignored);
 
-		int space_index = line.indexOf(' ');
-		if(space_index==-1)
-			continue;
+	files.endUpdate();
+	fromSnapshot = false;
+	repoFileModel.setMarkStale(false);
+	coverage = worker->getCoverage();
+	applyViewFilter();
+	uiCallback.logText(worker->getDescription()+"\n", false);
+	if(files.size())
+		uiCallback.logText(QObject::tr("File table %0 files, %1 bytes per file").arg(files.size()).arg(files.getMemoryUsage()/files.size())+"\n", false);
 
-		QString status_text = line.left(space_index);
-		QString fname = line.right(line.length() - space_index).trimmed();
-		WorkspaceFile::Type type = WorkspaceFile::TYPE_UNKNOWN;
+	isIntegrated = worker->isIntegrating();
 
-		// Generate a RepoFile for all non-existant fossil files
-		// or for all files if we skipped scanning the workspace
-		bool add_missing = !scan_files;
+	loadMetadata();
 
-		if(status_text=="EDITED")
-			type = WorkspaceFile::TYPE_EDITTED;
-		else if(status_text=="ADDED")
-			type = WorkspaceFile::TYPE_ADDED;
-		else if(status_text=="DELETED")
-		{
-			type = WorkspaceFile::TYPE_DELETED;
-			add_missing = true;
-		}
-		else if(status_text=="MISSING")
-		{
-			type = WorkspaceFile::TYPE_MISSING;
-			add_missing = true;
-		}
-		else if(status_text=="RENAMED")
-			type = WorkspaceFile::TYPE_RENAMED;
-		else if(status_text=="UNCHANGED")
-			type = WorkspaceFile::TYPE_UNCHANGED;
-		else if(status_text=="CONFLICT")
-			type = WorkspaceFile::TYPE_CONFLICTED;
-		else if(status_text=="UPDATED_BY_MERGE" || status_text=="ADDED_BY_MERGE" || status_text=="ADDED_BY_INTEGRATE" || status_text=="UPDATED_BY_INTEGRATE")
-			type = WorkspaceFile::TYPE_MERGED;
-
-		// Filter unwanted file types
-		if( ((type & WorkspaceFile::TYPE_MODIFIED) && !scanModified) ||
-			((type & WorkspaceFile::TYPE_UNCHANGED) && !scanUnchanged))
-		{
-			getFiles().remove(fname);
-			continue;
-		}
-		else
-			add_missing = true;
+	{
+		int lookups = metadata.getHits() + metadata.getMisses();
+		uiCallback.logText(QObject::tr("Metadata cache hit rate %0% (%1 of %2)").arg(metadata.getHits()*100/lookups).arg(metadata.getHits()).arg(lookups)+"\n", false);
+	}
 
-		filemap_t::iterator it = getFiles().find(fname);
+	storeSnapshot();
+	return true;
+}
 
-		WorkspaceFile *rf = 0;
-		if(add_missing && it==getFiles().end())
-		{
-			QFileInfo info(wkdir+QDir::separator()+fname);
-			rf = new WorkspaceFile(info, type, wkdir);
-			getFiles().insert(rf->getFilePath(), rf);
-		}
+//------------------------------------------------------------------------------
+bool Workspace::applyWatchedChanges(WorkspaceWatcher &watcher)
+{
+	WorkspaceWatcher::changelist_t changes;
+	watcher.takeChanges(changes);
+	if(changes.isEmpty() || getPath().isEmpty())
+		return false;
 
-		if(!rf)
-		{
-			it = getFiles().find(fname);
-			Q_ASSERT(it!=getFiles().end());
-			rf = *it;
-		}
+	applyChanges(changes);
+	applyViewFilter();
+	return true;
+}
 
-		rf->setType(type);
+//------------------------------------------------------------------------------
+// Re-queries only the listed files and the metadata categories, along with
+// the checkout state if it changed. False if that cannot be done without a
+// full scan, as for directories
+bool Workspace::refreshFiles(const QStringList &paths, int categories, bool checkoutChanged)
+{
+	if(getPath().isEmpty() || isScanning())
+		return false;
 
-		QString path = rf->getPath();
-		getPaths().insert(path);
+	stringset_t path_set;
+	foreach(const QString &p, paths)
+	{
+		QString path = QDir::fromNativeSeparators(p);
+		if(QFileInfo(getPath() + PATH_SEPARATOR + path).isDir())
+			return false;
+		path_set.insert(path);
+	}
 
-		// Add or merge file state into directory state
-		pathstate_map_t::iterator state_it = pathState.find(path);
-		if(state_it != pathState.end())
-			state_it.value() = static_cast<WorkspaceFile::Type>(state_it.value() | type);
-		else
-		{
-			pathState.insert(path, type);
-			paths.append(path); // keep path in list for depth sort
-		}
+	if(!path_set.isEmpty())
+	{
+		WorkspaceWatcher::changelist_t changes;
+		if(!WorkspaceWatcher::queryStatus(fossil(), ignoreMatcher, path_set, changes))
+			return false;
+		applyChanges(changes);
 	}
 
-	// Sort paths, so that children (longer path) are before parents (shorter path)
-	std::sort(paths.begin(), paths.end(), StringLengthDescending);
-	foreach(const QString &p, paths)
+	if(checkoutChanged)
 	{
-		pathstate_map_t::iterator state_it = pathState.find(p);
-		Q_ASSERT(state_it != pathState.end());
-		WorkspaceFile::Type state = state_it.value();
+		if(getState()!=WORKSPACE_STATE_OK)
+			return false;
+		fossil().getIntegrationState(isIntegrated);
+	}
 
-		// Propagate child dir state to parents
-		QString parent_path = p;
-		while(!parent_path.isEmpty())
-		{
-			// Extract parent path
-			int sep_index = parent_path.lastIndexOf(PATH_SEPARATOR);
-			if(sep_index>=0)
-				parent_path = parent_path.left(sep_index);
-			else
-				parent_path = "";
-
-			// Merge path of child to parent
-			pathstate_map_t::iterator state_it = pathState.find(parent_path);
-			if(state_it != pathState.end())
-				state_it.value() = static_cast<WorkspaceFile::Type>(state_it.value() | state);
-			else
-				pathState.insert(parent_path, state);
-		}
+	if(categories)
+	{
+		invalidateMetadata(categories);
+		loadMetadata();
 	}
 
-	// Check if the repository needs integration
-	res.clear();
-	fossil().statusWorkspace(res);
-	isIntegrated = false;
-	foreach(const QString &l, res)
+	applyViewFilter();
+	return true;
+}
+
+//------------------------------------------------------------------------------
+void Workspace::applyChanges(const WorkspaceWatcher::changelist_t &changes)
+{
+	foreach(const WorkspaceWatcher::Change &c, changes)
 	{
-		if(l.trimmed().indexOf("INTEGRATE")==0)
+		int row = files.find(c.path);
+		if(c.type==WorkspaceFile::TYPE_UNKNOWN && !c.exists)
 		{
-			isIntegrated = true;
-			break;
+			if(row>=0)
+				files.remove(row);
+			continue;
 		}
+
+		row = files.insert(c.path, c.type, c.ignored);
+		files.invalidateStat(row);
 	}
+}
+
+//------------------------------------------------------------------------------
+// Loads the stashes, branches and tags, from the cache where still valid
+void Workspace::loadMetadata()
+{
+	metadata.setPaths(getPath(), fossil().getRepositoryFile());
 
-	// Load the stashes, branches and tags
-	fossil().stashList(getStashes());
+	if(!metadata.lookup(MetadataCache::CATEGORY_STASHES) && fossil().stashList(metadata.getStashes()))
+		metadata.store(MetadataCache::CATEGORY_STASHES);
+	stashMap = metadata.getStashes();
 
-	fossil().branchList(branchNames, branchNames);
+	if(!metadata.lookup(MetadataCache::CATEGORY_BRANCHES) && fossil().branchList(metadata.getBranches(), metadata.getBranches(), &metadata.getBranchTips()))
+		metadata.store(MetadataCache::CATEGORY_BRANCHES);
+	branchNames = metadata.getBranches();
+	branchTips = metadata.getBranchTips();
+
+	if(!metadata.lookup(MetadataCache::CATEGORY_TAGS) && fossil().tagList(metadata.getTags()))
+		metadata.store(MetadataCache::CATEGORY_TAGS);
+	tags = metadata.getTags();
 
-	fossil().tagList(tags);
 	// Fossil includes the branches in the tag list
 	// So remove them
 	foreach(const QString &name, branchNames)
 		tags.remove(name);
+}
+
+//------------------------------------------------------------------------------
+// The scan stops and fails, leaving the previous files in place
+void Workspace::abortScan()
+{
+	if(scanWorker)
+		scanWorker->cancel();
+}
+
+//------------------------------------------------------------------------------
+// The worker is left to stop on its own, its results are ignored
+void Workspace::cancelScan()
+{
+	if(scanWorker)
+		scanWorker->cancel();
+	scanWorker = 0;
+}
+
+//------------------------------------------------------------------------------
+QString Workspace::getSnapshotFile() const
+{
+	if(snapshotDir.isEmpty() || getPath().isEmpty())
+		return QString();
+	return snapshotDir + PATH_SEPARATOR + HashString(QDir::toNativeSeparators(getPath())) + ".snapshot";
+}
+
+//------------------------------------------------------------------------------
+// The directories and their state are rebuilt from the files, so only the
+// files and the metadata are stored
+bool Workspace::storeSnapshot() const
+{
+	QString filename = getSnapshotFile();
+	if(filename.isEmpty() || !QDir().mkpath(snapshotDir))
+		return false;
+
+	QSaveFile file(filename);
+	if(!file.open(QIODevice::WriteOnly))
+		return false;
+
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_5_4);
+	out << SNAPSHOT_MAGIC << SNAPSHOT_VERSION;
+	out << getPath() << qint32(coverage) << isIntegrated;
+	files.save(out);
+	metadata.save(out);
+
+	if(out.status()!=QDataStream::Ok)
+	{
+		file.cancelWriting();
+		return false;
+	}
+	return file.commit();
+}
+
+//------------------------------------------------------------------------------
+bool Workspace::loadSnapshot()
+{
+	QFile file(getSnapshotFile());
+	if(file.fileName().isEmpty() || !file.open(QIODevice::ReadOnly) || file.size()==0)
+		return false;
+
+	// The file table copies its arrays straight from the mapping
+	uchar *mapped = file.map(0, file.size());
+	if(!mapped)
+		return false;
+
+	QByteArray data = QByteArray::fromRawData(reinterpret_cast<const char *>(mapped), int(file.size()));
+	QDataStream in(data);
+	in.setVersion(QDataStream::Qt_5_4);
+
+	quint32 magic = 0;
+	quint32 version = 0;
+	QString path;
+	qint32 content = 0;
+	bool integrated = false;
+	in >> magic >> version;
+	if(magic!=SNAPSHOT_MAGIC || version!=SNAPSHOT_VERSION)
+		return false;
+
+	in >> path >> content >> integrated;
+	if(in.status()!=QDataStream::Ok || path!=getPath())
+		return false;
+
+	files.setRootPath(path);
+	if(!files.load(in) || !metadata.load(in))
+	{
+		files.clear();
+		invalidateMetadata();
+		return false;
+	}
+
+	coverage = content;
+	isIntegrated = integrated;
+	stashMap = metadata.getStashes();
+	branchNames = metadata.getBranches();
+	branchTips = metadata.getBranchTips();
+	tags = metadata.getTags();
+	foreach(const QString &name, branchNames)
+		tags.remove(name);
 
-_done:
-	uiCallback.endProcess();
+	applyViewFilter();
+	fromSnapshot = true;
+	return true;
 }
 
 //------------------------------------------------------------------------------
@@ -424,3 +543,27 @@ Remote * Workspace::findRemote(const QUrl& url)
 	return NULL;
 }
 
+
+//------------------------------------------------------------------------------
+bool Workspace::getSettings(QStringList &result)
+{
+	metadata.setPaths(getPath(), fossil().getRepositoryFile());
+
+	if(!metadata.lookup(MetadataCache::CATEGORY_SETTINGS))
+	{
+		metadata.getSettings().clear();
+		if(!fossil().getSettings(metadata.getSettings()))
+			return false;
+		metadata.store(MetadataCache::CATEGORY_SETTINGS);
+	}
+
+	result = metadata.getSettings();
+	return true;
+}
+
+//------------------------------------------------------------------------------
+bool Workspace::setSetting(const QString &name, const QString &value, bool global)
+{
+	invalidateMetadata(MetadataCache::CATEGORY_SETTINGS);
+	return fossil().setSetting(name, value, global);
+}
@@ -1,15 +1,23 @@
 #ifndef WORKSPACE_H
 #define WORKSPACE_H
 
-#include <QStandardItemModel>
 #include <QFileInfo>
 #include <QDir>
 #include <QSet>
 #include <QMap>
 #include <QSettings>
+#include <QPointer>
 #include "Utils.h"
 #include "WorkspaceCommon.h"
 #include "Fossil.h"
+#include "MetadataCache.h"
+#include "ScanPlan.h"
+#include "FileTable.h"
+#include "DirTree.h"
+#include "FileTableModel.h"
+#include "WorkspaceTreeModel.h"
+#include "ScanWorker.h"
+#include "WorkspaceWatcher.h"
 
 //////////////////////////////////////////////////////////////////////////
 // Workspace
@@ -27,17 +35,41 @@ public:
 
 	const QString &		getPath() const { return fossil().getWorkspacePath(); }
 	bool				switchWorkspace(const QString &workspace, QSettings &store);
-	void				scanWorkspace(bool scanLocal, bool scanIgnored, bool scanModified, bool scanUnchanged, const QStringList& ignorePatterns, UICallback &uiCallback);
 
-	QStandardItemModel	&getFileModel() { return repoFileModel; }
-	QStandardItemModel	&getTreeModel() { return repoTreeModel; }
+	// Scans run on a ScanWorker, which the caller connects to and starts.
+	// Its batches are added to the files as they arrive, and finishScan()
+	// completes the update. A scan that fails or is aborted keeps the
+	// previous files. A new scan supersedes the running one.
+	ScanWorker *		beginScan(const QStringList& ignorePatterns, QObject *workerParent);
+	bool				applyScanBatch(ScanWorker *worker);
+	bool				finishScan(ScanWorker *worker, UICallback &uiCallback);
+	void				abortScan();
+	bool				isScanning() const { return scanWorker!=0; }
 
-	filemap_t			&getFiles() { return workspaceFiles; }
-	stringset_t			&getPaths() { return pathSet; }
-	pathstate_map_t		&getPathState() { return pathState; }
+	// Patches the files the watcher reported. False if nothing changed
+	bool				applyWatchedChanges(WorkspaceWatcher &watcher);
+
+	// Updates the state after an operation that touched only the listed
+	// files and metadata categories
+	bool				refreshFiles(const QStringList &paths, int categories, bool checkoutChanged=false);
+
+	// The files and paths are kept unfiltered, the view filter
+	// only determines which of them are visible
+	void				setViewFilter(bool showUnknown, bool showIgnored, bool showModified, bool showUnchanged);
+	bool				isVisible(const WorkspaceFile &file) const;
+
+	// False if the last scan did not gather all the files the view filter shows
+	bool				isViewCovered() const;
+
+	FileTableModel		&getFileModel() { return repoFileModel; }
+	WorkspaceTreeModel	&getTreeModel() { return repoTreeModel; }
+
+	FileTable			&getFiles() { return files; }
+	const DirTree		&getDirTree() const { return dirTree; }
 	stashmap_t			&getStashes() { return stashMap; }
 	QStringMap			&getTags() { return tags; }
 	QStringList			&getBranches() { return branchNames; }
+	const branchmap_t	&getBranchTips() const { return branchTips; }
 	bool				otherChanges() const { return isIntegrated; }
 	const QString		&getCurrentRevision() const { return fossil().getCurrentRevision(); }
 	const QStringList	&getActiveTags() const { return fossil().getActiveTags(); }
@@ -53,6 +85,15 @@ public:
 
 	void				storeWorkspace(QSettings &store);
 
+	// The last scan of each workspace is kept in a snapshot, which is
+	// shown when the workspace is opened until a new scan replaces it
+	void				setSnapshotDir(const QString &dir) { snapshotDir = dir; }
+
+	// Metadata
+	bool				getSettings(QStringList &result);
+	bool				setSetting(const QString &name, const QString &value, bool global);
+	void				invalidateMetadata(int categories=MetadataCache::CATEGORY_ALL) { metadata.invalidate(categories); }
+
 	// Fossil Wrappers
 	void Init(UICallback *callback, const QString &exePath)
 	{
@@ -61,6 +102,7 @@ public:
 
 	bool create(const QString &repositoryPath, const QString& workspacePath)
 	{
+		invalidateMetadata();
 		return fossil().createWorkspace(repositoryPath, workspacePath);
 	}
 
@@ -76,22 +118,24 @@ public:
 
 	bool close(bool force=false)
 	{
+		invalidateMetadata();
 		return fossil().closeWorkspace(force);
 	}
 
-	bool cloneRepository(const QString &repository, const QUrl &url, const QUrl &proxyUrl)
+	FossilJob *cloneRepository(const QString &repository, const QUrl &url, const QUrl &proxyUrl, QObject *jobParent=0)
 	{
-		return fossil().cloneRepository(repository, url, proxyUrl);
+		return fossil().cloneRepository(repository, url, proxyUrl, jobParent);
 	}
 
-	bool push(const QUrl& url)
+	FossilJob *push(const QUrl& url, QObject *jobParent=0)
 	{
-		return fossil().pushWorkspace(url);
+		return fossil().pushWorkspace(url, jobParent);
 	}
 
-	bool pull(const QUrl& url)
+	FossilJob *pull(const QUrl& url, QObject *jobParent=0)
 	{
-		return fossil().pullWorkspace(url);
+		invalidateMetadata(MetadataCache::CATEGORY_BRANCHES|MetadataCache::CATEGORY_TAGS);
+		return fossil().pullWorkspace(url, jobParent);
 	}
 
 	bool update(QStringList& result, const QString& revision, bool explainOnly)
@@ -101,6 +145,8 @@ public:
 
 	bool undo(QStringList& result, bool explainOnly)
 	{
+		if(!explainOnly)
+			invalidateMetadata();
 		return fossil().undoWorkspace(result, explainOnly);
 	}
 
@@ -111,6 +157,7 @@ public:
 
 	bool commitFiles(const QStringList &fileList, const QString &comment, const QString& newBranchName, bool isPrivateBranch)
 	{
+		invalidateMetadata(MetadataCache::CATEGORY_BRANCHES|MetadataCache::CATEGORY_TAGS);
 		return fossil().commitFiles(fileList, comment, newBranchName, isPrivateBranch);
 	}
 
@@ -137,6 +184,7 @@ public:
 	// Stashes
 	bool stashNew(const QStringList& fileList, const QString& name, bool revert)
 	{
+		invalidateMetadata(MetadataCache::CATEGORY_STASHES);
 		return fossil().stashNew(fileList, name, revert);
 	}
 
@@ -147,11 +195,13 @@ public:
 
 	bool stashApply(const QString& name)
 	{
+		invalidateMetadata(MetadataCache::CATEGORY_STASHES);
 		return fossil().stashApply(name);
 	}
 
 	bool stashDrop(const QString& name)
 	{
+		invalidateMetadata(MetadataCache::CATEGORY_STASHES);
 		return fossil().stashDrop(name);
 	}
 
@@ -168,11 +218,13 @@ public:
 
 	bool tagNew(const QString& name, const QString& revision)
 	{
+		invalidateMetadata(MetadataCache::CATEGORY_TAGS);
 		return fossil().tagNew(name, revision);
 	}
 
 	bool tagDelete(const QString& name, const QString& revision)
 	{
+		invalidateMetadata(MetadataCache::CATEGORY_TAGS|MetadataCache::CATEGORY_BRANCHES);
 		return fossil().tagDelete(name, revision);
 	}
 
@@ -184,6 +236,7 @@ public:
 
 	bool branchNew(const QString& name, const QString& revisionBasis, bool isPrivate=false)
 	{
+		invalidateMetadata(MetadataCache::CATEGORY_BRANCHES|MetadataCache::CATEGORY_TAGS);
 		return fossil().branchNew(name, revisionBasis, isPrivate);
 	}
 
@@ -198,21 +251,39 @@ public:
 	}
 
 private:
-	static bool			scanDirectory(QFileInfoList &entries, const QString& dirPath, const QString &baseDir, const QStringList& ignorePatterns, UICallback &uiCallback);
+	void				applyViewFilter();
+	int					getViewContent() const;
+	void				cancelScan();
+	void				applyChanges(const WorkspaceWatcher::changelist_t &changes);
+	void				loadMetadata();
+	QString				getSnapshotFile() const;
+	bool				loadSnapshot();
+	bool				storeSnapshot() const;
 
 private:
 	Fossil				bridge;
-	filemap_t			workspaceFiles;
-	stringset_t			pathSet;
-	pathstate_map_t		pathState;
+	FileTable			files;
+	DirTree				dirTree;
 	stashmap_t			stashMap;
 	QStringList			branchNames;
+	branchmap_t			branchTips;
 	QStringMap			tags;
 	remote_map_t		remotes;
 	bool				isIntegrated;
-
-	QStandardItemModel	repoFileModel;
-	QStandardItemModel	repoTreeModel;
+	bool				viewUnknown;
+	bool				viewIgnored;
+	bool				viewModified;
+	bool				viewUnchanged;
+	int					coverage;		// ScanPlan::Content of the last scan
+	GlobMatcher			ignoreMatcher;	// The ignore patterns of the last scan
+
+	MetadataCache		metadata;
+	QPointer<ScanWorker>	scanWorker;
+	QString				snapshotDir;
+	bool				fromSnapshot;	// The files have not been scanned yet
+
+	FileTableModel		repoFileModel;
+	WorkspaceTreeModel	repoTreeModel;
 };
 
 #endif // WORKSPACE_H
@@ -6,6 +6,7 @@
 #include <QSet>
 #include <QMap>
 #include <QUrl>
+#include <QDateTime>
 #include "Utils.h"
 
 //////////////////////////////////////////////////////////////////////////
@@ -18,11 +19,15 @@ enum WorkspaceState
 	WORKSPACE_STATE_OLDSCHEMA
 };
 
+class FileTable;
+
 //////////////////////////////////////////////////////////////////////////
 // WorkspaceFile
+// A handle to a row of the FileTable of the workspace
 //////////////////////////////////////////////////////////////////////////
-struct WorkspaceFile
+class WorkspaceFile
 {
+public:
 	enum Type
 	{
 		TYPE_UNKNOWN		= 1<<0,
@@ -39,70 +44,44 @@ struct WorkspaceFile
 		TYPE_ALL			= TYPE_UNKNOWN|TYPE_REPO
 	};
 
-	WorkspaceFile(const QFileInfo &info, Type type, const QString &repoPath)
-	{
-		FileInfo = info;
-		FileType = type;
-		FilePath = getRelativeFilename(repoPath);
-		Path = FileInfo.absolutePath();
-
-		// Strip the workspace path from the path
-		Q_ASSERT(Path.indexOf(repoPath)==0);
-		Path = Path.mid(repoPath.length()+1);
-	}
-
-	bool isType(Type t) const
-	{
-		return FileType == t;
-	}
-
-	void setType(Type t)
-	{
-		FileType = t;
-	}
-
-	Type getType() const
-	{
-		return FileType;
-	}
-
-	QFileInfo getFileInfo() const
-	{
-		return FileInfo;
-	}
-
-	const QString &getFilePath() const
+	WorkspaceFile() : table(0), row(-1)
 	{
-		return FilePath;
 	}
 
-	QString getFilename() const
+	WorkspaceFile(const FileTable *table, int row) : table(table), row(row)
 	{
-		return FileInfo.fileName();
 	}
 
-	const QString &getPath() const
-	{
-		return Path;
-	}
+	bool isValid() const { return table!=0 && row>=0; }
+	int getRow() const { return row; }
 
-	QString getRelativeFilename(const QString &path)
-	{
-		QString abs_base_dir = QDir(path).absolutePath();
+	bool isType(Type t) const { return getType() == t; }
+	Type getType() const;
 
-		QString relative = FileInfo.absoluteFilePath();
-		int index = relative.indexOf(abs_base_dir);
-		if(index<0)
-			return QString("");
+	// Unknown files matching the ignore patterns
+	bool isIgnored() const;
 
-		return relative.right(relative.length() - abs_base_dir.length()-1);
-	}
+	QFileInfo getFileInfo() const;
+	QString getFilePath() const;
+	QString getFilename() const;
+	const QString &getPath() const;
+	QString getSuffix() const;
+	QDateTime getModified() const;
 
 private:
-	QFileInfo	FileInfo;
-	Type		FileType;
-	QString		FilePath;
-	QString		Path;
+	const FileTable	*table;
+	int				row;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// FileListVisitor
+// Receives the tracked files of a workspace as they are listed
+//////////////////////////////////////////////////////////////////////////
+class FileListVisitor
+{
+public:
+	virtual ~FileListVisitor() {}
+	virtual void onFile(WorkspaceFile::Type type, const QString &filePath)=0;
 };
 
 class Remote
@@ -120,10 +99,19 @@ public:
 };
 
 typedef QMap<QUrl, Remote> remote_map_t;
-typedef QMap<QString, WorkspaceFile::Type> pathstate_map_t;
-typedef QList<WorkspaceFile*> filelist_t;
-typedef QMap<QString, WorkspaceFile*> filemap_t;
+typedef QList<WorkspaceFile> filelist_t;
 typedef QMap<QString, QString> stashmap_t;
 
+//////////////////////////////////////////////////////////////////////////
+// BranchTip
+//////////////////////////////////////////////////////////////////////////
+struct BranchTip
+{
+	QString		revision;
+	QDateTime	lastCheckin;
+	QString		user;
+};
+typedef QMap<QString, BranchTip> branchmap_t;
+
 
 #endif // WORKSPACECOMMON_H
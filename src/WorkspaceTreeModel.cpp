@@ -0,0 +1,494 @@
+#include "WorkspaceTreeModel.h"
+#include <QCoreApplication>
+#include <QFont>
+#include "Workspace.h"
+#include "Utils.h"
+
+///////////////////////////////////////////////////////////////////////////////
+WorkspaceTreeModel::Node::Node(Node *parent, const Item &item)
+	: parent(parent)
+	, row(0)
+	, item(item)
+	, fetched(true)
+{
+}
+
+//------------------------------------------------------------------------------
+WorkspaceTreeModel::Node::~Node()
+{
+	qDeleteAll(children);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+WorkspaceTreeModel::WorkspaceTreeModel(QObject *parent)
+	: QAbstractItemModel(parent)
+	, root(new Node(0, Item()))
+	, tree(0)
+{
+}
+
+//------------------------------------------------------------------------------
+WorkspaceTreeModel::~WorkspaceTreeModel()
+{
+	delete root;
+}
+
+//------------------------------------------------------------------------------
+WorkspaceTreeModel::Node *WorkspaceTreeModel::getNode(const QModelIndex &index) const
+{
+	return index.isValid() ? static_cast<Node *>(index.internalPointer()) : root;
+}
+
+//------------------------------------------------------------------------------
+QModelIndex WorkspaceTreeModel::getIndex(Node *node) const
+{
+	return node==root ? QModelIndex() : createIndex(node->row, 0, node);
+}
+
+//------------------------------------------------------------------------------
+QModelIndex WorkspaceTreeModel::index(int row, int column, const QModelIndex &parent) const
+{
+	Node *node = getNode(parent);
+	if(row<0 || row>=node->children.size() || column!=0)
+		return QModelIndex();
+
+	return createIndex(row, column, node->children[row]);
+}
+
+//------------------------------------------------------------------------------
+QModelIndex WorkspaceTreeModel::parent(const QModelIndex &index) const
+{
+	if(!index.isValid())
+		return QModelIndex();
+
+	return getIndex(getNode(index)->parent);
+}
+
+//------------------------------------------------------------------------------
+int WorkspaceTreeModel::rowCount(const QModelIndex &parent) const
+{
+	if(parent.column()>0)
+		return 0;
+	return getNode(parent)->children.size();
+}
+
+//------------------------------------------------------------------------------
+int WorkspaceTreeModel::columnCount(const QModelIndex &/*parent*/) const
+{
+	return 1;
+}
+
+//------------------------------------------------------------------------------
+bool WorkspaceTreeModel::hasChildren(const QModelIndex &parent) const
+{
+	const Node *node = getNode(parent);
+	return !node->fetched || !node->children.isEmpty();
+}
+
+//------------------------------------------------------------------------------
+bool WorkspaceTreeModel::canFetchMore(const QModelIndex &parent) const
+{
+	return !getNode(parent)->fetched;
+}
+
+//------------------------------------------------------------------------------
+void WorkspaceTreeModel::fetchMore(const QModelIndex &parent)
+{
+	Node *node = getNode(parent);
+	if(node->fetched)
+		return;
+
+	QVector<Item> items;
+	makeFolderChildren(node, items);
+	node->fetched = true;
+
+	if(!items.isEmpty())
+		insertNodes(node, 0, items, 0, items.size());
+}
+
+//------------------------------------------------------------------------------
+QModelIndex WorkspaceTreeModel::findFolder(const QString &path)
+{
+	Node *node = 0;
+	foreach(Node *group, root->children)
+	{
+		if(group->item.item.Type==WorkspaceItem::TYPE_WORKSPACE)
+		{
+			node = group;
+			break;
+		}
+	}
+	if(!node)
+		return QModelIndex();
+
+	QString prefix;
+	foreach(const QString &part, path.split('/', QString::SkipEmptyParts))
+	{
+		prefix = prefix.isEmpty() ? part : prefix + '/' + part;
+
+		if(!node->fetched)
+			fetchMore(getIndex(node));
+
+		Node *next = 0;
+		foreach(Node *child, node->children)
+		{
+			if(child->item.item.Type==WorkspaceItem::TYPE_FOLDER && child->item.item.Value==prefix)
+			{
+				next = child;
+				break;
+			}
+		}
+		if(!next)
+			break;
+		node = next;
+	}
+
+	return getIndex(node);
+}
+
+//------------------------------------------------------------------------------
+QVariant WorkspaceTreeModel::data(const QModelIndex &index, int role) const
+{
+	if(!index.isValid())
+		return QVariant();
+
+	const Item &item = getNode(index)->item;
+	switch(role)
+	{
+	case Qt::DisplayRole:
+		return item.text;
+	case Qt::DecorationRole:
+		if(!item.icon)
+			break;
+		if(!iconCache.contains(item.icon))
+			iconCache.insert(item.icon, QIcon(item.icon));
+		return iconCache[item.icon];
+	case Qt::ToolTipRole:
+		if(item.tooltip.isEmpty())
+			break;
+		return item.tooltip;
+	case Qt::FontRole:
+		if(item.bold)
+		{
+			QFont font;
+			font.setBold(true);
+			return font;
+		}
+		break;
+	case ROLE_WORKSPACE_ITEM:
+		return item.item;
+	}
+
+	return QVariant();
+}
+
+//------------------------------------------------------------------------------
+QVariant WorkspaceTreeModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+	if(orientation==Qt::Horizontal && section==0 && role==Qt::DisplayRole)
+		return QCoreApplication::translate("MainWindow", "Workspace");
+	return QVariant();
+}
+
+//------------------------------------------------------------------------------
+// Identifies a node across updates
+QString WorkspaceTreeModel::getKey(const Item &item)
+{
+	return QString::number(item.item.Type) + '\n' + item.text + '\n' + item.item.Value;
+}
+
+//------------------------------------------------------------------------------
+bool WorkspaceTreeModel::isFolder(const Node *node)
+{
+	return node->item.item.Type==WorkspaceItem::TYPE_FOLDER || node->item.item.Type==WorkspaceItem::TYPE_WORKSPACE;
+}
+
+//------------------------------------------------------------------------------
+// The tree is rebuilt on every scan, so the stored id is checked against the path
+int WorkspaceTreeModel::resolveDir(Node *node) const
+{
+	int dir_id = node->item.dirId;
+	if(dir_id<0 || !tree)
+		return -1;
+
+	if(dir_id>=tree->getNodeCount() || tree->getPath(dir_id)!=node->item.item.Value)
+		node->item.dirId = dir_id = tree->findDir(node->item.item.Value);
+
+	return dir_id;
+}
+
+//------------------------------------------------------------------------------
+WorkspaceTreeModel::Item WorkspaceTreeModel::makeFolderItem(int dirId) const
+{
+	const DirTree::Node &node = tree->getNode(dirId);
+	const QString &fullpath = tree->getPath(dirId);
+
+	int state = WorkspaceItem::STATE_DEFAULT;
+	if(node.type & (WorkspaceFile::TYPE_MODIFIED))
+		state = WorkspaceItem::STATE_MODIFIED;
+	else if(node.type == WorkspaceFile::TYPE_UNKNOWN)
+		state = WorkspaceItem::STATE_UNKNOWN;
+	else if(node.type)
+		state = WorkspaceItem::STATE_UNCHANGED;
+
+	Item item;
+	item.item = WorkspaceItem(WorkspaceItem::TYPE_FOLDER, fullpath, state);
+	item.text = tree->getName(dirId);
+	item.dirId = dirId;
+	item.tooltip = fullpath;
+
+	if(state == WorkspaceItem::STATE_UNCHANGED)
+	{
+		item.icon = ":icons/icon-item-folder-unchanged";
+		item.tooltip += " " + QObject::tr("Unchanged");
+	}
+	else if(state == WorkspaceItem::STATE_MODIFIED)
+	{
+		item.icon = ":icons/icon-item-folder-modified";
+		item.tooltip += " " + QObject::tr("Modified");
+	}
+	else if(state == WorkspaceItem::STATE_UNKNOWN)
+	{
+		item.icon = ":icons/icon-item-folder-unknown";
+		item.tooltip += " " + QObject::tr("Unknown");
+	}
+	else
+		item.icon = ":icons/icon-item-folder";
+
+	// Files below the folder by state
+	QStringList counts;
+	if(node.modifiedCount)
+		counts << QObject::tr("%0 modified").arg(node.modifiedCount);
+	if(node.conflictedCount)
+		counts << QObject::tr("%0 conflicted").arg(node.conflictedCount);
+	if(node.unknownCount)
+		counts << QObject::tr("%0 unknown").arg(node.unknownCount);
+	if(!counts.isEmpty())
+		item.tooltip += "\n" + counts.join(", ");
+
+	return item;
+}
+
+//------------------------------------------------------------------------------
+void WorkspaceTreeModel::makeFolderChildren(Node *node, QVector<Item> &items)
+{
+	int dir_id = resolveDir(node);
+	if(dir_id<0)
+		return;
+
+	int count = tree->getChildCount(dir_id);
+	items.reserve(count);
+	for(int i=0; i<count; ++i)
+		items.append(makeFolderItem(tree->getChild(dir_id, i)));
+}
+
+//------------------------------------------------------------------------------
+void WorkspaceTreeModel::insertNodes(Node *node, int first, const QVector<Item> &items, int from, int count)
+{
+	beginInsertRows(getIndex(node), first, first+count-1);
+	for(int i=0; i<count; ++i)
+	{
+		Node *child = new Node(node, items[from+i]);
+		child->fetched = !isFolder(child) || resolveDir(child)<0 || tree->getChildCount(child->item.dirId)==0;
+		node->children.insert(first+i, child);
+	}
+
+	for(int r=first; r<node->children.size(); ++r)
+		node->children[r]->row = r;
+	endInsertRows();
+}
+
+//------------------------------------------------------------------------------
+void WorkspaceTreeModel::removeNodes(Node *node, int first, int count)
+{
+	beginRemoveRows(getIndex(node), first, first+count-1);
+	for(int i=0; i<count; ++i)
+		delete node->children.takeAt(first);
+
+	for(int r=first; r<node->children.size(); ++r)
+		node->children[r]->row = r;
+	endRemoveRows();
+}
+
+//------------------------------------------------------------------------------
+void WorkspaceTreeModel::syncFolder(Node *node)
+{
+	// Folders not expanded yet create their children on demand
+	if(!node->fetched)
+	{
+		if(resolveDir(node)<0 || tree->getChildCount(node->item.dirId)==0)
+		{
+			node->fetched = true;
+			QModelIndex mi = getIndex(node);
+			emit dataChanged(mi, mi);
+		}
+		return;
+	}
+
+	QVector<Item> items;
+	makeFolderChildren(node, items);
+	syncChildren(node, items);
+}
+
+//------------------------------------------------------------------------------
+void WorkspaceTreeModel::syncChildren(Node *node, const QVector<Item> &items)
+{
+	QHash<QString, int> positions;
+	for(int i=0; i<items.size(); ++i)
+		positions.insert(getKey(items[i]), i);
+
+	// Remove the nodes that are gone, from the end so that the rows stay valid
+	for(int i=node->children.size()-1; i>=0; )
+	{
+		if(positions.contains(getKey(node->children[i]->item)))
+		{
+			--i;
+			continue;
+		}
+
+		int last = i;
+		while(i>=0 && !positions.contains(getKey(node->children[i]->item)))
+			--i;
+		removeNodes(node, i+1, last-i);
+	}
+
+	// The remaining nodes are expected in the new order, otherwise start over
+	int previous = -1;
+	foreach(const Node *child, node->children)
+	{
+		int position = positions.value(getKey(child->item));
+		if(position<=previous)
+		{
+			removeNodes(node, 0, node->children.size());
+			break;
+		}
+		previous = position;
+	}
+
+	// Insert the new nodes around the kept ones, and refresh the kept ones
+	int row = 0;
+	for(int i=0; i<items.size(); )
+	{
+		int next = row<node->children.size() ? positions.value(getKey(node->children[row]->item)) : items.size();
+		if(next>i)
+		{
+			insertNodes(node, row, items, i, next-i);
+			row += next-i;
+			i = next;
+			continue;
+		}
+
+		Node *child = node->children[row];
+		bool changed = !child->item.sameContent(items[i]);
+		child->item = items[i];
+		if(changed)
+		{
+			QModelIndex mi = getIndex(child);
+			emit dataChanged(mi, mi);
+		}
+
+		if(isFolder(child))
+			syncFolder(child);
+
+		++row;
+		++i;
+	}
+}
+
+//------------------------------------------------------------------------------
+void WorkspaceTreeModel::update(Workspace &workspace, bool showFolders)
+{
+	tree = &workspace.getDirTree();
+
+	enum
+	{
+		GROUP_FILES,
+		GROUP_BRANCHES,
+		GROUP_TAGS,
+		GROUP_STASHES,
+		GROUP_REMOTES,
+		GROUP_COUNT
+	};
+
+	static const struct { int type; const char *text; const char *icon; }
+	group_types[GROUP_COUNT] =
+	{
+		{ WorkspaceItem::TYPE_WORKSPACE, QT_TRANSLATE_NOOP("MainWindow", "Files"), ":icons/icon-item-folder" },
+		{ WorkspaceItem::TYPE_BRANCHES, QT_TRANSLATE_NOOP("MainWindow", "Branches"), ":icons/icon-item-branch" },
+		{ WorkspaceItem::TYPE_TAGS, QT_TRANSLATE_NOOP("MainWindow", "Tags"), ":icons/icon-item-tag" },
+		{ WorkspaceItem::TYPE_STASHES, QT_TRANSLATE_NOOP("MainWindow", "Stashes"), ":icons/icon-action-repo-open" },
+		{ WorkspaceItem::TYPE_REMOTES, QT_TRANSLATE_NOOP("MainWindow", "Remotes"), ":icons/icon-item-remote" },
+	};
+
+	QVector<Item> groups(GROUP_COUNT);
+	for(int g=0; g<GROUP_COUNT; ++g)
+	{
+		groups[g].item = WorkspaceItem(group_types[g].type, "");
+		groups[g].text = QCoreApplication::translate("MainWindow", group_types[g].text);
+		groups[g].icon = group_types[g].icon;
+	}
+
+	// The folders hang off the workspace node, which also syncs them
+	groups[GROUP_FILES].dirId = showFolders ? int(DirTree::ROOT) : -1;
+	syncChildren(root, groups);
+	Q_ASSERT(root->children.size()==GROUP_COUNT);
+
+	// Branches
+	QVector<Item> items;
+	foreach(const QString &branch_name, workspace.getBranches())
+	{
+		Item item;
+		item.item = WorkspaceItem(WorkspaceItem::TYPE_BRANCH, branch_name);
+		item.text = branch_name;
+		item.icon = group_types[GROUP_BRANCHES].icon;
+
+		branchmap_t::const_iterator tip = workspace.getBranchTips().find(branch_name);
+		if(tip != workspace.getBranchTips().end())
+			item.tooltip = QCoreApplication::translate("MainWindow", "Last check-in %0 by %1").arg(tip->lastCheckin.toString(Qt::DefaultLocaleShortDate)).arg(tip->user);
+
+		item.bold = workspace.getActiveTags().contains(branch_name);
+		items.append(item);
+	}
+	syncChildren(root->children[GROUP_BRANCHES], items);
+
+	// Tags
+	items.clear();
+	for(QStringMap::const_iterator it=workspace.getTags().begin(); it!=workspace.getTags().end(); ++it)
+	{
+		Item item;
+		item.item = WorkspaceItem(WorkspaceItem::TYPE_TAG, it.key());
+		item.text = it.key();
+		item.icon = group_types[GROUP_TAGS].icon;
+		item.bold = workspace.getActiveTags().contains(it.key());
+		items.append(item);
+	}
+	syncChildren(root->children[GROUP_TAGS], items);
+
+	// Stashes
+	items.clear();
+	for(stashmap_t::const_iterator it=workspace.getStashes().begin(); it!=workspace.getStashes().end(); ++it)
+	{
+		Item item;
+		item.item = WorkspaceItem(WorkspaceItem::TYPE_STASH, it.value());
+		item.text = it.key();
+		item.icon = group_types[GROUP_STASHES].icon;
+		items.append(item);
+	}
+	syncChildren(root->children[GROUP_STASHES], items);
+
+	// Remotes
+	items.clear();
+	for(remote_map_t::const_iterator it=workspace.getRemotes().begin(); it!=workspace.getRemotes().end(); ++it)
+	{
+		Item item;
+		item.item = WorkspaceItem(WorkspaceItem::TYPE_REMOTE, it->url.toString());
+		item.text = it->name;
+		item.icon = group_types[GROUP_REMOTES].icon;
+		item.tooltip = UrlToStringDisplay(it->url);
+
+		// Mark the default url as bold
+		item.bold = it->isDefault;
+		items.append(item);
+	}
+	syncChildren(root->children[GROUP_REMOTES], items);
+}
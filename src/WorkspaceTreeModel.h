@@ -0,0 +1,153 @@
+#ifndef WORKSPACETREEMODEL_H
+#define WORKSPACETREEMODEL_H
+
+#include <QAbstractItemModel>
+#include <QVariant>
+#include <QVector>
+#include <QHash>
+#include <QIcon>
+#include "DirTree.h"
+
+class Workspace;
+
+enum
+{
+	ROLE_WORKSPACE_ITEM = Qt::UserRole+1
+};
+
+struct WorkspaceItem
+{
+	enum
+	{
+		TYPE_UNKNOWN,
+		TYPE_WORKSPACE,
+		TYPE_FOLDER,
+		TYPE_STASHES,
+		TYPE_STASH,
+		TYPE_BRANCHES,
+		TYPE_BRANCH,
+		TYPE_TAGS,
+		TYPE_TAG,
+		TYPE_REMOTES,
+		TYPE_REMOTE,
+	};
+
+	enum
+	{
+		STATE_DEFAULT,
+		STATE_UNCHANGED,
+		STATE_MODIFIED,
+		STATE_UNKNOWN
+	};
+
+
+	WorkspaceItem()
+	: Type(TYPE_UNKNOWN)
+	, State(STATE_DEFAULT)
+	{
+	}
+
+	WorkspaceItem(int type, const QString &value, int state=STATE_DEFAULT)
+	: Type(type), State(state), Value(value)
+	{
+	}
+
+	WorkspaceItem(const WorkspaceItem &other)
+	{
+		Type = other.Type;
+		State = other.State;
+		Value = other.Value;
+	}
+
+	int Type;
+	int State;
+	QString Value;
+
+
+	operator QVariant() const
+	{
+		return QVariant::fromValue(*this);
+	}
+};
+Q_DECLARE_METATYPE(WorkspaceItem)
+
+//////////////////////////////////////////////////////////////////////////
+// WorkspaceTreeModel
+// The workspace folders, branches, tags, stashes and remotes. Nodes are
+// kept across updates and only the differences are signalled, so the
+// view keeps its expansion and selection. Folder children are created
+// when the view first asks for them.
+//////////////////////////////////////////////////////////////////////////
+class WorkspaceTreeModel : public QAbstractItemModel
+{
+	Q_OBJECT
+public:
+	explicit WorkspaceTreeModel(QObject *parent=0);
+	~WorkspaceTreeModel();
+
+	void				update(Workspace &workspace, bool showFolders);
+
+	// The deepest folder of the path present in the tree, fetching as needed
+	QModelIndex			findFolder(const QString &path);
+
+	QModelIndex			index(int row, int column, const QModelIndex &parent=QModelIndex()) const;
+	QModelIndex			parent(const QModelIndex &index) const;
+	int					rowCount(const QModelIndex &parent=QModelIndex()) const;
+	int					columnCount(const QModelIndex &parent=QModelIndex()) const;
+	bool				hasChildren(const QModelIndex &parent=QModelIndex()) const;
+	bool				canFetchMore(const QModelIndex &parent) const;
+	void				fetchMore(const QModelIndex &parent);
+	QVariant			data(const QModelIndex &index, int role=Qt::DisplayRole) const;
+	QVariant			headerData(int section, Qt::Orientation orientation, int role=Qt::DisplayRole) const;
+
+private:
+	struct Item
+	{
+		Item() : icon(0), bold(false), dirId(-1)
+		{
+		}
+
+		bool sameContent(const Item &o) const
+		{
+			return item.State==o.item.State && tooltip==o.tooltip && icon==o.icon && bold==o.bold;
+		}
+
+		WorkspaceItem	item;
+		QString			text;
+		QString			tooltip;
+		const char		*icon;
+		bool			bold;
+		int				dirId;		// The DirTree node of folders, otherwise -1
+	};
+
+	struct Node
+	{
+		Node(Node *parent, const Item &item);
+		~Node();
+
+		Node			*parent;
+		int				row;
+		Item			item;
+		QList<Node *>	children;
+		bool			fetched;	// False while the folder children are not created
+	};
+
+	static QString		getKey(const Item &item);
+	Node				*getNode(const QModelIndex &index) const;
+	QModelIndex			getIndex(Node *node) const;
+	Item				makeFolderItem(int dirId) const;
+	void				makeFolderChildren(Node *node, QVector<Item> &items);
+	int					resolveDir(Node *node) const;
+	static bool			isFolder(const Node *node);
+	void				syncChildren(Node *node, const QVector<Item> &items);
+	void				syncFolder(Node *node);
+	void				insertNodes(Node *node, int first, const QVector<Item> &items, int from, int count);
+	void				removeNodes(Node *node, int first, int count);
+
+	Node				*root;
+	const DirTree		*tree;
+
+	mutable QHash<QString, QIcon>	iconCache;
+};
+
+#endif // WORKSPACETREEMODEL_H
@@ -0,0 +1,470 @@
+#include "WorkspaceWatcher.h"
+#include <QtConcurrent/QtConcurrentRun>
+#include <QSocketNotifier>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include "Fossil.h"
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#ifdef Q_OS_LINUX
+static const uint32_t	WATCH_MASK = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+									 IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR | IN_DONT_FOLLOW;
+#endif
+
+//------------------------------------------------------------------------------
+// The checkout database, a repository inside the workspace and their
+// journals change with every fossil command
+static bool IsFossilFile(const QString &path, const QString &repositoryPath)
+{
+	QString file = path;
+	if(file.endsWith("-journal"))
+		file.chop(8);
+	else if(file.endsWith("-wal") || file.endsWith("-shm"))
+		file.chop(4);
+
+	if(!repositoryPath.isEmpty() && file == repositoryPath)
+		return true;
+
+	QString name = file.mid(file.lastIndexOf('/')+1);
+	return name == FOSSIL_CHECKOUT1 || name == FOSSIL_CHECKOUT2;
+}
+
+#ifdef Q_OS_LINUX
+//------------------------------------------------------------------------------
+// Watches the directory and the ones below it, and collects their files if
+// asked to. False once the kernel refuses more watches, or when cancelled
+static bool AddWatchTree(int fd, const QString &workspacePath, const QString &dirPath, const GlobMatcher &ignoreMatcher,
+						 QHash<int, QString> &dirs, QStringList *files, const QAtomicInt *cancelled)
+{
+	if(cancelled && cancelled->load())
+		return false;
+
+	QString abs_path = dirPath.isEmpty() ? workspacePath : workspacePath + PATH_SEPARATOR + dirPath;
+	int wd = inotify_add_watch(fd, QFile::encodeName(abs_path).constData(), WATCH_MASK);
+	if(wd<0)
+		return errno!=ENOSPC && errno!=ENOMEM;
+
+	dirs.insert(wd, dirPath);
+
+	QDir dir(abs_path);
+	foreach(const QFileInfo &fi, dir.entryInfoList(QDir::Dirs | QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot | QDir::NoSymLinks))
+	{
+		QString path = dirPath.isEmpty() ? fi.fileName() : dirPath + PATH_SEPARATOR + fi.fileName();
+		if(fi.isDir())
+		{
+			if(ignoreMatcher.matchesAllBelow(path))
+				continue;
+			if(!AddWatchTree(fd, workspacePath, path, ignoreMatcher, dirs, files, cancelled))
+				return false;
+		}
+		else if(files)
+			files->append(path);
+	}
+	return true;
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+// SilentCallback
+//////////////////////////////////////////////////////////////////////////
+class SilentCallback : public UICallback
+{
+public:
+	virtual void logText(const QString &/*text*/, bool /*isHTML*/) {}
+	virtual void beginProcess(const QString &/*text*/) {}
+	virtual void updateProcess(const QString &/*text*/) {}
+	virtual bool processAborted() const { return false; }
+	virtual void endProcess() {}
+	virtual QMessageBox::StandardButton Query(const QString &/*title*/, const QString &/*query*/, QMessageBox::StandardButtons /*buttons*/)
+	{
+		return QMessageBox::No;
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+// WorkspaceWatcher::StatusTask
+// Queries the status of the changed paths with its own Fossil instance
+//////////////////////////////////////////////////////////////////////////
+class WorkspaceWatcher::StatusTask
+{
+public:
+	typedef WorkspaceWatcher::changelist_t result_type;
+
+	StatusTask(const WorkspaceWatcher &watcher, const stringset_t &paths)
+		: workspacePath(watcher.workspacePath)
+		, fossilExe(watcher.fossilExe)
+		, verifyChanges(watcher.verifyChanges)
+		, ignoreMatcher(watcher.ignoreMatcher)
+		, paths(paths)
+	{
+	}
+
+	result_type operator()()
+	{
+		SilentCallback callback;
+		Fossil bridge;
+		bridge.Init(&callback, fossilExe);
+		bridge.setWorkspace(workspacePath);
+		bridge.setVerifyChanges(verifyChanges);
+
+		result_type results;
+		queryStatus(bridge, ignoreMatcher, paths, results);
+		return results;
+	}
+
+private:
+	QString			workspacePath;
+	QString			fossilExe;
+	bool			verifyChanges;
+	GlobMatcher		ignoreMatcher;
+	stringset_t		paths;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// WorkspaceWatcher::WatchTask
+// Adds the watches of the whole workspace on a worker thread
+//////////////////////////////////////////////////////////////////////////
+class WorkspaceWatcher::WatchTask
+{
+public:
+	typedef WorkspaceWatcher::WatchList result_type;
+
+	WatchTask(const WorkspaceWatcher &watcher)
+		: inotifyFd(watcher.inotifyFd)
+		, workspacePath(watcher.workspacePath)
+		, ignoreMatcher(watcher.ignoreMatcher)
+		, cancelled(&watcher.watchCancelled)
+	{
+	}
+
+	result_type operator()()
+	{
+		result_type result;
+#ifdef Q_OS_LINUX
+		result.complete = AddWatchTree(inotifyFd, workspacePath, "", ignoreMatcher, result.dirs, 0, cancelled);
+#else
+		result.complete = false;
+#endif
+		return result;
+	}
+
+private:
+	int					inotifyFd;
+	QString				workspacePath;
+	GlobMatcher			ignoreMatcher;
+	const QAtomicInt	*cancelled;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// StatusCollector
+//////////////////////////////////////////////////////////////////////////
+class StatusCollector : public FileListVisitor
+{
+public:
+	void onFile(WorkspaceFile::Type type, const QString &filePath)
+	{
+		files.insert(filePath, type);
+	}
+
+	QHash<QString, WorkspaceFile::Type> files;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+WorkspaceWatcher::WorkspaceWatcher(QObject *parent)
+	: QObject(parent)
+	, verifyChanges(false)
+	, inotifyFd(-1)
+	, notifier(0)
+	, rescanPending(false)
+{
+	coalesceTimer.setSingleShot(true);
+	coalesceTimer.setInterval(COALESCE_MS);
+	pollTimer.setInterval(POLL_INTERVAL_MS);
+
+	connect(&coalesceTimer, SIGNAL(timeout()), this, SLOT(onCoalesced()));
+	connect(&pollTimer, SIGNAL(timeout()), this, SIGNAL(rescanNeeded()));
+	connect(&statusWatcher, SIGNAL(finished()), this, SLOT(onStatusQueried()));
+	connect(&watchBuilder, SIGNAL(finished()), this, SLOT(onWatchesAdded()));
+}
+
+//------------------------------------------------------------------------------
+WorkspaceWatcher::~WorkspaceWatcher()
+{
+	stop();
+	statusWatcher.waitForFinished();
+}
+
+//------------------------------------------------------------------------------
+void WorkspaceWatcher::start(const QString &_workspacePath, const QString &_repositoryFile, const QString &_fossilExe, bool _verifyChanges, const QStringList &_ignorePatterns)
+{
+	fossilExe = _fossilExe;
+	verifyChanges = _verifyChanges;
+
+	bool watching = inotifyFd>=0 || pollTimer.isActive();
+	if(watching && _workspacePath==workspacePath && _repositoryFile==repositoryFile && _ignorePatterns==ignorePatterns)
+		return;
+
+	stop();
+	workspacePath = _workspacePath;
+	repositoryFile = _repositoryFile;
+	repositoryPath.clear();
+	if(!_repositoryFile.isEmpty())
+		repositoryPath = QDir(workspacePath).relativeFilePath(QFileInfo(_repositoryFile).absoluteFilePath());
+	ignorePatterns = _ignorePatterns;
+	ignoreMatcher = GlobMatcher(ignorePatterns);
+	if(workspacePath.isEmpty())
+		return;
+
+#ifdef Q_OS_LINUX
+	inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(inotifyFd<0)
+	{
+		startPolling();
+		return;
+	}
+
+	// Listing the directories of a large workspace takes a while, so it is
+	// done on a worker thread
+	watchCancelled.store(0);
+	watchBuilder.setFuture(QtConcurrent::run(WatchTask(*this)));
+#endif
+}
+
+//------------------------------------------------------------------------------
+void WorkspaceWatcher::onWatchesAdded()
+{
+	// Stopped while the directories were listed
+	if(inotifyFd<0)
+		return;
+
+	WatchList result = watchBuilder.result();
+	if(!result.complete)
+	{
+		startPolling();
+		return;
+	}
+
+	watchedDirs = result.dirs;
+
+	// The changes made while the watches were added are already queued
+	notifier = new QSocketNotifier(inotifyFd, QSocketNotifier::Read, this);
+	connect(notifier, SIGNAL(activated(int)), this, SLOT(onEvents()));
+}
+
+//------------------------------------------------------------------------------
+void WorkspaceWatcher::stop()
+{
+	delete notifier;
+	notifier = 0;
+
+	// The listing uses the descriptor, which must not be reused under it
+	watchCancelled.store(1);
+	watchBuilder.waitForFinished();
+
+#ifdef Q_OS_LINUX
+	if(inotifyFd>=0)
+		close(inotifyFd);
+#endif
+	inotifyFd = -1;
+
+	watchedDirs.clear();
+	changedPaths.clear();
+	rescanPending = false;
+	coalesceTimer.stop();
+	pollTimer.stop();
+
+	// Any query still running is dropped once it finishes
+	changes.clear();
+}
+
+//------------------------------------------------------------------------------
+void WorkspaceWatcher::startPolling()
+{
+	stop();
+	pollTimer.start();
+}
+
+//------------------------------------------------------------------------------
+// The status of each of the paths. Those fossil does not track are unknown
+bool WorkspaceWatcher::queryStatus(Fossil &bridge, const GlobMatcher &ignoreMatcher, const stringset_t &paths, changelist_t &changes)
+{
+	changes.clear();
+
+	StatusCollector tracked;
+	if(!bridge.listFileStatus(paths, tracked))
+		return false;
+
+	foreach(const QString &path, paths)
+	{
+		Change c;
+		c.path = path;
+		c.ignored = false;
+		c.exists = true;
+
+		QHash<QString, WorkspaceFile::Type>::const_iterator it = tracked.files.constFind(path);
+		if(it!=tracked.files.constEnd())
+			c.type = it.value();
+		else
+		{
+			QFileInfo fi(bridge.getWorkspacePath() + PATH_SEPARATOR + path);
+			c.type = WorkspaceFile::TYPE_UNKNOWN;
+			c.ignored = ignoreMatcher.matchesPath(path);
+			c.exists = fi.exists() || fi.isSymLink();
+		}
+		changes.append(c);
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------------
+void WorkspaceWatcher::takeChanges(changelist_t &_changes)
+{
+	_changes.clear();
+	_changes.swap(changes);
+}
+
+//------------------------------------------------------------------------------
+// Watches the directory and the ones below it. The files of directories
+// that appear after the start are reported as changed. False once the
+// kernel refuses more watches
+bool WorkspaceWatcher::addWatches(const QString &dirPath)
+{
+#ifdef Q_OS_LINUX
+	QStringList files;
+	bool ok = AddWatchTree(inotifyFd, workspacePath, dirPath, ignoreMatcher, watchedDirs, &files, 0);
+	foreach(const QString &path, files)
+		addChange(path);
+	return ok;
+#else
+	Q_UNUSED(dirPath);
+	return false;
+#endif
+}
+
+//------------------------------------------------------------------------------
+void WorkspaceWatcher::addChange(const QString &path)
+{
+	if(IsFossilFile(path, repositoryPath) || ignoreMatcher.matchesPath(path))
+		return;
+
+	changedPaths.insert(path);
+	if(changedPaths.size() > MAX_CHANGED_PATHS)
+		rescanPending = true;
+
+	// Not restarted by later events, so that a steady stream of them
+	// still gets reported
+	if(!coalesceTimer.isActive())
+		coalesceTimer.start();
+}
+
+//------------------------------------------------------------------------------
+void WorkspaceWatcher::onEvents()
+{
+#ifdef Q_OS_LINUX
+	char buffer[16*1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+	for(;;)
+	{
+		ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+		if(length<=0)
+			break;
+
+		for(char *ptr=buffer; ptr<buffer+length; )
+		{
+			const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(ptr);
+			ptr += sizeof(struct inotify_event) + event->len;
+
+			if(event->mask & IN_Q_OVERFLOW)
+			{
+				rescanPending = true;
+				if(!coalesceTimer.isActive())
+					coalesceTimer.start();
+				continue;
+			}
+
+			if(event->mask & IN_IGNORED)
+			{
+				watchedDirs.remove(event->wd);
+				continue;
+			}
+
+			QHash<int, QString>::const_iterator it = watchedDirs.constFind(event->wd);
+			if(it==watchedDirs.constEnd() || event->len==0)
+				continue;
+
+			QString name = QFile::decodeName(event->name);
+			QString path = it.value().isEmpty() ? name : it.value() + PATH_SEPARATOR + name;
+
+			if(!(event->mask & IN_ISDIR))
+			{
+				addChange(path);
+				continue;
+			}
+
+			if(event->mask & (IN_CREATE|IN_MOVED_TO))
+			{
+				if(!ignoreMatcher.matchesAllBelow(path) && !addWatches(path))
+				{
+					startPolling();
+					return;
+				}
+			}
+			else if(event->mask & (IN_DELETE|IN_MOVED_FROM))
+			{
+				// The files below are not reported one by one
+				rescanPending = true;
+				if(!coalesceTimer.isActive())
+					coalesceTimer.start();
+			}
+		}
+	}
+#endif
+}
+
+//------------------------------------------------------------------------------
+void WorkspaceWatcher::onCoalesced()
+{
+	if(rescanPending)
+	{
+		rescanPending = false;
+		changedPaths.clear();
+		emit rescanNeeded();
+		return;
+	}
+
+	queryNext();
+}
+
+//------------------------------------------------------------------------------
+void WorkspaceWatcher::queryNext()
+{
+	if(statusWatcher.isRunning() || changedPaths.isEmpty())
+		return;
+
+	queriedPath = workspacePath;
+	statusWatcher.setFuture(QtConcurrent::run(StatusTask(*this, changedPaths)));
+	changedPaths.clear();
+}
+
+//------------------------------------------------------------------------------
+void WorkspaceWatcher::onStatusQueried()
+{
+	changelist_t results = statusWatcher.result();
+
+	// Stopped or moved to another workspace while the query ran
+	if(inotifyFd<0 || queriedPath!=workspacePath)
+	{
+		queryNext();
+		return;
+	}
+
+	changes += results;
+	if(!changes.isEmpty())
+		emit statusReady();
+
+	queryNext();
+}
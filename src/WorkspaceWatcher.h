@@ -0,0 +1,110 @@
+#ifndef WORKSPACEWATCHER_H
+#define WORKSPACEWATCHER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QHash>
+#include <QAtomicInt>
+#include <QFutureWatcher>
+#include <QStringList>
+#include <QVector>
+#include "Utils.h"
+#include "WorkspaceCommon.h"
+#include "GlobMatcher.h"
+
+class QSocketNotifier;
+class Fossil;
+
+//////////////////////////////////////////////////////////////////////////
+// WorkspaceWatcher
+// Keeps the file list current between scans. On Linux every directory of
+// the workspace that is not ignored is watched with inotify; the changed
+// paths are gathered for COALESCE_MS, and then only their status is
+// queried on a worker thread. statusReady() is emitted once the changes
+// can be taken. The watches are first added on a worker thread too. When
+// the kernel runs out of watches, rescanNeeded() is emitted every
+// POLL_INTERVAL_MS instead. Nothing is watched elsewhere than Linux.
+//////////////////////////////////////////////////////////////////////////
+class WorkspaceWatcher : public QObject
+{
+	Q_OBJECT
+public:
+	struct Change
+	{
+		QString				path;
+		WorkspaceFile::Type	type;
+		bool				ignored;
+		bool				exists;		// Untracked files that are gone are removed
+	};
+	typedef QVector<Change> changelist_t;
+
+	explicit WorkspaceWatcher(QObject *parent=0);
+	~WorkspaceWatcher();
+
+	// Restarts only if the workspace, the repository or the ignore patterns differ
+	void				start(const QString &workspacePath, const QString &repositoryFile, const QString &fossilExe, bool verifyChanges, const QStringList &ignorePatterns);
+	void				stop();
+	bool				isPolling() const { return pollTimer.isActive(); }
+
+	// Moves the changes queried since the last call to changes
+	void				takeChanges(changelist_t &changes);
+
+	static bool			queryStatus(Fossil &bridge, const GlobMatcher &ignoreMatcher, const stringset_t &paths, changelist_t &changes);
+
+signals:
+	void				statusReady();
+	void				rescanNeeded();
+
+private slots:
+	void				onEvents();
+	void				onCoalesced();
+	void				onStatusQueried();
+	void				onWatchesAdded();
+
+private:
+	class StatusTask;
+	class WatchTask;
+
+	struct WatchList
+	{
+		bool				complete;	// False if the kernel ran out of watches
+		QHash<int, QString>	dirs;
+	};
+
+	enum
+	{
+		COALESCE_MS			= 300,
+		POLL_INTERVAL_MS	= 30000,
+		MAX_CHANGED_PATHS	= 512		// Beyond this a full scan is cheaper
+	};
+
+	bool				addWatches(const QString &dirPath);
+	void				addChange(const QString &path);
+	void				startPolling();
+	void				queryNext();
+
+	QString				workspacePath;
+	QString				repositoryFile;
+	QString				repositoryPath;		// Relative to the workspace
+	QString				fossilExe;
+	bool				verifyChanges;
+	QStringList			ignorePatterns;
+	GlobMatcher			ignoreMatcher;
+
+	int					inotifyFd;
+	QSocketNotifier		*notifier;
+	QHash<int, QString>	watchedDirs;	// By watch descriptor
+	QFutureWatcher<WatchList>	watchBuilder;
+	QAtomicInt			watchCancelled;
+
+	stringset_t			changedPaths;	// Waiting for the coalescing to end
+	bool				rescanPending;
+	QTimer				coalesceTimer;
+	QTimer				pollTimer;
+
+	QFutureWatcher<changelist_t>	statusWatcher;
+	QString				queriedPath;	// The workspace of the running query
+	changelist_t		changes;		// Queried, but not taken yet
+};
+
+#endif // WORKSPACEWATCHER_H
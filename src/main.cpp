@@ -16,6 +16,7 @@ int main(int argc, char *argv[])
 	#endif
 	{
 		bool portable = false;
+		bool verify_changes = false;
 		QString workspace;
 
 		Q_ASSERT(app.arguments().size()>0);
@@ -27,6 +28,8 @@ int main(int argc, char *argv[])
 			{
 				if(arg.indexOf("portable")!=-1)
 					portable = true;
+				else if(arg.indexOf("verify-changes")!=-1)
+					verify_changes = true;
 				continue;
 			}
 			else
@@ -38,6 +41,7 @@ int main(int argc, char *argv[])
 		MainWindow mainwin(settings,
 						   0,
 						   workspace.isEmpty() ? 0 : &workspace);
+		mainwin.setVerifyChanges(verify_changes);
 		mainwin.show();
 		mainwin.fullRefresh();
 		return app.exec();
@@ -0,0 +1,21 @@
+#-------------------------------------------------
+# LineScanner benchmark
+# Compares the line splitting of fossil output
+# before and after LineScanner
+#-------------------------------------------------
+
+QT = core
+CONFIG += console
+CONFIG -= app_bundle
+
+TARGET = linescanner-bench
+TEMPLATE = app
+
+DEFINES += SAMPLE_DIR=\\\"$$PWD/samples\\\"
+
+INCLUDEPATH += ../../src
+
+SOURCES += main.cpp \
+	../../src/LineScanner.cpp
+
+HEADERS += ../../src/LineScanner.h
@@ -0,0 +1,312 @@
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QTextCodec>
+#include <QTextDecoder>
+#include <QTextStream>
+#include "LineScanner.h"
+
+// Fossil output arrives in pipe-sized reads
+static const int CHUNK_SIZE		= 4096;
+static const int STREAM_BYTES	= 8*1024*1024;
+static const int ROUNDS			= 5;
+
+static QTextStream out(stdout);
+
+//------------------------------------------------------------------------------
+static QTextCodec *OutputCodec()
+{
+#ifdef Q_OS_WIN
+	QTextCodec *codec = QTextCodec::codecForName("UTF-8");
+#else
+	QTextCodec *codec = QTextCodec::codecForLocale();
+#endif
+	Q_ASSERT(codec);
+	return codec;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// DecoderSplitter
+// The line splitting FossilJob did before LineScanner: the output is
+// decoded into a buffer, which is normalized and split on every read
+//////////////////////////////////////////////////////////////////////////
+class DecoderSplitter
+{
+public:
+	DecoderSplitter()
+		: queries(0)
+		, decoder(OutputCodec()->makeDecoder())
+	{
+	}
+
+	~DecoderSplitter()
+	{
+		delete decoder;
+	}
+
+	void feed(const QByteArray &input)
+	{
+		buffer += decoder->toUnicode(input);
+
+		const QChar EOL_MARK('\n');
+
+		buffer = buffer.replace("\r\n", "\n");
+		buffer = buffer.replace("\r", "\n");
+
+		int last_line_start = buffer.lastIndexOf(EOL_MARK);
+		if(last_line_start != -1)
+		{
+			QStringList new_lines = buffer.left(last_line_start).split(EOL_MARK);
+			foreach(const QString &line, new_lines)
+				flushLine(line);
+
+			buffer = buffer.mid(last_line_start+1);
+		}
+
+		QString last_line = buffer.trimmed();
+		if(!last_line.isEmpty() && last_line[last_line.length()-1]=='?')
+			queries += last_line.toLower().indexOf("y/n")!=-1;
+	}
+
+	void finish()
+	{
+		if(!buffer.isEmpty())
+		{
+			flushLine(buffer);
+			buffer.clear();
+		}
+	}
+
+	QStringList	lines;
+	int			queries;
+
+private:
+	void flushLine(const QString &text)
+	{
+		QString line = text.trimmed();
+		if(line.isEmpty())
+			return;
+		lines.append(line);
+	}
+
+	QTextDecoder	*decoder;
+	QString			buffer;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// CollectingVisitor
+// LineScanner as FossilJob uses it when the output is collected: each
+// line is decoded once
+//////////////////////////////////////////////////////////////////////////
+class CollectingVisitor : public LineScanner::Visitor
+{
+public:
+	void onLine(const char *line, int length)
+	{
+#ifdef Q_OS_WIN
+		lines.append(QString::fromUtf8(line, length));
+#else
+		lines.append(QString::fromLocal8Bit(line, length));
+#endif
+	}
+
+	QStringList	lines;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// CountingVisitor
+// LineScanner as the parsers use it, working on the raw spans
+//////////////////////////////////////////////////////////////////////////
+class CountingVisitor : public LineScanner::Visitor
+{
+public:
+	CountingVisitor()
+		: count(0)
+		, bytes(0)
+	{
+	}
+
+	void onLine(const char * /*line*/, int length)
+	{
+		++count;
+		bytes += length;
+	}
+
+	int		count;
+	qint64	bytes;
+};
+
+//------------------------------------------------------------------------------
+static void Split(const QByteArray &stream, QList<QByteArray> &chunks)
+{
+	chunks.clear();
+	for(int i=0; i<stream.size(); i+=CHUNK_SIZE)
+		chunks.append(stream.mid(i, CHUNK_SIZE));
+}
+
+//------------------------------------------------------------------------------
+static QByteArray Repeat(const QByteArray &sample, int size)
+{
+	QByteArray stream;
+	stream.reserve(size+sample.size());
+	while(stream.size() < size)
+		stream += sample;
+	return stream;
+}
+
+//------------------------------------------------------------------------------
+static qint64 RunDecoder(const QList<QByteArray> &chunks, QStringList &lines)
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	DecoderSplitter splitter;
+	foreach(const QByteArray &chunk, chunks)
+		splitter.feed(chunk);
+	splitter.finish();
+
+	qint64 nsecs = timer.nsecsElapsed();
+	lines = splitter.lines;
+	return nsecs;
+}
+
+//------------------------------------------------------------------------------
+static qint64 RunCollecting(const QList<QByteArray> &chunks, QStringList &lines)
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	LineScanner scanner;
+	CollectingVisitor visitor;
+	foreach(const QByteArray &chunk, chunks)
+	{
+		scanner.feed(chunk.constData(), chunk.size(), visitor);
+		scanner.detectQuery();
+	}
+	scanner.flush(visitor);
+
+	qint64 nsecs = timer.nsecsElapsed();
+	lines = visitor.lines;
+	return nsecs;
+}
+
+//------------------------------------------------------------------------------
+static qint64 RunCounting(const QList<QByteArray> &chunks, int &count)
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	LineScanner scanner;
+	CountingVisitor visitor;
+	foreach(const QByteArray &chunk, chunks)
+	{
+		scanner.feed(chunk.constData(), chunk.size(), visitor);
+		scanner.detectQuery();
+	}
+	scanner.flush(visitor);
+
+	qint64 nsecs = timer.nsecsElapsed();
+	count = visitor.count;
+	return nsecs;
+}
+
+//------------------------------------------------------------------------------
+static QString Rate(qint64 nsecs, int bytes)
+{
+	double msecs = nsecs/1e6;
+	double mb_per_sec = nsecs ? (bytes/1048576.0) / (nsecs/1e9) : 0;
+	return QString("%1 ms  %2 MB/s").arg(msecs, 8, 'f', 2).arg(mb_per_sec, 8, 'f', 1);
+}
+
+//------------------------------------------------------------------------------
+// False if the paths disagree on the lines
+static bool Benchmark(const QString &name, const QByteArray &stream)
+{
+	QList<QByteArray> chunks;
+	Split(stream, chunks);
+
+	qint64 best_decoder = -1;
+	qint64 best_collecting = -1;
+	qint64 best_counting = -1;
+	QStringList decoder_lines;
+	QStringList collected_lines;
+	int counted = 0;
+
+	for(int i=0; i<ROUNDS; ++i)
+	{
+		qint64 t = RunDecoder(chunks, decoder_lines);
+		if(best_decoder<0 || t<best_decoder)
+			best_decoder = t;
+
+		t = RunCollecting(chunks, collected_lines);
+		if(best_collecting<0 || t<best_collecting)
+			best_collecting = t;
+
+		t = RunCounting(chunks, counted);
+		if(best_counting<0 || t<best_counting)
+			best_counting = t;
+	}
+
+	out << name << ": " << stream.size() << " bytes, " << decoder_lines.size() << " lines\n";
+	out << "  decoder split      " << Rate(best_decoder, stream.size()) << "\n";
+	out << "  scanner, decoded   " << Rate(best_collecting, stream.size()) << "\n";
+	out << "  scanner, raw spans " << Rate(best_counting, stream.size()) << "\n";
+	out.flush();
+
+	if(decoder_lines!=collected_lines || counted!=decoder_lines.size())
+	{
+		out << "  MISMATCH: the paths produced different lines\n";
+		return false;
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Feeds recorded fossil output through the old and the new line splitting.
+// Without arguments the recordings in the samples directory are used
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QStringList files = app.arguments().mid(1);
+	if(files.isEmpty())
+	{
+		QDir samples(SAMPLE_DIR);
+		foreach(const QString &name, samples.entryList(QStringList() << "*.txt", QDir::Files, QDir::Name))
+			files.append(samples.filePath(name));
+	}
+
+	if(files.isEmpty())
+	{
+		out << "No recorded output found\n";
+		return 1;
+	}
+
+	bool ok = true;
+	foreach(const QString &path, files)
+	{
+		QFile file(path);
+		if(!file.open(QIODevice::ReadOnly))
+		{
+			out << "Could not read " << path << "\n";
+			ok = false;
+			continue;
+		}
+
+		// Recordings are kept with LF endings, fossil on Windows emits CRLF
+		QByteArray sample = file.readAll();
+		QByteArray stream = Repeat(sample, STREAM_BYTES);
+		QString name = QFileInfo(path).fileName();
+
+		ok = Benchmark(name+" (LF)", stream) && ok;
+
+		QByteArray crlf = stream;
+		crlf.replace("\n", "\r\n");
+		ok = Benchmark(name+" (CRLF)", crlf) && ok;
+	}
+
+	return ok ? 0 : 1;
+}